@@ -6,3 +6,5 @@
 include(CMakeDependentOption)
 
 option(UNIFEX_BUILD_EXAMPLES "Builds the libunifex examples." ON)
+option(UNIFEX_STATIC_THREAD_POOL_STATS "Collects runtime statistics in static_thread_pool." OFF)
+option(UNIFEX_IO_URING_STATS "Collects runtime statistics in io_uring_context." OFF)
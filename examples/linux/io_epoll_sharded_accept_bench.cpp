@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_EPOLL
+
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/linux/io_epoll_context.hpp>
+#include <unifex/linux/io_epoll_sharded_listener.hpp>
+#include <unifex/reduce_stream.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/with_query_value.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+
+namespace {
+
+constexpr std::size_t clientThreadCount = 4;
+constexpr std::size_t connectionsPerClient = 2500;
+constexpr std::size_t connectionCount =
+    clientThreadCount * connectionsPerClient;
+constexpr int backlog = 1024;
+constexpr std::size_t maxPending = backlog / 2;
+
+// Connects to 'address' over and over from several threads, using blocking
+// syscalls, and resets each connection as soon as it is established so
+// that the clients don't run out of ports. The clients hold back while
+// 'maxPending' connections are waiting to be accepted, since a full accept
+// queue drops connection requests and the retransmits would swamp the
+// measurement.
+void run_clients(
+    const socket_address& address, const std::atomic<std::size_t>& accepted) {
+  std::atomic<std::size_t> connected{0};
+  std::vector<std::thread> clients;
+  for (std::size_t i = 0; i < clientThreadCount; ++i) {
+    clients.emplace_back([&] {
+      for (std::size_t j = 0; j < connectionsPerClient; ++j) {
+        while (connected.load(std::memory_order_relaxed) -
+                   accepted.load(std::memory_order_relaxed) >=
+               maxPending) {
+          std::this_thread::yield();
+        }
+        connected.fetch_add(1, std::memory_order_relaxed);
+
+        const int fd = ::socket(address.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, address.data(), address.size()) < 0) {
+          std::perror("connect");
+          std::exit(1);
+        }
+        const linger reset{1, 0};
+        (void)::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        ::close(fd);
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+}
+
+// Accepts connections until stop is requested, closing each one straight
+// away on the thread that accepted it.
+std::thread start_acceptor(
+    io_epoll_context::accept_stream connections,
+    inplace_stop_token stopToken,
+    std::atomic<std::size_t>& accepted) {
+  return std::thread{[connections, stopToken, &accepted]() mutable {
+    sync_wait(with_query_value(
+        reduce_stream(
+            connections,
+            0,
+            [&](int, io_epoll_context::async_socket) {
+              accepted.fetch_add(1, std::memory_order_relaxed);
+              return 0;
+            }),
+        get_stop_token,
+        stopToken));
+  }};
+}
+
+// Runs the clients against acceptors started on 'streams' and reports how
+// long it took to accept every connection.
+void measure(
+    const char* name,
+    const socket_address& address,
+    std::vector<io_epoll_context::accept_stream> streams) {
+  std::atomic<std::size_t> accepted{0};
+  inplace_stop_source stopSource;
+  std::vector<std::thread> acceptors;
+  for (auto& stream : streams) {
+    acceptors.push_back(
+        start_acceptor(stream, stopSource.get_token(), accepted));
+  }
+  scope_guard stopAcceptors = [&]() noexcept {
+    stopSource.request_stop();
+    for (auto& acceptor : acceptors) {
+      acceptor.join();
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  run_clients(address, accepted);
+  while (accepted.load(std::memory_order_relaxed) < connectionCount) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+  std::printf(
+      "%-22s %8zu accepts in %8lld us (%.0f accepts/s)\n",
+      name,
+      connectionCount,
+      static_cast<long long>(us.count()),
+      us.count() > 0 ? connectionCount * 1000000.0 / us.count() : 0.0);
+}
+
+// One context accepts every connection from one listening socket.
+void run_single_reactor() {
+  io_epoll_context ctx;
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto listener = open_listening_socket(
+      ctx.get_scheduler(), socket_address::ipv4_loopback(), backlog);
+  measure(
+      "single reactor",
+      listener.local_address(),
+      {async_accept_stream(listener)});
+}
+
+// Each shard accepts from its own SO_REUSEPORT listening socket.
+void run_sharded(std::uint32_t shardCount) {
+  io_epoll_sharded_listener::options opts;
+  opts.shardCount = shardCount;
+  opts.backlog = backlog;
+  io_epoll_sharded_listener listener{socket_address::ipv4_loopback(), opts};
+
+  std::vector<io_epoll_context::accept_stream> streams;
+  for (std::uint32_t i = 0; i < shardCount; ++i) {
+    streams.push_back(listener.accept_stream(i));
+  }
+
+  char name[32];
+  std::snprintf(name, sizeof(name), "%2u SO_REUSEPORT shards", shardCount);
+  measure(name, listener.local_address(), std::move(streams));
+}
+
+} // anonymous namespace
+
+// Usage: io_epoll_sharded_accept_bench [max-shard-count]
+// The shard count defaults to the number of CPUs.
+int main(int argc, char** argv) {
+  const std::uint32_t maxShardCount = argc > 1
+      ? static_cast<std::uint32_t>(std::max(std::atoi(argv[1]), 1))
+      : std::max(std::thread::hardware_concurrency(), 1u);
+
+  run_single_reactor();
+  for (std::uint32_t shardCount = 1; shardCount < maxShardCount;
+       shardCount *= 2) {
+    run_sharded(shardCount);
+  }
+  run_sharded(maxShardCount);
+  return 0;
+}
+
+#else // UNIFEX_NO_EPOLL
+
+#include <cstdio>
+int main() {
+  printf("epoll support not found\n");
+  return 0;
+}
+
+#endif // UNIFEX_NO_EPOLL
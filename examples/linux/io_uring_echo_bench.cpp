@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_LIBURING || !UNIFEX_NO_EPOLL
+
+#include <unifex/defer.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/just.hpp>
+#include <unifex/let_value.hpp>
+#if !UNIFEX_NO_EPOLL
+#include <unifex/linux/io_epoll_context.hpp>
+#endif
+#if !UNIFEX_NO_LIBURING
+#include <unifex/linux/io_uring_context.hpp>
+#endif
+#include <unifex/repeat_effect_until.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/sequence.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+#include <unifex/when_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+
+namespace {
+
+template <typename S>
+auto discard_value(S&& s) {
+  return then((S &&) s, [](auto&&...) noexcept {});
+}
+
+constexpr std::size_t messageSize = 64;
+constexpr int connectionCount = 16;
+constexpr int requestsPerConnection = 2000;
+
+// One client/server socket pair. The client sends a message and waits for
+// the echo 'requestsPerConnection' times, then closes its end. The server
+// echoes whatever it reads until it sees the end of the stream.
+template <typename Context>
+struct connection {
+  using socket = typename Context::async_socket;
+
+  std::optional<socket> client;
+  std::optional<socket> server;
+  std::array<std::byte, messageSize> request{};
+  std::array<std::byte, messageSize> reply{};
+  std::array<std::byte, messageSize> echo{};
+  ssize_t echoed = 0;
+  int requests = 0;
+
+  auto serve() {
+    return repeat_effect_until(
+        defer([this] {
+          return let_value(
+              async_read_some(*server, span{echo.data(), echo.size()}),
+              [this](ssize_t n) {
+                echoed = n;
+                return discard_value(async_write_some(
+                    *server, span{echo.data(), std::size_t(n)}));
+              });
+        }),
+        [this] { return echoed == 0; });
+  }
+
+  auto drive() {
+    return sequence(
+        repeat_effect_until(
+            defer([this] {
+              return sequence(
+                  discard_value(async_write_some(
+                      *client, span{request.data(), request.size()})),
+                  discard_value(async_read_some(
+                      *client, span{reply.data(), reply.size()})));
+            }),
+            [this] { return ++requests == requestsPerConnection; }),
+        close_client());
+  }
+
+  // io_uring_context sockets are closed with async_close(); the others are
+  // closed by destroying them.
+  auto close_client() {
+    if constexpr (is_callable_v<tag_t<async_close>, socket&>) {
+      return async_close(*client);
+    } else {
+      return then(just(), [this] { client.reset(); });
+    }
+  }
+};
+
+// Runs the echo loop on a fresh 'Context' and prints its throughput.
+template <typename Context>
+void run_echo(const char* name) {
+  Context ctx;
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(
+      s, socket_address::ipv4_loopback(), connectionCount);
+  const auto address = listener.local_address();
+
+  std::vector<std::unique_ptr<connection<Context>>> connections;
+  for (int i = 0; i < connectionCount; ++i) {
+    auto c = std::make_unique<connection<Context>>();
+    c->client.emplace(std::move(*sync_wait(async_connect(s, address))));
+    c->server.emplace(std::move(*sync_wait(async_accept(listener))));
+    connections.push_back(std::move(c));
+  }
+
+  // All of the I/O runs on the context's thread; the waiting threads just
+  // block until their connection is done. So this is the echo throughput
+  // of a single core, counting both the client and the server side.
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> waiters;
+  for (auto& c : connections) {
+    waiters.emplace_back([&c] { sync_wait(when_all(c->serve(), c->drive())); });
+  }
+  for (auto& waiter : waiters) {
+    waiter.join();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+  const std::uint64_t requestCount =
+      std::uint64_t(connectionCount) * requestsPerConnection;
+  std::printf(
+      "%-20s %10llu requests in %6lld ms (%.0f requests/s)\n",
+      name,
+      static_cast<unsigned long long>(requestCount),
+      static_cast<long long>(ms.count()),
+      ms.count() > 0 ? requestCount * 1000.0 / ms.count() : 0.0);
+#if !UNIFEX_NO_LIBURING && UNIFEX_IO_URING_STATS
+  if constexpr (std::is_same_v<Context, io_uring_context>) {
+    const auto stats = ctx.snapshot();
+    std::printf(
+        "%10llu enters, %.1f SQEs/enter, %10llu reaps, %.1f CQEs/reap\n",
+        static_cast<unsigned long long>(stats.enters),
+        stats.sqes_per_enter(),
+        static_cast<unsigned long long>(stats.reaps),
+        stats.cqes_per_reap());
+  }
+#endif
+}
+
+} // anonymous namespace
+
+// The same loopback echo loop on each backend that's available, so that
+// their results can be compared directly.
+int main() {
+#if !UNIFEX_NO_LIBURING
+  run_echo<io_uring_context>("io_uring echo");
+#endif
+#if !UNIFEX_NO_EPOLL
+  run_echo<io_epoll_context>("epoll echo");
+#endif
+  return 0;
+}
+
+#else // UNIFEX_NO_LIBURING && UNIFEX_NO_EPOLL
+
+#include <cstdio>
+int main() {
+  printf("neither liburing nor epoll support found\n");
+  return 0;
+}
+
+#endif // UNIFEX_NO_LIBURING && UNIFEX_NO_EPOLL
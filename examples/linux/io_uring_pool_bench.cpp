@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_LIBURING
+
+#include <unifex/defer.hpp>
+#include <unifex/file_concepts.hpp>
+#include <unifex/linux/io_uring_pool.hpp>
+#include <unifex/repeat_effect_until.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/span.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+#include <unifex/when_all.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+
+namespace {
+
+template <typename S>
+auto discard_value(S&& s) {
+  return then((S &&) s, [](auto&&...) noexcept {});
+}
+
+constexpr std::size_t blockSize = 4096;
+constexpr std::size_t blockCount = 256;
+constexpr std::size_t readersPerRing = 8;
+constexpr int readsPerReader = 5000;
+
+const char* const fileName = "io_uring_pool_bench.dat";
+
+// Reads 'readsPerReader' blocks from the page cache, one after the other.
+// Each read after the first is submitted from the ring's own thread when the
+// previous one completes.
+struct reader {
+  io_uring_context::async_read_only_file* file = nullptr;
+  std::array<std::byte, blockSize> buffer{};
+  std::size_t block = 0;
+  int reads = 0;
+
+  auto run() {
+    return repeat_effect_until(
+        defer([this] {
+          return discard_value(async_read_some_at(
+              *file,
+              block * blockSize,
+              span{buffer.data(), buffer.size()}));
+        }),
+        [this] {
+          block = (block + 7) % blockCount;
+          return ++reads == readsPerReader;
+        });
+  }
+};
+
+// The readers of one ring, which all share a file opened on that ring.
+struct ring_readers {
+  std::optional<io_uring_context::async_read_only_file> file;
+  std::array<reader, readersPerRing> readers;
+
+  template <std::size_t... Is>
+  auto run(std::index_sequence<Is...>) {
+    return when_all(readers[Is].run()...);
+  }
+};
+
+void run(std::uint32_t ringCount) {
+  io_uring_pool::options opts;
+  opts.ringCount = ringCount;
+  io_uring_pool pool{opts};
+
+  std::vector<std::unique_ptr<ring_readers>> rings;
+  for (std::uint32_t i = 0; i < ringCount; ++i) {
+    auto r = std::make_unique<ring_readers>();
+    r->file.emplace(open_file_read_only(pool.get_ring_scheduler(i), fileName));
+    for (std::size_t j = 0; j < readersPerRing; ++j) {
+      r->readers[j].file = &*r->file;
+      r->readers[j].block = j;
+    }
+    rings.push_back(std::move(r));
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> waiters;
+  for (auto& r : rings) {
+    waiters.emplace_back([&r] {
+      sync_wait(r->run(std::make_index_sequence<readersPerRing>{}));
+    });
+  }
+  for (auto& waiter : waiters) {
+    waiter.join();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+  const std::uint64_t readCount =
+      std::uint64_t(ringCount) * readersPerRing * readsPerReader;
+  std::printf(
+      "%2u rings %10llu reads in %8lld us (%.0f reads/s)\n",
+      ringCount,
+      static_cast<unsigned long long>(readCount),
+      static_cast<long long>(us.count()),
+      us.count() > 0 ? readCount * 1000000.0 / us.count() : 0.0);
+}
+
+} // anonymous namespace
+
+// Usage: io_uring_pool_bench [max-ring-count]
+// The ring count defaults to the number of CPUs.
+int main(int argc, char** argv) {
+  {
+    auto file = std::unique_ptr<std::FILE, int (*)(std::FILE*)>{
+        std::fopen(fileName, "wb"), &std::fclose};
+    if (!file) {
+      std::perror(fileName);
+      return 1;
+    }
+    const std::array<char, blockSize> block{};
+    for (std::size_t i = 0; i < blockCount; ++i) {
+      std::fwrite(block.data(), 1, block.size(), file.get());
+    }
+  }
+  scope_guard removeFile = []() noexcept {
+    std::remove(fileName);
+  };
+
+  // Reads of a cached file complete inline when they are submitted, so
+  // this measures how the submission and completion work of the rings
+  // scales with the number of cores driving them.
+  const std::uint32_t maxRingCount = argc > 1
+      ? static_cast<std::uint32_t>(std::max(std::atoi(argv[1]), 1))
+      : std::max(std::thread::hardware_concurrency(), 1u);
+  for (std::uint32_t ringCount = 1; ringCount < maxRingCount; ringCount *= 2) {
+    run(ringCount);
+  }
+  run(maxRingCount);
+  return 0;
+}
+
+#else // UNIFEX_NO_LIBURING
+
+#include <cstdio>
+int main() {
+  printf("liburing support not found\n");
+  return 0;
+}
+
+#endif // UNIFEX_NO_LIBURING
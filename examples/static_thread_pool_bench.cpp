@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/async_scope.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/static_thread_pool.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+
+using namespace unifex;
+
+namespace {
+
+// Each task spawns two children until 'depth' reaches zero, so most of the
+// tasks are enqueued from the pool's own worker threads.
+struct fan_out {
+  static_thread_pool::scheduler sched;
+  async_scope& scope;
+  std::atomic<std::uint64_t>& leaves;
+  std::uint64_t leafCount;
+  std::promise<void>& done;
+
+  void operator()(int depth) const noexcept {
+    if (depth == 0) {
+      if (leaves.fetch_add(1, std::memory_order_relaxed) + 1 == leafCount) {
+        done.set_value();
+      }
+      return;
+    }
+    for (int i = 0; i < 2; ++i) {
+      scope.spawn_call_on(sched, [self = *this, depth]() noexcept {
+        self(depth - 1);
+      });
+    }
+  }
+};
+
+void print_result(
+    const char* name,
+    std::uint64_t taskCount,
+    std::chrono::steady_clock::duration elapsed) {
+  const auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+  std::printf(
+      "%-20s %10llu tasks in %6lld ms (%.0f tasks/s)\n",
+      name,
+      static_cast<unsigned long long>(taskCount),
+      static_cast<long long>(ms.count()),
+      ms.count() > 0 ? taskCount * 1000.0 / ms.count() : 0.0);
+}
+
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+// Upper bound, in ns, of the latency bucket that the given fraction of the
+// tasks fall into.
+std::uint64_t latency_percentile(
+    const static_thread_pool::stats& stats, double fraction) {
+  const auto target = static_cast<std::uint64_t>(stats.tasksExecuted * fraction);
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < stats.latencyHistogram.size(); ++i) {
+    seen += stats.latencyHistogram[i];
+    if (seen >= target) {
+      return std::uint64_t{2} << i;
+    }
+  }
+  return std::uint64_t{2} << (stats.latencyHistogram.size() - 1);
+}
+
+void print_stats(const static_thread_pool& tpContext) {
+  const auto stats = tpContext.snapshot();
+  std::printf(
+      "%20s stolen %llu, failed try_push %llu, failed try_pop %llu, "
+      "blocking push %llu, parks %llu (%lld ms), "
+      "latency p50 < %llu ns, p99 < %llu ns\n",
+      "",
+      static_cast<unsigned long long>(stats.tasksStolen),
+      static_cast<unsigned long long>(stats.failedTryPushes),
+      static_cast<unsigned long long>(stats.failedTryPops),
+      static_cast<unsigned long long>(stats.blockingPushes),
+      static_cast<unsigned long long>(stats.parks),
+      static_cast<long long>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              stats.parkedTime)
+              .count()),
+      static_cast<unsigned long long>(latency_percentile(stats, 0.5)),
+      static_cast<unsigned long long>(latency_percentile(stats, 0.99)));
+}
+#endif
+
+void run_benchmark(
+    const char* name, static_thread_pool::queue_policy policy, bool lifoSlot) {
+  constexpr int depth = 16;
+  constexpr int iterations = 5;
+
+  static_thread_pool::options opts;
+  opts.queuePolicy = policy;
+  opts.lifoSlot = lifoSlot;
+  static_thread_pool tpContext{opts};
+  auto tp = tpContext.get_scheduler();
+
+  std::uint64_t totalTasks = 0;
+  const auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < iterations; ++i) {
+    async_scope scope;
+    std::atomic<std::uint64_t> leaves{0};
+    std::promise<void> done;
+    scope.spawn_call_on(tp, [&]() noexcept {
+      fan_out{tp, scope, leaves, std::uint64_t{1} << depth, done}(depth);
+    });
+
+    // The scope stops accepting new work once complete() is started, so
+    // wait for the whole tree to have run first.
+    done.get_future().wait();
+    sync_wait(scope.complete());
+
+    totalTasks += (std::uint64_t{1} << (depth + 1)) - 1;
+  }
+
+  print_result(name, totalTasks, std::chrono::steady_clock::now() - start);
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+  print_stats(tpContext);
+#endif
+}
+
+// Submits many independent tasks from a thread outside of the pool, either
+// one at a time or through a submission_batch.
+void run_submission_benchmark(const char* name, bool batched) {
+  constexpr std::uint64_t taskCount = 200000;
+
+  static_thread_pool tpContext;
+  auto tp = tpContext.get_scheduler();
+
+  async_scope scope;
+  std::atomic<std::uint64_t> remaining{taskCount};
+  std::promise<void> done;
+  auto task = [&]() noexcept {
+    if (remaining.fetch_sub(1, std::memory_order_relaxed) == 1) {
+      done.set_value();
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  if (batched) {
+    static_thread_pool::submission_batch batch{tpContext};
+    for (std::uint64_t i = 0; i < taskCount; ++i) {
+      scope.spawn_call_on(tp, task);
+    }
+  } else {
+    for (std::uint64_t i = 0; i < taskCount; ++i) {
+      scope.spawn_call_on(tp, task);
+    }
+  }
+  done.get_future().wait();
+  print_result(name, taskCount, std::chrono::steady_clock::now() - start);
+
+  sync_wait(scope.complete());
+}
+
+} // anonymous namespace
+
+int main() {
+  using queue_policy = static_thread_pool::queue_policy;
+  run_benchmark("round_robin", queue_policy::round_robin, false);
+  run_benchmark("round_robin+lifo", queue_policy::round_robin, true);
+  run_benchmark("work_stealing", queue_policy::work_stealing, false);
+  run_benchmark("work_stealing+lifo", queue_policy::work_stealing, true);
+  run_submission_benchmark("submit", false);
+  run_submission_benchmark("submit+batch", true);
+  return 0;
+}
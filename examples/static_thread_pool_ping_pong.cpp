@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/static_thread_pool.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace unifex;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Measures the round-trip latency of handing a single task at a time to an
+// otherwise idle pool and waiting for it to complete.
+void run_benchmark(
+    const char* name, const static_thread_pool::options& opts) {
+  constexpr int iterations = 20000;
+
+  static_thread_pool tpContext{opts};
+  auto tp = tpContext.get_scheduler();
+
+  std::vector<std::chrono::nanoseconds> samples;
+  samples.reserve(iterations);
+
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    sync_wait(then(schedule(tp), [] {}));
+    samples.push_back(std::chrono::steady_clock::now() - start);
+  }
+
+  std::sort(samples.begin(), samples.end());
+  std::chrono::nanoseconds total{0};
+  for (auto sample : samples) {
+    total += sample;
+  }
+
+  std::printf(
+      "%-16s mean %8lld ns, p50 %8lld ns, p99 %8lld ns\n",
+      name,
+      static_cast<long long>((total / iterations).count()),
+      static_cast<long long>(samples[iterations / 2].count()),
+      static_cast<long long>(samples[iterations * 99 / 100].count()));
+}
+
+} // anonymous namespace
+
+int main() {
+  static_thread_pool::options park;
+  park.threadCount = 2;
+
+  static_thread_pool::options spin = park;
+  spin.spinDuration = 50us;
+
+  run_benchmark("park", park);
+  run_benchmark("spin_then_park", spin);
+  return 0;
+}
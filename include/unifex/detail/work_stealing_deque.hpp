@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/config.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <unifex/detail/prologue.hpp>
+
+namespace unifex {
+
+// A bounded, lock-free, single-owner/multi-thief deque of pointers.
+//
+// This is the Chase-Lev work-stealing deque, using the memory orderings
+// described in "Correct and Efficient Work-Stealing for Weak Memory Models"
+// (Le, Pop, Cohen, Zappa Nardelli - PPoPP 2013).
+//
+// The owning thread pushes and pops items at the 'bottom' of the deque
+// in LIFO order. Any other thread may concurrently steal items from the
+// 'top' of the deque in FIFO order.
+//
+// The deque does not grow. push() returns false when the deque is full,
+// in which case the caller is expected to fall back to some other queue.
+template <typename Item, std::size_t Capacity>
+class work_stealing_deque {
+  static_assert(
+      Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+      "Capacity must be a power of two");
+
+ public:
+  work_stealing_deque() noexcept {
+    for (auto& slot : slots_) {
+      slot.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  work_stealing_deque(const work_stealing_deque&) = delete;
+  work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+  ~work_stealing_deque() {
+    UNIFEX_ASSERT(empty());
+  }
+
+  // Push an item onto the bottom of the deque.
+  // Must only be called by the owning thread.
+  //
+  // Returns false if the deque was full.
+  [[nodiscard]] bool push(Item* item) noexcept {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    const std::int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= static_cast<std::int64_t>(Capacity)) {
+      return false;
+    }
+    slots_[b & mask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Pop the most recently pushed item from the bottom of the deque.
+  // Must only be called by the owning thread.
+  //
+  // Returns nullptr if the deque was empty or if the last item was
+  // concurrently stolen by another thread.
+  [[nodiscard]] Item* pop() noexcept {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Deque was empty.
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Item* item = slots_[b & mask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last item in the deque - race with thieves for it.
+      if (!top_.compare_exchange_strong(
+              t,
+              t + 1,
+              std::memory_order_seq_cst,
+              std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Steal the least recently pushed item from the top of the deque.
+  // May be called from any thread.
+  //
+  // Returns nullptr if the deque was empty or if we lost a race with the
+  // owner or another thief for the item.
+  [[nodiscard]] Item* steal() noexcept {
+    std::int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+
+    Item* item = slots_[t & mask].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(
+            t,
+            t + 1,
+            std::memory_order_seq_cst,
+            std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  // An estimate of the number of items in the deque.
+  // Only exact when called by the owning thread with no concurrent thieves.
+  [[nodiscard]] std::size_t size() const noexcept {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    const std::int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? static_cast<std::size_t>(b - t) : 0;
+  }
+
+  [[nodiscard]] bool empty() const noexcept {
+    return size() == 0;
+  }
+
+ private:
+  static constexpr std::int64_t mask = static_cast<std::int64_t>(Capacity - 1);
+
+  // Keep the indices modified by thieves and by the owner on separate
+  // cache-lines to avoid false sharing.
+  alignas(64) std::atomic<std::int64_t> top_{0};
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+  alignas(64) std::array<std::atomic<Item*>, Capacity> slots_;
+};
+
+} // namespace unifex
+
+#include <unifex/detail/epilogue.hpp>
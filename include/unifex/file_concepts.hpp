@@ -20,6 +20,11 @@
 #include <unifex/io_concepts.hpp>
 
 #include <unifex/filesystem.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/then.hpp>
+#include <unifex/type_traits.hpp>
+
+#include <utility>
 
 #include <unifex/detail/prologue.hpp>
 
@@ -69,11 +74,187 @@ inline const struct open_file_read_write_cpo {
     return unifex::tag_invoke(*this, (Executor &&) executor, path);
   }
 } open_file_read_write{};
+
+// Asynchronous versions of the open_file_* CPOs that return a sender of the
+// file. Schedulers that don't customise these fall back to calling the
+// blocking open_file_* CPO from a task scheduled onto that scheduler, which
+// at least keeps the blocking call off the calling thread.
+template <typename OpenCPO>
+struct _async_open_fn {
+  template(typename Scheduler)
+    (requires tag_invocable<_async_open_fn, Scheduler, const filesystem::path&>)
+  auto operator()(Scheduler&& s, const filesystem::path& path) const
+      noexcept(is_nothrow_tag_invocable_v<
+               _async_open_fn,
+               Scheduler,
+               const filesystem::path&>)
+          -> tag_invoke_result_t<
+              _async_open_fn,
+              Scheduler,
+              const filesystem::path&> {
+    return unifex::tag_invoke(*this, (Scheduler &&) s, path);
+  }
+
+  template(typename Scheduler)
+    (requires (!tag_invocable<_async_open_fn, Scheduler, const filesystem::path&>) AND
+        scheduler<remove_cvref_t<Scheduler>> AND
+        tag_invocable<OpenCPO, remove_cvref_t<Scheduler>&, const filesystem::path&>)
+  auto operator()(Scheduler&& s, const filesystem::path& path) const {
+    auto sender = schedule(s);
+    return then(
+        std::move(sender),
+        [s = (Scheduler &&) s, path]() mutable { return OpenCPO{}(s, path); });
+  }
+};
+
+inline constexpr _async_open_fn<open_file_read_only_cpo>
+    async_open_file_read_only{};
+inline constexpr _async_open_fn<open_file_write_only_cpo>
+    async_open_file_write_only{};
+inline constexpr _async_open_fn<open_file_read_write_cpo>
+    async_open_file_read_write{};
+
+// Blocking operations on an open file, made on the calling thread. Each one
+// throws std::system_error if it fails.
+
+// Closes the file. The file must not be used afterwards other than to
+// destroy it.
+inline const struct close_file_cpo {
+  template <typename File>
+  auto operator()(File& file) const
+      noexcept(is_nothrow_tag_invocable_v<close_file_cpo, File&>)
+          -> tag_invoke_result_t<close_file_cpo, File&> {
+    return unifex::tag_invoke(*this, file);
+  }
+} close_file{};
+
+// Flushes the file's data and metadata to storage.
+inline const struct fsync_file_cpo {
+  template <typename File>
+  auto operator()(File& file) const
+      noexcept(is_nothrow_tag_invocable_v<fsync_file_cpo, File&>)
+          -> tag_invoke_result_t<fsync_file_cpo, File&> {
+    return unifex::tag_invoke(*this, file);
+  }
+} fsync_file{};
+
+// Flushes the file's data, and only the metadata needed to read it back,
+// to storage.
+inline const struct fdatasync_file_cpo {
+  template <typename File>
+  auto operator()(File& file) const
+      noexcept(is_nothrow_tag_invocable_v<fdatasync_file_cpo, File&>)
+          -> tag_invoke_result_t<fdatasync_file_cpo, File&> {
+    return unifex::tag_invoke(*this, file);
+  }
+} fdatasync_file{};
+
+// Allocates storage for the byte range [offset, offset + length), extending
+// the file if necessary.
+inline const struct fallocate_file_cpo {
+  template <typename File>
+  auto operator()(
+      File& file,
+      typename File::offset_t offset,
+      typename File::offset_t length) const
+      noexcept(is_nothrow_tag_invocable_v<
+               fallocate_file_cpo,
+               File&,
+               typename File::offset_t,
+               typename File::offset_t>)
+          -> tag_invoke_result_t<
+              fallocate_file_cpo,
+              File&,
+              typename File::offset_t,
+              typename File::offset_t> {
+    return unifex::tag_invoke(*this, file, offset, length);
+  }
+} fallocate_file{};
+
+// Queries the file's size, timestamps and other attributes. Returns the
+// platform's file status structure.
+inline const struct statx_file_cpo {
+  template <typename File>
+  auto operator()(File& file) const
+      noexcept(is_nothrow_tag_invocable_v<statx_file_cpo, File&>)
+          -> tag_invoke_result_t<statx_file_cpo, File&> {
+    return unifex::tag_invoke(*this, file);
+  }
+} statx_file{};
+
+// Sender-returning versions of the operations above. Files that don't
+// customise these fall back to calling the blocking CPO from a task
+// scheduled onto get_scheduler(file), the same way the async_open_file_*
+// CPOs fall back to open_file_*.
+template <typename File>
+UNIFEX_CONCEPT_FRAGMENT( //
+  _has_scheduler,
+    requires(const File& file) (
+      get_scheduler(file)
+    ));
+template <typename File>
+UNIFEX_CONCEPT //
+  _has_scheduler = //
+    UNIFEX_FRAGMENT(_filesystem::_has_scheduler, File);
+
+template <typename BlockingCPO>
+struct _async_file_fn {
+  template(typename File, typename... Args)
+    (requires tag_invocable<_async_file_fn, File&, Args...>)
+  auto operator()(File& file, Args... args) const
+      noexcept(is_nothrow_tag_invocable_v<_async_file_fn, File&, Args...>)
+          -> tag_invoke_result_t<_async_file_fn, File&, Args...> {
+    return unifex::tag_invoke(*this, file, args...);
+  }
+
+  // The file must outlive the operation, as with any other I/O on it.
+  template(typename File, typename... Args)
+    (requires (!tag_invocable<_async_file_fn, File&, Args...>) AND
+        _has_scheduler<File> AND
+        tag_invocable<BlockingCPO, File&, Args...>)
+  auto operator()(File& file, Args... args) const {
+    return then(
+        schedule(get_scheduler(std::as_const(file))),
+        [&file, args...]() { return BlockingCPO{}(file, args...); });
+  }
+};
+
+// Closes the file. The file must not be used afterwards other than to
+// destroy it.
+inline constexpr _async_file_fn<close_file_cpo> async_close{};
+
+// Flushes the file's data and metadata to storage.
+inline constexpr _async_file_fn<fsync_file_cpo> async_fsync{};
+
+// Flushes the file's data, and only the metadata needed to read it back,
+// to storage.
+inline constexpr _async_file_fn<fdatasync_file_cpo> async_fdatasync{};
+
+// Allocates storage for the byte range [offset, offset + length), extending
+// the file if necessary. Called as async_fallocate(file, offset, length).
+inline constexpr _async_file_fn<fallocate_file_cpo> async_fallocate{};
+
+// Queries the file's size, timestamps and other attributes. The value type
+// is the platform's file status structure.
+inline constexpr _async_file_fn<statx_file_cpo> async_statx{};
 } // namespace _filesystem
 
 using _filesystem::open_file_read_only;
 using _filesystem::open_file_write_only;
 using _filesystem::open_file_read_write;
+using _filesystem::async_open_file_read_only;
+using _filesystem::async_open_file_write_only;
+using _filesystem::async_open_file_read_write;
+using _filesystem::close_file;
+using _filesystem::fsync_file;
+using _filesystem::fdatasync_file;
+using _filesystem::fallocate_file;
+using _filesystem::statx_file;
+using _filesystem::async_close;
+using _filesystem::async_fsync;
+using _filesystem::async_fdatasync;
+using _filesystem::async_fallocate;
+using _filesystem::async_statx;
 } // namespace unifex
 
 #include <unifex/detail/epilogue.hpp>
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/tag_invoke.hpp>
+
+#include <cstdint>
+
+#include <unifex/detail/prologue.hpp>
+
+namespace unifex
+{
+    // The relative urgency of a piece of work. Schedulers that support
+    // priorities run higher priority work first.
+    enum class priority : std::uint8_t {
+        high,
+        normal,
+        background
+    };
+
+    namespace _get_priority {
+        struct _fn {
+            template(typename PriorityProvider)
+                (requires tag_invocable<_fn, const PriorityProvider&>)
+            constexpr auto operator()(const PriorityProvider& provider) const noexcept
+                -> tag_invoke_result_t<_fn, const PriorityProvider&> {
+                return tag_invoke(_fn{}, provider);
+            }
+
+            template(typename PriorityProvider)
+                (requires (!tag_invocable<_fn, const PriorityProvider&>))
+            constexpr priority operator()([[maybe_unused]] const PriorityProvider&) const noexcept {
+                return priority::normal;
+            }
+        };
+    }
+
+    inline constexpr _get_priority::_fn get_priority{};
+}
+
+#include <unifex/detail/epilogue.hpp>
@@ -193,12 +193,32 @@ inline const struct async_write_some_at_cpo {
         *this, file);
   }
 } async_write_some_at{};
+
+// with_timeout
+//
+// Takes the sender returned by one of the I/O CPOs above and returns a
+// sender of the same operation that fails with std::errc::timed_out if the
+// operation has not completed within 'timeout'. Contexts that support it
+// bound the operation in the kernel rather than arming a separate timer.
+//
+inline const struct with_timeout_cpo {
+  template <typename IoSender, typename Duration>
+  auto operator()(IoSender&& sender, Duration timeout) const
+      noexcept(is_nothrow_tag_invocable_v<
+               with_timeout_cpo,
+               IoSender,
+               Duration>)
+          -> tag_invoke_result_t<with_timeout_cpo, IoSender, Duration> {
+    return unifex::tag_invoke(*this, (IoSender &&) sender, timeout);
+  }
+} with_timeout{};
 } // namespace _io_cpo
 
 using _io_cpo::async_read_some;
 using _io_cpo::async_write_some;
 using _io_cpo::async_read_some_at;
 using _io_cpo::async_write_some_at;
+using _io_cpo::with_timeout;
 
 } // namespace unifex
 
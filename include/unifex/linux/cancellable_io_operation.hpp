@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/get_stop_token.hpp>
+#include <unifex/manual_lifetime.hpp>
+#include <unifex/stop_token_concepts.hpp>
+
+#include <atomic>
+
+#include <unifex/detail/prologue.hpp>
+
+namespace unifex {
+namespace linuxos {
+
+// The handshake between a stop request, which may arrive on any thread, and
+// an operation of io_uring_context or io_epoll_context that completes on the
+// context's I/O thread.
+//
+// The stop callback queues a cancellation request onto the I/O thread, which
+// calls Derived::cancel_io(). The request refers to the operation, so if the
+// operation completes while the request is still queued, ready_to_deliver()
+// returns false and the request delivers the result once it has run.
+//
+// Derived befriends this class and provides:
+//  - 'is_stop_ever_possible', whether to listen for stop requests at all;
+//  - 'context_' and 'receiver_';
+//  - 'deliver()', which sends the result to the receiver;
+//  - 'cancel_io()', which runs on the I/O thread after a stop request and
+//    stops the I/O, or does nothing if none is in flight, since the operation
+//    sees the stop request when it next gets to run. It returns false if it
+//    can't do that yet, after queueing cancel_operation() to run again.
+template <typename Derived, typename Context, typename Receiver>
+class cancellable_io_operation {
+  using operation_base = typename Context::operation_base;
+
+ protected:
+  cancellable_io_operation() noexcept = default;
+
+  // Call from start().
+  void listen_for_stop() noexcept {
+    if constexpr (Derived::is_stop_ever_possible) {
+      stopCallback_.construct(
+          get_stop_token(derived().receiver_), cancel_callback{*this});
+    }
+  }
+
+  bool cancel_requested() const noexcept {
+    if constexpr (Derived::is_stop_ever_possible) {
+      return cancelRequested_.load(std::memory_order_acquire);
+    } else {
+      return false;
+    }
+  }
+
+  // Call on the I/O thread once the operation has its result. Returns
+  // whether to deliver it now.
+  bool ready_to_deliver() noexcept {
+    if constexpr (Derived::is_stop_ever_possible) {
+      stopCallback_.destruct();
+      if (cancelRequested_.load(std::memory_order_acquire) &&
+          !cancelHandled_) {
+        completionPending_ = true;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  operation_base* cancel_operation() noexcept {
+    return &cancelOp_;
+  }
+
+ private:
+  Derived& derived() noexcept {
+    return static_cast<Derived&>(*this);
+  }
+
+  // Called on whichever thread requested stop.
+  void request_stop() noexcept {
+    cancelRequested_.store(true, std::memory_order_release);
+    auto& context = derived().context_;
+    if (context.is_running_on_io_thread()) {
+      context.schedule_local(&cancelOp_);
+    } else {
+      context.schedule_remote(&cancelOp_);
+    }
+  }
+
+  static void on_cancel(operation_base* op) noexcept {
+    auto& self = static_cast<cancel_op*>(op)->op_;
+    if (!self.completionPending_ && !self.derived().cancel_io()) {
+      return;
+    }
+    self.cancelHandled_ = true;
+    if (self.completionPending_) {
+      self.derived().deliver();
+    }
+  }
+
+  struct cancel_callback {
+    cancellable_io_operation& op_;
+
+    void operator()() noexcept {
+      op_.request_stop();
+    }
+  };
+
+  struct cancel_op : operation_base {
+    explicit cancel_op(cancellable_io_operation& op) noexcept : op_(op) {
+      this->execute_ = &cancellable_io_operation::on_cancel;
+    }
+    cancellable_io_operation& op_;
+  };
+
+  // Only cancelRequested_ is touched off the I/O thread.
+  bool cancelHandled_ = false;
+  bool completionPending_ = false;
+  std::atomic<bool> cancelRequested_{false};
+  cancel_op cancelOp_{*this};
+  manual_lifetime<typename stop_token_type_t<
+      Receiver>::template callback_type<cancel_callback>>
+      stopCallback_;
+};
+
+} // namespace linuxos
+} // namespace unifex
+
+#include <unifex/detail/epilogue.hpp>
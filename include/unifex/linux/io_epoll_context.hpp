@@ -21,33 +21,55 @@
 #include <unifex/detail/atomic_intrusive_queue.hpp>
 #include <unifex/detail/intrusive_heap.hpp>
 #include <unifex/detail/intrusive_queue.hpp>
+#include <unifex/file_concepts.hpp>
+#include <unifex/filesystem.hpp>
 #include <unifex/pipe_concepts.hpp>
 #include <unifex/get_stop_token.hpp>
 #include <unifex/manual_lifetime.hpp>
+#include <unifex/ready_done_sender.hpp>
 #include <unifex/receiver_concepts.hpp>
+#include <unifex/socket_concepts.hpp>
 #include <unifex/span.hpp>
 #include <unifex/stop_token_concepts.hpp>
+#include <unifex/stream_concepts.hpp>
+#include <unifex/type_traits.hpp>
 
+#include <unifex/linux/cancellable_io_operation.hpp>
 #include <unifex/linux/monotonic_clock.hpp>
 #include <unifex/linux/safe_file_descriptor.hpp>
+#include <unifex/linux/socket_address.hpp>
 
 #include <atomic>
+#include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <system_error>
 #include <utility>
+#include <vector>
 
 #include <sys/uio.h>
 #include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 
 #include <unifex/detail/prologue.hpp>
 
 namespace unifex {
 namespace linuxos {
 
+// Construction-time parameters for an io_epoll_context.
+struct io_epoll_context_options {
+  // The most events that a single epoll_wait() call returns. Larger batches
+  // take fewer syscalls to drain when many sockets become ready at once.
+  std::uint32_t maxEventsPerWait = 256;
+};
+
 class io_epoll_context {
  public:
+  using options = io_epoll_context_options;
+
   class schedule_sender;
   class schedule_at_sender;
   template <typename Duration>
@@ -55,11 +77,26 @@ class io_epoll_context {
   class scheduler;
   class read_sender;
   class write_sender;
+  template <typename Op>
+  class socket_sender;
   class async_reader;
   class async_writer;
+  class async_file;
+  class async_socket;
+  class async_listener;
+  class accept_stream;
+
+  struct recv_op;
+  struct send_op;
+  struct receive_message_op;
+  struct send_message_op;
+  struct accept_op;
+  struct connect_op;
 
   io_epoll_context();
 
+  explicit io_epoll_context(const options& opts);
+
   ~io_epoll_context();
 
   template <typename StopToken>
@@ -68,6 +105,9 @@ class io_epoll_context {
   scheduler get_scheduler() noexcept;
 
  private:
+  template <typename Derived, typename Context, typename Receiver>
+  friend class linuxos::cancellable_io_operation;
+
   struct operation_base {
     ~operation_base() {
       UNIFEX_ASSERT(enqueued_.load() == 0);
@@ -122,6 +162,40 @@ class io_epoll_context {
       time_point,
       &schedule_at_operation::dueTime_>;
 
+  // A socket's registration with the epoll set.
+  //
+  // Sockets are registered once, edge-triggered, when they are created and
+  // stay registered until they are closed. An operation first tries its
+  // syscall and only if that would block does it wait here for the next
+  // edge, so there are no epoll_ctl() calls per operation.
+  struct socket_registration : operation_base {
+    explicit socket_registration(
+        io_epoll_context& context, safe_file_descriptor fd) noexcept
+      : context_(context), fd_(std::move(fd)) {}
+
+    io_epoll_context& context_;
+    safe_file_descriptor fd_;
+
+    // The operations waiting for the socket to become readable or writable.
+    completion_base* reader_ = nullptr;
+    completion_base* writer_ = nullptr;
+  };
+
+  // Closes the socket straight away, but leaves freeing the registration to
+  // the I/O thread, which may be holding an event for it.
+  struct socket_closer {
+    void operator()(socket_registration* socket) const noexcept;
+
+    // Frees a registration queued onto the I/O thread.
+    static void on_closed(operation_base* op) noexcept;
+  };
+
+  using socket_handle = std::unique_ptr<socket_registration, socket_closer>;
+
+  // Takes ownership of the non-blocking socket 'fd' and registers it with
+  // the epoll set for 'events'.
+  socket_handle register_socket(int fd, std::uint32_t events);
+
   bool is_running_on_io_thread() const noexcept;
   void run_impl(const bool& shouldStop);
 
@@ -177,6 +251,9 @@ class io_epoll_context {
   ///////////////////
   // Data that is modified by I/O thread
 
+  // Buffer that epoll_wait() fills, sized to options::maxEventsPerWait.
+  std::vector<epoll_event> events_;
+
   // Local queue for operations that are ready to execute.
   operation_queue localQueue_;
 
@@ -494,6 +571,33 @@ class io_epoll_context::scheduler {
       tag_t<open_pipe>,
       scheduler s);
 
+  friend async_file tag_invoke(
+      tag_t<open_file_read_only>,
+      scheduler s,
+      const filesystem::path& path);
+  friend async_file tag_invoke(
+      tag_t<open_file_read_write>,
+      scheduler s,
+      const filesystem::path& path);
+  friend async_file tag_invoke(
+      tag_t<open_file_write_only>,
+      scheduler s,
+      const filesystem::path& path);
+
+  friend async_listener tag_invoke(
+      tag_t<open_listening_socket>,
+      scheduler s,
+      const socket_address& address,
+      int backlog);
+  friend socket_sender<connect_op> tag_invoke(
+      tag_t<async_connect>,
+      scheduler s,
+      const socket_address& address);
+  friend async_socket tag_invoke(
+      tag_t<open_datagram_socket>,
+      scheduler s,
+      const socket_address& address);
+
   friend bool operator==(scheduler a, scheduler b) noexcept {
     return a.context_ == b.context_;
   }
@@ -976,6 +1080,432 @@ class io_epoll_context::async_writer {
   safe_file_descriptor fd_;
 };
 
+// A regular file. epoll always reports regular files as ready, so the file
+// only provides the blocking operations from <unifex/file_concepts.hpp>, and
+// the async_* CPOs fall back to running them on the I/O thread. Reads and
+// writes are made on the I/O thread in the same way.
+class io_epoll_context::async_file {
+ public:
+  using offset_t = std::int64_t;
+
+  explicit async_file(io_epoll_context& context, int fd) noexcept
+      : context_(context), fd_(fd) {}
+
+ private:
+  friend scheduler tag_invoke(
+      tag_t<unifex::get_scheduler>, const async_file& file) noexcept {
+    return file.context_.get_scheduler();
+  }
+
+  friend auto tag_invoke(
+      tag_t<async_read_some_at>,
+      async_file& file,
+      offset_t offset,
+      span<std::byte> buffer) noexcept {
+    return then(
+        schedule(file.context_.get_scheduler()),
+        [&file, offset, buffer]() { return file.read_some_at(offset, buffer); });
+  }
+
+  friend auto tag_invoke(
+      tag_t<async_write_some_at>,
+      async_file& file,
+      offset_t offset,
+      span<const std::byte> buffer) noexcept {
+    return then(
+        schedule(file.context_.get_scheduler()),
+        [&file, offset, buffer]() { return file.write_some_at(offset, buffer); });
+  }
+
+  friend void tag_invoke(tag_t<close_file>, async_file& file);
+  friend void tag_invoke(tag_t<fsync_file>, async_file& file);
+  friend void tag_invoke(tag_t<fdatasync_file>, async_file& file);
+  friend void tag_invoke(
+      tag_t<fallocate_file>,
+      async_file& file,
+      offset_t offset,
+      offset_t length);
+  friend struct ::statx tag_invoke(tag_t<statx_file>, async_file& file);
+
+  ssize_t read_some_at(offset_t offset, span<std::byte> buffer);
+  ssize_t write_some_at(offset_t offset, span<const std::byte> buffer);
+
+  io_epoll_context& context_;
+  safe_file_descriptor fd_;
+};
+
+// An operation on a registered socket.
+//
+// Op::perform() makes the syscall without blocking and returns its result or
+// a negated errno. The operation runs it on the I/O thread as soon as it
+// starts, and only if it fails with EAGAIN does it wait for the socket to
+// become readable (or writable, if Op::is_write) and run it again.
+template <typename Op>
+class io_epoll_context::socket_sender {
+  using result_type = decltype(std::declval<Op&>().complete(0));
+
+  template <typename Receiver>
+  class operation
+    : private completion_base
+    , private linuxos::cancellable_io_operation<
+          operation<Receiver>,
+          io_epoll_context,
+          Receiver> {
+    friend io_epoll_context;
+    friend linuxos::
+        cancellable_io_operation<operation, io_epoll_context, Receiver>;
+
+    static constexpr bool is_stop_ever_possible =
+        !is_stop_never_possible_v<stop_token_type_t<Receiver>>;
+
+   public:
+    template <typename Receiver2>
+    explicit operation(Op&& op, Receiver2&& r)
+        : context_(op.socket().context_),
+          op_(std::move(op)),
+          receiver_((Receiver2 &&) r) {}
+
+    void start() noexcept {
+      this->listen_for_stop();
+
+      if (!context_.is_running_on_io_thread()) {
+        this->execute_ = &operation::on_schedule_complete;
+        context_.schedule_remote(this);
+      } else {
+        start_io();
+      }
+    }
+
+   private:
+    static void on_schedule_complete(operation_base* op) noexcept {
+      static_cast<operation*>(op)->start_io();
+    }
+
+    // Executed once an edge has been reported for the socket since the
+    // operation started waiting.
+    static void on_ready(operation_base* op) noexcept {
+      static_cast<operation*>(op)->start_io();
+    }
+
+    completion_base*& waiter() noexcept {
+      if constexpr (Op::is_write) {
+        return op_.socket().writer_;
+      } else {
+        return op_.socket().reader_;
+      }
+    }
+
+    void start_io() noexcept {
+      UNIFEX_ASSERT(context_.is_running_on_io_thread());
+
+      if constexpr (is_stop_ever_possible) {
+        if (get_stop_token(receiver_).stop_requested()) {
+          result_ = -ECANCELED;
+          complete();
+          return;
+        }
+      }
+
+      result_ = op_.perform();
+      if (result_ == -EAGAIN || result_ == -EWOULDBLOCK) {
+        // The registration is edge-triggered, so whatever made the socket
+        // ready before this attempt has been consumed by it, and the next
+        // edge is reported by a later epoll_wait().
+        UNIFEX_ASSERT(waiter() == nullptr);
+        this->execute_ = &operation::on_ready;
+        waiter() = this;
+        return;
+      }
+
+      complete();
+    }
+
+    void complete() noexcept {
+      if (this->ready_to_deliver()) {
+        deliver();
+      }
+    }
+
+    void deliver() noexcept {
+      if (result_ >= 0) {
+        UNIFEX_TRY {
+          unifex::set_value(std::move(receiver_), op_.complete(result_));
+        } UNIFEX_CATCH (...) {
+          unifex::set_error(std::move(receiver_), std::current_exception());
+        }
+      } else if (result_ == -ECANCELED) {
+        unifex::set_done(std::move(receiver_));
+      } else {
+        unifex::set_error(
+            std::move(receiver_),
+            std::error_code{-int(result_), std::system_category()});
+      }
+    }
+
+    bool cancel_io() noexcept {
+      if (waiter() == static_cast<completion_base*>(this)) {
+        waiter() = nullptr;
+        result_ = -ECANCELED;
+        complete();
+      }
+
+      // Otherwise the operation is queued to run start_io(), which will see
+      // the stop request.
+      return true;
+    }
+
+    io_epoll_context& context_;
+    Op op_;
+    Receiver receiver_;
+    ssize_t result_ = 0;
+  };
+
+ public:
+  template <
+      template <typename...> class Variant,
+      template <typename...> class Tuple>
+  using value_types = Variant<Tuple<result_type>>;
+
+  // Note: Only case it might complete with exception_ptr is if the
+  // receiver's set_value() exits with an exception.
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::error_code, std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit socket_sender(Op op) noexcept(
+      std::is_nothrow_move_constructible_v<Op>)
+    : op_(std::move(op)) {}
+
+  template <typename Receiver>
+  operation<remove_cvref_t<Receiver>> connect(Receiver&& r) && {
+    return operation<remove_cvref_t<Receiver>>{
+        std::move(op_), (Receiver &&) r};
+  }
+
+ private:
+  Op op_;
+};
+
+struct io_epoll_context::recv_op {
+  static constexpr bool is_write = false;
+
+  socket_registration& socket() noexcept {
+    return *socket_;
+  }
+
+  ssize_t perform() noexcept {
+    const ssize_t result =
+        ::recv(socket_->fd_.get(), buffer_.data(), buffer_.size(), 0);
+    return result < 0 ? -errno : result;
+  }
+
+  ssize_t complete(ssize_t result) noexcept {
+    return result;
+  }
+
+  socket_registration* socket_;
+  span<std::byte> buffer_;
+};
+
+struct io_epoll_context::send_op {
+  static constexpr bool is_write = true;
+
+  socket_registration& socket() noexcept {
+    return *socket_;
+  }
+
+  ssize_t perform() noexcept {
+    const ssize_t result = ::send(
+        socket_->fd_.get(), buffer_.data(), buffer_.size(), MSG_NOSIGNAL);
+    return result < 0 ? -errno : result;
+  }
+
+  ssize_t complete(ssize_t result) noexcept {
+    return result;
+  }
+
+  socket_registration* socket_;
+  span<const std::byte> buffer_;
+};
+
+struct io_epoll_context::receive_message_op {
+  static constexpr bool is_write = false;
+
+  socket_registration& socket() noexcept {
+    return *socket_;
+  }
+
+  ssize_t perform() noexcept {
+    const ssize_t result = ::recvmsg(socket_->fd_.get(), message_, 0);
+    return result < 0 ? -errno : result;
+  }
+
+  ssize_t complete(ssize_t result) noexcept {
+    return result;
+  }
+
+  socket_registration* socket_;
+  msghdr* message_;
+};
+
+struct io_epoll_context::send_message_op {
+  static constexpr bool is_write = true;
+
+  socket_registration& socket() noexcept {
+    return *socket_;
+  }
+
+  ssize_t perform() noexcept {
+    const ssize_t result =
+        ::sendmsg(socket_->fd_.get(), message_, MSG_NOSIGNAL);
+    return result < 0 ? -errno : result;
+  }
+
+  ssize_t complete(ssize_t result) noexcept {
+    return result;
+  }
+
+  socket_registration* socket_;
+  const msghdr* message_;
+};
+
+// A connected stream socket, or a datagram socket.
+class io_epoll_context::async_socket {
+ public:
+  // Takes ownership of 'fd', which must be a non-blocking socket, and
+  // registers it with the context's epoll set.
+  explicit async_socket(io_epoll_context& context, int fd)
+      : socket_(context.register_socket(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP)) {}
+
+  // The address the socket is bound to.
+  socket_address local_address() const;
+
+ private:
+  friend io_epoll_context;
+
+  friend socket_sender<recv_op> tag_invoke(
+      tag_t<async_read_some>,
+      async_socket& socket,
+      span<std::byte> buffer) noexcept {
+    return socket_sender<recv_op>{recv_op{socket.socket_.get(), buffer}};
+  }
+
+  friend socket_sender<send_op> tag_invoke(
+      tag_t<async_write_some>,
+      async_socket& socket,
+      span<const std::byte> buffer) noexcept {
+    return socket_sender<send_op>{send_op{socket.socket_.get(), buffer}};
+  }
+
+  friend socket_sender<receive_message_op> tag_invoke(
+      tag_t<async_receive_message>,
+      async_socket& socket,
+      msghdr& message) noexcept {
+    return socket_sender<receive_message_op>{
+        receive_message_op{socket.socket_.get(), &message}};
+  }
+
+  friend socket_sender<send_message_op> tag_invoke(
+      tag_t<async_send_message>,
+      async_socket& socket,
+      const msghdr& message) noexcept {
+    return socket_sender<send_message_op>{
+        send_message_op{socket.socket_.get(), &message}};
+  }
+
+  socket_handle socket_;
+};
+
+struct io_epoll_context::accept_op {
+  static constexpr bool is_write = false;
+
+  socket_registration& socket() noexcept {
+    return *listener_;
+  }
+
+  ssize_t perform() noexcept {
+    const int result = ::accept4(
+        listener_->fd_.get(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    return result < 0 ? -errno : result;
+  }
+
+  async_socket complete(ssize_t result) {
+    return async_socket{listener_->context_, static_cast<int>(result)};
+  }
+
+  socket_registration* listener_;
+};
+
+struct io_epoll_context::connect_op {
+  static constexpr bool is_write = true;
+
+  socket_registration& socket() noexcept {
+    return *socket_.socket_;
+  }
+
+  // Starts connecting, then once the socket has become writable checks
+  // whether the connection was established.
+  ssize_t perform() noexcept;
+
+  async_socket complete(ssize_t) noexcept {
+    return std::move(socket_);
+  }
+
+  async_socket socket_;
+  socket_address address_;
+  bool connecting_ = false;
+};
+
+// The sockets for the incoming connections on a listener. Each next() tries
+// accept4() before waiting, so a burst of connections is taken off the
+// queue without going back to epoll_wait() in between. A stop request
+// completes a pending next() with set_done() without ending the stream.
+class io_epoll_context::accept_stream {
+ public:
+  explicit accept_stream(socket_registration* listener) noexcept
+    : listener_(listener) {}
+
+ private:
+  friend socket_sender<accept_op> tag_invoke(
+      tag_t<next>, accept_stream& stream) noexcept {
+    return socket_sender<accept_op>{accept_op{stream.listener_}};
+  }
+
+  friend ready_done_sender tag_invoke(
+      tag_t<cleanup>, accept_stream&) noexcept {
+    return {};
+  }
+
+  socket_registration* listener_;
+};
+
+// A socket listening for incoming connections.
+class io_epoll_context::async_listener {
+ public:
+  // Takes ownership of 'fd', which must be a non-blocking listening socket,
+  // and registers it with the context's epoll set.
+  explicit async_listener(io_epoll_context& context, int fd)
+      : socket_(context.register_socket(fd, EPOLLIN)) {}
+
+  // The address the socket is bound to, including the port the kernel
+  // picked if it was bound to port zero.
+  socket_address local_address() const;
+
+ private:
+  friend socket_sender<accept_op> tag_invoke(
+      tag_t<async_accept>, async_listener& listener) noexcept {
+    return socket_sender<accept_op>{accept_op{listener.socket_.get()}};
+  }
+
+  friend accept_stream tag_invoke(
+      tag_t<async_accept_stream>, async_listener& listener) noexcept {
+    return accept_stream{listener.socket_.get()};
+  }
+
+  socket_handle socket_;
+};
+
 } // namespace linuxos
 } // namespace unifex
 
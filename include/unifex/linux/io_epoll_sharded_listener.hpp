@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/config.hpp>
+#if !UNIFEX_NO_EPOLL
+
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/linux/io_epoll_context.hpp>
+#include <unifex/linux/socket_address.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <unifex/detail/prologue.hpp>
+
+namespace unifex {
+namespace linuxos {
+
+// Construction-time parameters for an io_epoll_sharded_listener.
+struct io_epoll_sharded_listener_options {
+  // Number of shards, each with a context, a thread and a listening socket
+  // of its own. Zero creates one shard per CPU that the process is allowed
+  // to run on.
+  std::uint32_t shardCount = 0;
+
+  // The length of each shard's accept queue.
+  int backlog = 128;
+
+  // Options for every shard's context.
+  io_epoll_context_options contextOptions;
+
+  // Pin the thread of shard i to the i'th CPU that the process is allowed to
+  // run on, wrapping around if there are more shards than CPUs.
+  bool pinThreads = true;
+};
+
+// Accepts connections on one address with a set of io_epoll_contexts, each
+// run by its own thread.
+//
+// Every shard binds a listening socket of its own to the address with
+// SO_REUSEPORT. The kernel spreads incoming connections across the shards'
+// accept queues, so the shards never contend for a shared queue, and each
+// connection is accepted and served on a single thread.
+class io_epoll_sharded_listener {
+ public:
+  using options = io_epoll_sharded_listener_options;
+
+  explicit io_epoll_sharded_listener(const socket_address& address);
+
+  io_epoll_sharded_listener(
+      const socket_address& address, const options& opts);
+
+  // Closes the listening sockets, then stops the contexts and joins their
+  // threads. Accepted sockets must have been destroyed and outstanding
+  // operations must have completed.
+  ~io_epoll_sharded_listener();
+
+  io_epoll_sharded_listener(const io_epoll_sharded_listener&) = delete;
+  io_epoll_sharded_listener& operator=(const io_epoll_sharded_listener&) =
+      delete;
+
+  std::uint32_t shard_count() const noexcept {
+    return static_cast<std::uint32_t>(contexts_.size());
+  }
+
+  io_epoll_context& context(std::uint32_t shard) noexcept {
+    return *contexts_[shard];
+  }
+
+  io_epoll_context::scheduler get_scheduler(std::uint32_t shard) noexcept {
+    return contexts_[shard]->get_scheduler();
+  }
+
+  io_epoll_context::async_listener& listener(std::uint32_t shard) noexcept {
+    return listeners_[shard];
+  }
+
+  // The stream of connections accepted by a shard. The sockets belong to
+  // the shard's context.
+  io_epoll_context::accept_stream accept_stream(std::uint32_t shard) noexcept {
+    return async_accept_stream(listeners_[shard]);
+  }
+
+  // The address the shards are bound to, including the port the kernel
+  // picked if the address had port zero.
+  const socket_address& local_address() const noexcept {
+    return localAddress_;
+  }
+
+ private:
+  std::vector<std::unique_ptr<io_epoll_context>> contexts_;
+  std::vector<io_epoll_context::async_listener> listeners_;
+  std::vector<std::thread> threads_;
+  inplace_stop_source stopSource_;
+  socket_address localAddress_;
+};
+
+} // namespace linuxos
+} // namespace unifex
+
+#include <unifex/detail/epilogue.hpp>
+
+#endif // !UNIFEX_NO_EPOLL
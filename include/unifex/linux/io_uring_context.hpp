@@ -25,45 +25,190 @@
 #include <unifex/filesystem.hpp>
 #include <unifex/get_stop_token.hpp>
 #include <unifex/manual_lifetime.hpp>
+#include <unifex/pipe_concepts.hpp>
 #include <unifex/receiver_concepts.hpp>
+#include <unifex/sequence.hpp>
+#include <unifex/socket_concepts.hpp>
 #include <unifex/span.hpp>
 #include <unifex/stop_token_concepts.hpp>
+#include <unifex/type_traits.hpp>
 
+#include <unifex/linux/cancellable_io_operation.hpp>
 #include <unifex/linux/mmap_region.hpp>
 #include <unifex/linux/monotonic_clock.hpp>
 #include <unifex/linux/safe_file_descriptor.hpp>
+#include <unifex/linux/socket_address.hpp>
 
+#include <algorithm>
 #include <atomic>
+#include <bitset>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <system_error>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <liburing/io_uring.h>
 
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
+#include <unistd.h>
 
 #include <unifex/detail/prologue.hpp>
 
 namespace unifex {
 namespace linuxos {
 
+class io_uring_context;
+
+// Construction-time parameters for an io_uring_context.
+//
+// Flags that are not supported by the running kernel are dropped, newest
+// first, until io_uring_setup() succeeds; setup_flags() reports the flags
+// that were actually applied.
+struct io_uring_context_options {
+  // Number of submission queue entries. Rounded up to a power of two.
+  std::uint32_t sqEntries = 256;
+
+  // Number of completion queue entries (IORING_SETUP_CQSIZE).
+  // Zero uses the kernel default of twice the submission queue size.
+  std::uint32_t cqEntries = 0;
+
+  // Clamp entry counts that exceed the kernel limits instead of failing
+  // (IORING_SETUP_CLAMP).
+  bool clamp = false;
+
+  // Promise that only the thread calling run() will submit to the ring
+  // (IORING_SETUP_SINGLE_ISSUER). The ring is enabled by the first call to
+  // run() and later calls must come from the same thread.
+  bool singleIssuer = false;
+
+  // Defer completion task-work until the I/O thread asks for completions
+  // (IORING_SETUP_DEFER_TASKRUN). Implies singleIssuer.
+  bool deferTaskrun = false;
+
+  // Share the kernel async worker pool of an existing context instead of
+  // creating a new one (IORING_SETUP_ATTACH_WQ). When both contexts use
+  // sqPoll they also share the kernel submission-queue poller thread.
+  const io_uring_context* attachTo = nullptr;
+
+  // Have a kernel thread poll the submission queue so that submitting I/O
+  // does not need a syscall (IORING_SETUP_SQPOLL). The I/O thread only
+  // enters the kernel to wake the poller after it has gone to sleep, or to
+  // wait for completions.
+  bool sqPoll = false;
+
+  // How long the kernel poller spins without work before going to sleep.
+  // Zero uses the kernel default.
+  std::chrono::milliseconds sqPollIdle{0};
+
+  // Pin the kernel poller to this CPU (IORING_SETUP_SQ_AFF).
+  // Negative leaves it unpinned.
+  int sqPollCpu = -1;
+
+  // Number of slots in the ring's fixed-file table. Files opened through
+  // the context's scheduler are installed in a free slot, which saves the
+  // kernel looking up the file on every operation. Files opened once the
+  // table is full just use their plain descriptor. Not used together with
+  // singleIssuer, since the table is updated from whichever thread opens or
+  // closes a file.
+  std::uint32_t fixedFileCount = 0;
+};
+
+#if UNIFEX_IO_URING_STATS
+// Counters of the work done by an io_uring_context's I/O thread, see
+// io_uring_context::snapshot().
+struct io_uring_context_stats {
+  // Calls to io_uring_enter() and the submission queue entries handed to the
+  // kernel. With sqPoll, entries are counted when they are published to the
+  // poller thread, whether or not the poller needed waking up.
+  std::uint64_t enters = 0;
+  std::uint64_t sqesSubmitted = 0;
+
+  // Passes over the completion queue that found completions, and the number
+  // of completions they consumed.
+  std::uint64_t reaps = 0;
+  std::uint64_t cqesReaped = 0;
+
+  // Times the I/O thread found the sqPoll kernel thread asleep and had to
+  // enter the kernel to wake it up.
+  std::uint64_t sqPollerWakeups = 0;
+
+  double sqes_per_enter() const noexcept {
+    return enters > 0 ? static_cast<double>(sqesSubmitted) / enters : 0.0;
+  }
+
+  double cqes_per_reap() const noexcept {
+    return reaps > 0 ? static_cast<double>(cqesReaped) / reaps : 0.0;
+  }
+};
+#endif
+
 class io_uring_context {
  public:
+  using options = io_uring_context_options;
+
   class schedule_sender;
   class schedule_at_sender;
   template <typename Duration>
   class schedule_after_sender;
   class read_sender;
   class write_sender;
+  template <typename Op>
+  class op_sender;
+  template <typename Op>
+  struct timed_op;
+  template <typename... Ops>
+  class linked_sender;
+  struct read_op;
+  struct write_op;
+  template <typename File, int Flags>
+  struct open_op;
+  struct close_op;
+  struct fsync_op;
+  struct fallocate_op;
+  struct statx_op;
+  struct splice_op;
+  struct tee_op;
+  struct recv_op;
+  struct send_op;
+  struct send_zero_copy_op;
+  struct receive_message_op;
+  struct send_message_op;
+  class sendfile_sender;
+  struct accept_op;
+  struct connect_op;
+  struct accept_multishot_op;
+  struct receive_multishot_op;
+  template <typename Op>
+  class multishot_stream;
+  class provided_buffer_pool;
+  class provided_buffer;
+  class descriptor_base;
+  class file_base;
   class async_read_only_file;
   class async_read_write_file;
   class async_write_only_file;
+  class async_pipe_reader;
+  class async_pipe_writer;
+  class async_socket;
+  class async_listener;
   class scheduler;
 
   io_uring_context();
 
+  explicit io_uring_context(const options& opts);
+
   ~io_uring_context();
 
   template <typename StopToken>
@@ -71,7 +216,49 @@ class io_uring_context {
 
   scheduler get_scheduler() noexcept;
 
+  // The IORING_SETUP_* flags the ring was created with.
+  std::uint32_t setup_flags() const noexcept { return setupFlags_; }
+
+  // The queue sizes the kernel created the ring with, which may differ from
+  // the requested ones.
+  std::uint32_t sq_entry_count() const noexcept { return sqEntryCount_; }
+  std::uint32_t cq_entry_count() const noexcept { return cqEntryCount_; }
+
+  // Number of operations that were submitted to the kernel and had not yet
+  // completed when the I/O thread last went to submit or wait. May be read
+  // from any thread, e.g. to pick the least busy of several contexts.
+  std::uint32_t in_flight_count() const noexcept {
+    return inFlightCount_.load(std::memory_order_relaxed);
+  }
+
+  // Register buffers with the kernel so that reads and writes whose buffer
+  // lies entirely within one of them are submitted as
+  // IORING_OP_READ_FIXED/WRITE_FIXED, which avoids pinning and unpinning the
+  // user pages on every operation. Entries with a null iov_base reserve a
+  // slot that can be filled in later by update_registered_buffers().
+  //
+  // These must be called either before run() or from the I/O thread, and
+  // a buffer must not be unregistered while I/O on it is outstanding.
+  void register_buffers(span<const iovec> buffers);
+  void update_registered_buffers(
+      std::uint32_t firstIndex, span<const iovec> buffers);
+  void unregister_buffers();
+
+#if UNIFEX_IO_URING_STATS
+  using stats = io_uring_context_stats;
+
+  // Reads the counters. They are updated with relaxed atomics, so a
+  // snapshot taken while the context is busy is not guaranteed to be
+  // consistent across counters.
+  // Only available when the library is built with UNIFEX_IO_URING_STATS
+  // enabled.
+  stats snapshot() const noexcept;
+#endif
+
  private:
+  template <typename Derived, typename Context, typename Receiver>
+  friend class linuxos::cancellable_io_operation;
+
   struct operation_base {
     operation_base() noexcept {}
     operation_base* next_;
@@ -82,6 +269,133 @@ class io_uring_context {
     int result_;
   };
 
+  // An operation that produces a completion queue entry for each result
+  // until the kernel stops it. Its user_data is tagged so that the
+  // completion loop passes each entry straight to 'onCompletion_' rather
+  // than queueing it, since the operation may get more than one completion
+  // in a batch.
+  struct multishot_base {
+    void (*onCompletion_)(
+        multishot_base*, int result, std::uint32_t flags) noexcept;
+  };
+
+  static constexpr std::uintptr_t multishot_user_data_tag = 1;
+
+  // Whether 'result' says the operation was stopped by an
+  // IORING_OP_ASYNC_CANCEL. Operations that were running on an io-wq worker
+  // are interrupted instead, and some of them report the kernel-internal
+  // ERESTARTSYS rather than EINTR.
+  static bool is_interrupted_result(int result) noexcept {
+    constexpr int erestartsys = 512;
+    return result == -ECANCELED || result == -EINTR || result == -erestartsys;
+  }
+
+  static std::uintptr_t multishot_user_data(multishot_base* op) noexcept {
+    return reinterpret_cast<std::uintptr_t>(op) | multishot_user_data_tag;
+  }
+
+  // What a multishot_stream does with a result, as decided by its Op.
+  enum class multishot_retry : std::uint8_t {
+    // Pass the result on.
+    none,
+    // Drop the result and submit the operation again when the consumer
+    // next asks for a result.
+    resubmit,
+    // Drop the result and only submit the operation again once the Op has
+    // scheduled the operation it was given to resume the stream.
+    wait
+  };
+
+  // Whether Op is followed by a notification completion
+  // (IORING_CQE_F_NOTIF) once the kernel no longer refers to its buffer.
+  // Such an Op declares 'has_notification'.
+  template <typename Op, typename = void>
+  struct op_has_notification : std::false_type {};
+  template <typename Op>
+  struct op_has_notification<Op, std::void_t<decltype(Op::has_notification)>>
+    : std::bool_constant<Op::has_notification> {};
+
+  // Whether Op wants to be told when it fails, is cancelled or never gets
+  // to run. Such an Op declares 'failed(result)'.
+  template <typename Op, typename = void>
+  struct op_has_failed : std::false_type {};
+  template <typename Op>
+  struct op_has_failed<
+      Op,
+      std::void_t<decltype(std::declval<Op&>().failed(0))>>
+    : std::true_type {};
+
+  template <typename Op>
+  static void op_failed(Op& op, int result) noexcept {
+    if constexpr (op_has_failed<Op>::value) {
+      op.failed(result);
+    }
+  }
+
+  // Skip the bytes an Op that transfers a buffer has transferred, and
+  // return whether any are left. Such an Op declares 'advance(result)'.
+  template <typename Op, typename = void>
+  struct op_has_advance : std::false_type {};
+  template <typename Op>
+  struct op_has_advance<
+      Op,
+      std::void_t<decltype(std::declval<Op&>().advance(0))>>
+    : std::true_type {};
+
+  template <typename Op>
+  static bool op_advance(Op& op, int result) noexcept {
+    if constexpr (op_has_advance<Op>::value) {
+      return op.advance(result);
+    } else {
+      return false;
+    }
+  }
+
+  // Skip 'count' bytes at the front of 'buffer', and return whether any
+  // are left.
+  static bool advance_buffer(iovec& buffer, std::size_t count) noexcept {
+    UNIFEX_ASSERT(count <= buffer.iov_len);
+    buffer.iov_base = static_cast<char*>(buffer.iov_base) + count;
+    buffer.iov_len -= count;
+    return buffer.iov_len > 0;
+  }
+
+  // A pipe that sendfile_sender moves data through on its way from the file
+  // to the socket.
+  struct pooled_pipe {
+    safe_file_descriptor reader_;
+    safe_file_descriptor writer_;
+    std::uint32_t capacity_ = 0;
+  };
+
+  // An open file descriptor that is also installed in the ring's fixed-file
+  // table when there is a free slot.
+  class registered_fd {
+   public:
+    registered_fd(io_uring_context& context, int fd) noexcept;
+    registered_fd(registered_fd&& other) noexcept;
+    ~registered_fd();
+
+    int get() const noexcept { return fd_.get(); }
+
+    // Remove the file from the fixed-file table and give up ownership of
+    // the descriptor.
+    int release() noexcept;
+
+    // The value to use for io_uring_sqe::fd and the flags that go with it.
+    int sqe_fd() const noexcept {
+      return fixedIndex_ >= 0 ? fixedIndex_ : fd_.get();
+    }
+    std::uint8_t sqe_flags() const noexcept {
+      return fixedIndex_ >= 0 ? IOSQE_FIXED_FILE : 0;
+    }
+
+   private:
+    io_uring_context& context_;
+    safe_file_descriptor fd_;
+    int fixedIndex_;
+  };
+
   struct stop_operation : operation_base {
     stop_operation() noexcept {
       this->execute_ = [](operation_base * op) noexcept {
@@ -126,6 +440,26 @@ class io_uring_context {
   bool is_running_on_io_thread() const noexcept;
   void run_impl(const bool& shouldStop);
 
+  // Counters, see stats. Updating them compiles to nothing unless
+  // UNIFEX_IO_URING_STATS is enabled.
+  enum class stat : std::uint8_t {
+    enters,
+    sqes_submitted,
+    reaps,
+    cqes_reaped,
+    sq_poller_wakeups,
+    count
+  };
+
+  void count([[maybe_unused]] stat s, [[maybe_unused]] std::uint64_t n = 1) noexcept {
+#if UNIFEX_IO_URING_STATS
+    // Only the I/O thread updates the counters.
+    auto& counter = stats_[static_cast<std::size_t>(s)];
+    counter.store(
+        counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+#endif
+  }
+
   void schedule_impl(operation_base* op);
   void schedule_local(operation_base* op) noexcept;
   void schedule_local(operation_queue ops) noexcept;
@@ -178,12 +512,130 @@ class io_uring_context {
   bool try_submit_timer_io(const time_point& dueTime) noexcept;
   bool try_submit_timer_io_cancel() noexcept;
 
+  // Find the index of the registered buffer that contains the whole of
+  // [data, data + size), or -1 if there isn't one.
+  int find_registered_buffer(const void* data, std::size_t size) const noexcept;
+
+  void index_registered_buffers();
+
+  // Query whether the kernel supports the given IORING_OP_* opcode.
+  bool is_op_supported(std::uint8_t opcode) const noexcept {
+    return supportedOps_[opcode];
+  }
+
+  // Install the file in a free slot of the fixed-file table and return the
+  // slot index, or -1 if there is no table or it is full.
+  int install_file(int fd) noexcept;
+  void remove_file(int index) noexcept;
+
+  // Make the entries added by try_submit_io() since the last call visible
+  // to the kernel with a single store of the submission queue tail.
+  void publish_submissions() noexcept {
+    if (sqTail_->load(std::memory_order_relaxed) != sqLocalTail_) {
+      sqTail_->store(sqLocalTail_, std::memory_order_release);
+    }
+  }
+
+  // Query whether the SQPOLL kernel thread has gone to sleep and needs an
+  // io_uring_enter(IORING_ENTER_SQ_WAKEUP) to pick up new entries.
+  bool sq_poller_needs_wakeup() const noexcept;
+
   // Try to submit an entry to the submission queue
   //
   // If there is space in the queue then populateSqe
+  //
+  // The entry is only made visible to the kernel by the next call to
+  // publish_submissions().
   template <typename PopulateFn>
   bool try_submit_io(PopulateFn populateSqe) noexcept;
 
+  // Try to submit 'count' consecutive entries to the submission queue,
+  // calling populateSqe(sqe, index) for each of them. Either all of the
+  // entries are submitted or none are, so entries linked with
+  // IOSQE_IO_LINK are never split. Since the tail is only published once per
+  // turn of the run loop, the kernel (or the SQPOLL thread) never sees part
+  // of a chain.
+  template <typename PopulateFn>
+  bool try_submit_io_chain(std::uint32_t count, PopulateFn populateSqe) noexcept;
+
+  // Take an empty pipe from the pool, or create one. Returns 0 or -errno.
+  // Called on the I/O thread.
+  int acquire_pipe(pooled_pipe& pipe) noexcept;
+
+  // Return a pipe to the pool. Only pipes that have been drained may be
+  // reused. Called on the I/O thread.
+  void release_pipe(pooled_pipe pipe) noexcept;
+
+  // Fill in an IORING_OP_SPLICE entry. An offset of -1 uses the file
+  // position, as pipes and sockets require.
+  static void populate_splice(
+      io_uring_sqe& sqe,
+      const registered_fd& in,
+      std::int64_t inOffset,
+      const registered_fd& out,
+      std::int64_t outOffset,
+      std::uint32_t length) noexcept {
+    populate_splice(
+        sqe,
+        in.sqe_fd(),
+        in.sqe_flags() != 0,
+        inOffset,
+        out.sqe_fd(),
+        out.sqe_flags(),
+        outOffset,
+        length);
+  }
+
+  static void populate_splice(
+      io_uring_sqe& sqe,
+      int inFd,
+      bool inFixed,
+      std::int64_t inOffset,
+      int outFd,
+      std::uint8_t outFlags,
+      std::int64_t outOffset,
+      std::uint32_t length) noexcept {
+    sqe.opcode = IORING_OP_SPLICE;
+    sqe.fd = outFd;
+    sqe.flags = outFlags;
+    sqe.off = static_cast<std::uint64_t>(outOffset);
+    sqe.splice_fd_in = inFd;
+    sqe.splice_off_in = static_cast<std::uint64_t>(inOffset);
+    sqe.len = length;
+    sqe.splice_flags = inFixed ? SPLICE_F_FD_IN_FIXED : 0;
+  }
+
+  // The operations making up the senders that sequence() submits as one
+  // IOSQE_IO_LINK chain. See linked_sender.
+  template <
+      typename Op,
+      std::enable_if_t<
+          !instance_of_v<timed_op, Op> && !op_has_notification<Op>::value,
+          int> = 0>
+  static std::tuple<Op> take_linked_ops(op_sender<Op>&& sender) noexcept(
+      std::is_nothrow_move_constructible_v<Op>);
+  template <typename... Ops>
+  static std::tuple<Ops...> take_linked_ops(
+      linked_sender<Ops...>&& sender) noexcept(
+      (std::is_nothrow_move_constructible_v<Ops> && ...));
+
+  template <typename... Ops>
+  static linked_sender<Ops...> make_linked_sender(
+      std::tuple<Ops...>&& ops) noexcept(
+      (std::is_nothrow_move_constructible_v<Ops> && ...));
+
+  template <
+      typename First,
+      typename Second,
+      typename Ops = decltype(std::tuple_cat(
+          io_uring_context::take_linked_ops(std::declval<First>()),
+          io_uring_context::take_linked_ops(std::declval<Second>())))>
+  friend auto tag_invoke(tag_t<sequence>, First&& first, Second&& second) {
+    return io_uring_context::make_linked_sender(std::tuple_cat(
+        io_uring_context::take_linked_ops((First &&) first),
+        io_uring_context::take_linked_ops((Second &&) second)));
+  }
+
   // Total number of operations submitted that have not yet
   // completed.
   std::uint32_t pending_operation_count() const noexcept {
@@ -206,6 +658,12 @@ class io_uring_context {
     return reinterpret_cast<std::uintptr_t>(&currentDueTime_);
   }
 
+  // user_data for submissions whose completions are ignored, such as
+  // IORING_OP_ASYNC_CANCEL requests.
+  std::uintptr_t ignored_user_data() const {
+    return reinterpret_cast<std::uintptr_t>(&pendingIoQueue_);
+  }
+
   struct __kernel_timespec {
     int64_t tv_sec;
     long long tv_nsec;
@@ -214,6 +672,11 @@ class io_uring_context {
   ////////
   // Data that does not change once initialised.
 
+  std::uint32_t setupFlags_ = 0;
+
+  // Opcodes supported by the kernel, from IORING_REGISTER_PROBE.
+  std::bitset<256> supportedOps_;
+
   // Submission queue state
   std::uint32_t sqEntryCount_;
   std::uint32_t sqMask_;
@@ -242,6 +705,30 @@ class io_uring_context {
   ///////////////////
   // Data that is modified by I/O thread
 
+  struct registered_buffer {
+    std::uintptr_t begin_;
+    std::uintptr_t end_;
+    std::uint32_t index_;
+  };
+
+  // Buffers registered with the kernel, indexed by buf_index, and the
+  // non-empty ones sorted by address for lookup.
+  std::vector<iovec> registeredBuffers_;
+  std::vector<registered_buffer> registeredBufferIndex_;
+
+  // Buffer group id for the next provided_buffer_pool.
+  std::uint16_t nextBufferGroup_ = 0;
+
+  // Empty pipes kept for the next sendfile_sender.
+  std::vector<pooled_pipe> idlePipes_;
+
+  ///////////////////
+  // Data that is modified by threads opening and closing files
+
+  // Free slots in the fixed-file table.
+  std::mutex fixedFilesMutex_;
+  std::vector<std::uint32_t> freeFixedFiles_;
+
   // Local queue for operations that are ready to execute.
   operation_queue localQueue_;
 
@@ -255,6 +742,10 @@ class io_uring_context {
   // is due to elapse.
   std::optional<time_point> currentDueTime_;
 
+  // Tail of the submission queue including the entries that have not yet
+  // been published to the kernel.
+  std::uint32_t sqLocalTail_ = 0;
+
   // Number of unflushed I/O submission entries.
   std::uint32_t sqUnflushedCount_ = 0;
 
@@ -266,10 +757,25 @@ class io_uring_context {
   bool remoteQueueReadSubmitted_ = false;
   bool timersAreDirty_ = false;
 
+  // Set while the ring was created with IORING_SETUP_R_DISABLED and has not
+  // yet been enabled by the thread calling run().
+  bool ringDisabled_ = false;
+
   std::uint32_t activeTimerCount_ = 0;
 
   __kernel_timespec time_;
 
+  //////////////////
+  // Data that is modified by the I/O thread and read by remote threads
+
+  // See in_flight_count().
+  std::atomic<std::uint32_t> inFlightCount_{0};
+
+#if UNIFEX_IO_URING_STATS
+  std::atomic<std::uint64_t> stats_[static_cast<std::size_t>(stat::count)] =
+      {};
+#endif
+
   //////////////////
   // Data that is modified by remote threads
 
@@ -292,7 +798,7 @@ bool io_uring_context::try_submit_io(PopulateFn populateSqe) noexcept {
 
   if (pending_operation_count() < cqEntryCount_) {
     // Haven't reached limit of completion-queue yet.
-    const auto tail = sqTail_->load(std::memory_order_relaxed);
+    const auto tail = sqLocalTail_;
     const auto head = sqHead_->load(std::memory_order_acquire);
     const auto usedCount = (tail - head);
     UNIFEX_ASSERT(usedCount <= sqEntryCount_);
@@ -301,6 +807,10 @@ bool io_uring_context::try_submit_io(PopulateFn populateSqe) noexcept {
       const auto index = tail & sqMask_;
       auto& sqe = sqEntries_[index];
 
+      // The layout of the trailing fields differs between kernel versions,
+      // so clear the whole entry rather than the fields we know about.
+      std::memset(&sqe, 0, sizeof(sqe));
+
       static_assert(noexcept(populateSqe(sqe)));
 
       if constexpr (std::is_void_v<decltype(populateSqe(sqe))>) {
@@ -312,7 +822,7 @@ bool io_uring_context::try_submit_io(PopulateFn populateSqe) noexcept {
       }
 
       sqIndexArray_[index] = index;
-      sqTail_->store(tail + 1, std::memory_order_release);
+      sqLocalTail_ = tail + 1;
       ++sqUnflushedCount_;
       return true;
     }
@@ -321,6 +831,39 @@ bool io_uring_context::try_submit_io(PopulateFn populateSqe) noexcept {
   return false;
 }
 
+template <typename PopulateFn>
+bool io_uring_context::try_submit_io_chain(
+    std::uint32_t count, PopulateFn populateSqe) noexcept {
+  UNIFEX_ASSERT(is_running_on_io_thread());
+  UNIFEX_ASSERT(count > 0);
+
+  if (pending_operation_count() + count > cqEntryCount_) {
+    return false;
+  }
+
+  const auto tail = sqLocalTail_;
+  const auto head = sqHead_->load(std::memory_order_acquire);
+  const auto usedCount = (tail - head);
+  UNIFEX_ASSERT(usedCount <= sqEntryCount_);
+  if (sqEntryCount_ - usedCount < count) {
+    return false;
+  }
+
+  static_assert(noexcept(populateSqe(sqEntries_[0], std::uint32_t(0))));
+
+  for (std::uint32_t i = 0; i < count; ++i) {
+    const auto index = (tail + i) & sqMask_;
+    auto& sqe = sqEntries_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    populateSqe(sqe, i);
+    sqIndexArray_[index] = index;
+  }
+
+  sqLocalTail_ = tail + count;
+  sqUnflushedCount_ += count;
+  return true;
+}
+
 class io_uring_context::schedule_sender {
   template <typename Receiver>
   class operation : private operation_base {
@@ -393,25 +936,67 @@ class io_uring_context::schedule_sender {
   io_uring_context& context_;
 };
 
-class io_uring_context::read_sender {
-  using offset_t = std::int64_t;
+// A sender for a single io_uring operation that completes with the value
+// produced by Op from the operation's result.
+//
+// Op describes the operation:
+//  - 'opcode' is the IORING_OP_* the kernel must support.
+//  - 'cancellable' says whether a stop request should try to cancel the
+//    operation with IORING_OP_ASYNC_CANCEL.
+//  - 'populate(sqe)' fills in the submission queue entry.
+//  - 'complete(result)' produces the value sent on success.
+//  - 'fallback()' makes the equivalent blocking syscall, returning its result
+//    or -errno. This is run on the I/O thread instead of submitting the
+//    operation when the kernel doesn't support the opcode.
+//  - 'failed(result)', which is optional, is called instead of 'complete()'
+//    when the operation fails or is cancelled, including when it is part of
+//    a chain that fails before getting to it.
+//
+// An Op wrapped in timed_op is submitted linked to an IORING_OP_LINK_TIMEOUT
+// and fails with std::errc::timed_out if the timeout fires first.
+//
+// An Op with 'has_notification' only completes once its notification has
+// arrived, if the kernel says one will follow the result.
+template <typename Op>
+class io_uring_context::op_sender {
+  using result_type = decltype(std::declval<Op&>().complete(0));
+
+  template <template <typename...> class Tuple, typename T>
+  struct value_tuple {
+    using type = Tuple<T>;
+  };
+  template <template <typename...> class Tuple>
+  struct value_tuple<Tuple, void> {
+    using type = Tuple<>;
+  };
 
   template <typename Receiver>
-  class operation : private completion_base {
+  class operation
+    : private completion_base
+    , private linuxos::cancellable_io_operation<
+          operation<Receiver>,
+          io_uring_context,
+          Receiver> {
     friend io_uring_context;
+    friend linuxos::
+        cancellable_io_operation<operation, io_uring_context, Receiver>;
+
+    static constexpr bool is_stop_ever_possible = Op::cancellable &&
+        !is_stop_never_possible_v<stop_token_type_t<Receiver>>;
+
+    static constexpr bool has_timeout = instance_of_v<timed_op, Op>;
+    static constexpr bool has_notification = op_has_notification<Op>::value;
 
    public:
     template <typename Receiver2>
-    explicit operation(const read_sender& sender, Receiver2&& r)
-        : context_(sender.context_),
-          fd_(sender.fd_),
-          offset_(sender.offset_),
-          receiver_((Receiver2 &&) r) {
-      buffer_[0].iov_base = sender.buffer_.data();
-      buffer_[0].iov_len = sender.buffer_.size();
-    }
+    explicit operation(Op&& op, Receiver2&& r)
+        : context_(op.context_),
+          op_(std::move(op)),
+          receiver_((Receiver2 &&) r) {}
 
     void start() noexcept {
+      this->listen_for_stop();
+
       if (!context_.is_running_on_io_thread()) {
         this->execute_ = &operation::on_schedule_complete;
         context_.schedule_remote(this);
@@ -428,62 +1013,211 @@ class io_uring_context::read_sender {
     void start_io() noexcept {
       UNIFEX_ASSERT(context_.is_running_on_io_thread());
 
-      auto populateSqe = [this](io_uring_sqe & sqe) noexcept {
-        sqe.opcode = IORING_OP_READV;
-        sqe.flags = 0;
-        sqe.ioprio = 0;
-        sqe.fd = fd_;
-        sqe.off = offset_;
-        sqe.addr = reinterpret_cast<std::uintptr_t>(&buffer_[0]);
-        sqe.len = 1;
-        sqe.rw_flags = 0;
-        sqe.user_data = reinterpret_cast<std::uintptr_t>(
-            static_cast<completion_base*>(this));
-        sqe.__pad2[0] = sqe.__pad2[1] = sqe.__pad2[2] = 0;
+      if constexpr (is_stop_ever_possible) {
+        if (get_stop_token(receiver_).stop_requested()) {
+          this->result_ = -ECANCELED;
+          complete();
+          return;
+        }
+      }
 
-        this->execute_ = &operation::on_read_complete;
-      };
+      if (!context_.is_op_supported(Op::opcode)) {
+        this->result_ = op_.fallback();
+        complete();
+        return;
+      }
+
+      bool submitted;
+      if constexpr (has_timeout) {
+        if (!context_.is_op_supported(IORING_OP_LINK_TIMEOUT)) {
+          this->result_ = -EOPNOTSUPP;
+          complete();
+          return;
+        }
+
+        auto populateSqe = [this](io_uring_sqe & sqe, std::uint32_t index) noexcept {
+          if (index == 0) {
+            op_.populate(sqe);
+            sqe.flags |= IOSQE_IO_LINK;
+            sqe.user_data = reinterpret_cast<std::uintptr_t>(
+                static_cast<completion_base*>(this));
+
+            this->execute_ = &operation::on_complete;
+            linkedCount_ = 2;
+          } else {
+            sqe.opcode = IORING_OP_LINK_TIMEOUT;
+            sqe.addr = reinterpret_cast<std::uintptr_t>(&op_.timeout_);
+            sqe.len = 1;
+            sqe.user_data = reinterpret_cast<std::uintptr_t>(
+                static_cast<completion_base*>(&timeoutCompletion_));
+          }
+        };
+
+        submitted = context_.try_submit_io_chain(2, populateSqe);
+      } else {
+        auto populateSqe = [this](io_uring_sqe & sqe) noexcept {
+          op_.populate(sqe);
+          sqe.user_data = user_data();
+
+          this->execute_ = &operation::on_complete;
+        };
+
+        submitted = context_.try_submit_io(populateSqe);
+      }
 
-      if (!context_.try_submit_io(populateSqe)) {
+      if (submitted) {
+        submitted_ = true;
+      } else {
         this->execute_ = &operation::on_schedule_complete;
         context_.schedule_pending_io(this);
       }
     }
 
-    static void on_read_complete(operation_base* op) noexcept {
+    static void on_complete(operation_base* op) noexcept {
       auto& self = *static_cast<operation*>(op);
-      if (self.result_ >= 0) {
-        if constexpr (noexcept(unifex::set_value(std::move(self.receiver_), ssize_t(self.result_)))) {
-          unifex::set_value(std::move(self.receiver_), ssize_t(self.result_));
-        } else {
-          UNIFEX_TRY {
-            unifex::set_value(std::move(self.receiver_), ssize_t(self.result_));
-          } UNIFEX_CATCH (...) {
-            unifex::set_error(std::move(self.receiver_), std::current_exception());
+      if constexpr (has_timeout) {
+        self.on_linked_complete();
+      } else {
+        self.complete();
+      }
+    }
+
+    static void on_timeout_complete(operation_base* op) noexcept {
+      static_cast<timeout_completion*>(op)->op_.on_linked_complete();
+    }
+
+    // Called from the completion loop for both the result and the
+    // notification.
+    static void on_notification_complete(
+        multishot_base* base, int result, std::uint32_t flags) noexcept {
+      auto& self = static_cast<notification_completion*>(base)->op_;
+      if ((flags & IORING_CQE_F_NOTIF) == 0) {
+        self.result_ = result;
+        if ((flags & IORING_CQE_F_MORE) != 0) {
+          // Wait for the kernel to release the buffer.
+          return;
+        }
+      }
+      self.context_.schedule_local(static_cast<completion_base*>(&self));
+    }
+
+    std::uintptr_t user_data() noexcept {
+      if constexpr (has_notification) {
+        return multishot_user_data(&notificationCompletion_);
+      } else {
+        return reinterpret_cast<std::uintptr_t>(
+            static_cast<completion_base*>(this));
+      }
+    }
+
+    // Called for each of the operation's and the linked timeout's
+    // completions. The operation can only complete once both have arrived,
+    // since the kernel still refers to the timeout until then.
+    void on_linked_complete() noexcept {
+      if (--linkedCount_ != 0) {
+        return;
+      }
+      if (timeoutCompletion_.result_ == -ETIME && this->result_ < 0) {
+        // The timeout fired and cancelled the operation.
+        this->result_ = -ETIMEDOUT;
+      }
+      complete();
+    }
+
+    void complete() noexcept {
+      if (this->ready_to_deliver()) {
+        deliver();
+      }
+    }
+
+    void deliver() noexcept {
+      if (this->cancel_requested() && is_interrupted_result(this->result_)) {
+        this->result_ = -ECANCELED;
+      }
+      if (this->result_ >= 0) {
+        UNIFEX_TRY {
+          if constexpr (std::is_void_v<result_type>) {
+            op_.complete(this->result_);
+            unifex::set_value(std::move(receiver_));
+          } else {
+            unifex::set_value(
+                std::move(receiver_), op_.complete(this->result_));
           }
+        } UNIFEX_CATCH (...) {
+          unifex::set_error(std::move(receiver_), std::current_exception());
         }
-      } else if (self.result_ == -ECANCELED) {
-        unifex::set_done(std::move(self.receiver_));
+      } else if (this->result_ == -ECANCELED) {
+        op_failed(op_, this->result_);
+        unifex::set_done(std::move(receiver_));
       } else {
+        op_failed(op_, this->result_);
         unifex::set_error(
-            std::move(self.receiver_),
-            std::error_code{-self.result_, std::system_category()});
+            std::move(receiver_),
+            std::error_code{-this->result_, std::system_category()});
       }
     }
 
+    bool cancel_io() noexcept {
+      if (!submitted_) {
+        // Still waiting for space in the submission queue. start_io() will
+        // see the stop request when it gets to run.
+        return true;
+      }
+
+      auto populateSqe = [this](io_uring_sqe & sqe) noexcept {
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = user_data();
+        sqe.user_data = context_.ignored_user_data();
+      };
+
+      if (context_.try_submit_io(populateSqe)) {
+        return true;
+      }
+      context_.schedule_pending_io(this->cancel_operation());
+      return false;
+    }
+
+    struct timeout_completion : completion_base {
+      explicit timeout_completion(operation& op) noexcept : op_(op) {
+        this->execute_ = &operation::on_timeout_complete;
+      }
+      operation& op_;
+    };
+
+    struct unused_completion {
+      explicit unused_completion(operation&) noexcept {}
+    };
+
+    struct notification_completion : multishot_base {
+      explicit notification_completion(operation& op) noexcept : op_(op) {
+        this->onCompletion_ = &operation::on_notification_complete;
+      }
+      operation& op_;
+    };
+
     io_uring_context& context_;
-    int fd_;
-    offset_t offset_;
-    iovec buffer_[1];
+    Op op_;
     Receiver receiver_;
+
+    // Completions still to arrive for an operation with a linked timeout.
+    std::uint8_t linkedCount_ = 0;
+    UNIFEX_NO_UNIQUE_ADDRESS std::conditional_t<
+        has_timeout,
+        timeout_completion,
+        unused_completion> timeoutCompletion_{*this};
+    UNIFEX_NO_UNIQUE_ADDRESS std::conditional_t<
+        has_notification,
+        notification_completion,
+        unused_completion> notificationCompletion_{*this};
+
+    bool submitted_ = false;
   };
 
  public:
-  // Produces number of bytes read.
   template <
       template <typename...> class Variant,
       template <typename...> class Tuple>
-  using value_types = Variant<Tuple<ssize_t>>;
+  using value_types = Variant<typename value_tuple<Tuple, result_type>::type>;
 
   // Note: Only case it might complete with exception_ptr is if the
   // receiver's set_value() exits with an exception.
@@ -492,44 +1226,267 @@ class io_uring_context::read_sender {
 
   static constexpr bool sends_done = true;
 
-  explicit read_sender(
-      io_uring_context& context,
-      int fd,
-      offset_t offset,
-      span<std::byte> buffer) noexcept
-      : context_(context), fd_(fd), offset_(offset), buffer_(buffer) {}
+  explicit op_sender(Op op) noexcept(std::is_nothrow_move_constructible_v<Op>)
+    : op_(std::move(op)) {}
 
   template <typename Receiver>
   operation<remove_cvref_t<Receiver>> connect(Receiver&& r) && {
-    return operation<remove_cvref_t<Receiver>>{*this, (Receiver &&) r};
+    return operation<remove_cvref_t<Receiver>>{std::move(op_), (Receiver &&) r};
   }
 
  private:
+  friend io_uring_context;
+
+  template <
+      typename Rep,
+      typename Ratio,
+      typename Op2 = Op,
+      std::enable_if_t<
+          !instance_of_v<timed_op, Op2> &&
+              !op_has_notification<Op2>::value,
+          int> = 0>
+  friend op_sender<timed_op<Op>> tag_invoke(
+      tag_t<with_timeout>,
+      op_sender&& sender,
+      std::chrono::duration<Rep, Ratio> timeout) noexcept(
+      std::is_nothrow_move_constructible_v<Op>) {
+    return op_sender<timed_op<Op>>{
+        timed_op<Op>::make(std::move(sender.op_), timeout)};
+  }
+
+  Op op_;
+};
+
+// An Op bounded by an IORING_OP_LINK_TIMEOUT. See op_sender.
+template <typename Op>
+struct io_uring_context::timed_op : Op {
+  template <typename Rep, typename Ratio>
+  static timed_op make(Op op, std::chrono::duration<Rep, Ratio> timeout) noexcept(
+      std::is_nothrow_move_constructible_v<Op>) {
+    const auto ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    __kernel_timespec ts{0, 0};
+    if (ns > 0) {
+      ts.tv_sec = ns / 1'000'000'000;
+      ts.tv_nsec = ns % 1'000'000'000;
+    }
+    return timed_op{std::move(op), ts};
+  }
+
+  __kernel_timespec timeout_;
+};
+
+struct io_uring_context::read_op {
+  static constexpr std::uint8_t opcode = IORING_OP_READV;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    const int bufferIndex =
+        context_.find_registered_buffer(buffer_.iov_base, buffer_.iov_len);
+    if (bufferIndex >= 0) {
+      sqe.opcode = IORING_OP_READ_FIXED;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(buffer_.iov_base);
+      sqe.len = static_cast<std::uint32_t>(buffer_.iov_len);
+      sqe.buf_index = static_cast<std::uint16_t>(bufferIndex);
+    } else {
+      sqe.opcode = IORING_OP_READV;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(&buffer_);
+      sqe.len = 1;
+    }
+    sqe.flags = sqeFlags_;
+    sqe.fd = fd_;
+    sqe.off = offset_;
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  bool advance(int result) noexcept {
+    if (offset_ >= 0) {
+      offset_ += result;
+    }
+    return advance_buffer(buffer_, static_cast<std::size_t>(result));
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
   io_uring_context& context_;
   int fd_;
-  offset_t offset_;
-  span<std::byte> buffer_;
+  std::uint8_t sqeFlags_;
+  std::int64_t offset_;
+  iovec buffer_;
 };
 
-class io_uring_context::write_sender {
-  using offset_t = std::int64_t;
+struct io_uring_context::write_op {
+  static constexpr std::uint8_t opcode = IORING_OP_WRITEV;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    const int bufferIndex =
+        context_.find_registered_buffer(buffer_.iov_base, buffer_.iov_len);
+    if (bufferIndex >= 0) {
+      sqe.opcode = IORING_OP_WRITE_FIXED;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(buffer_.iov_base);
+      sqe.len = static_cast<std::uint32_t>(buffer_.iov_len);
+      sqe.buf_index = static_cast<std::uint16_t>(bufferIndex);
+    } else {
+      sqe.opcode = IORING_OP_WRITEV;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(&buffer_);
+      sqe.len = 1;
+    }
+    sqe.flags = sqeFlags_;
+    sqe.fd = fd_;
+    sqe.off = offset_;
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  bool advance(int result) noexcept {
+    if (offset_ >= 0) {
+      offset_ += result;
+    }
+    return advance_buffer(buffer_, static_cast<std::size_t>(result));
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  int fd_;
+  std::uint8_t sqeFlags_;
+  std::int64_t offset_;
+  iovec buffer_;
+};
+
+// Reads from a file into a single buffer with IORING_OP_READV, or with
+// IORING_OP_READ_FIXED when the buffer lies within a registered buffer.
+//
+// A stop request cancels the read in the kernel with IORING_OP_ASYNC_CANCEL
+// and the read completes with set_done(). A read that the kernel can no
+// longer interrupt still completes with its result.
+class io_uring_context::read_sender : public op_sender<read_op> {
+ public:
+  explicit read_sender(
+      io_uring_context& context,
+      int fd,
+      std::int64_t offset,
+      span<std::byte> buffer,
+      std::uint8_t sqeFlags = 0) noexcept
+      : op_sender<read_op>(read_op{
+            context, fd, sqeFlags, offset, {buffer.data(), buffer.size()}}) {}
+};
+
+// Writes a single buffer to a file with IORING_OP_WRITEV, or with
+// IORING_OP_WRITE_FIXED when the buffer lies within a registered buffer.
+// Stop requests are handled as for read_sender.
+class io_uring_context::write_sender : public op_sender<write_op> {
+ public:
+  explicit write_sender(
+      io_uring_context& context,
+      int fd,
+      std::int64_t offset,
+      span<const std::byte> buffer,
+      std::uint8_t sqeFlags = 0) noexcept
+      : op_sender<write_op>(write_op{
+            context,
+            fd,
+            sqeFlags,
+            offset,
+            {const_cast<std::byte*>(buffer.data()), buffer.size()}}) {}
+};
+
+template <
+    typename Op,
+    std::enable_if_t<
+        !instance_of_v<io_uring_context::timed_op, Op> &&
+            !io_uring_context::op_has_notification<Op>::value,
+        int>>
+std::tuple<Op> io_uring_context::take_linked_ops(op_sender<Op>&& sender) noexcept(
+    std::is_nothrow_move_constructible_v<Op>) {
+  return std::tuple<Op>{std::move(sender.op_)};
+}
+
+// A chain of operations on one io_uring_context, each linked to the next
+// with IOSQE_IO_LINK and submitted together. sequence() produces one from
+// two senders of io_uring operations (or chains of them), so that
+// sequence(async_write_some_at(file, ...), async_fdatasync(file)) costs a
+// single trip through the ring instead of one per operation.
+//
+// The kernel only starts an operation once the one before it has
+// succeeded. The chain produces the value of its last operation; the values
+// of the others are discarded. If an operation fails, the rest of the chain
+// is cancelled and the chain fails with that operation's error.
+//
+// Every operation but the last transfers its whole buffer before the next
+// one starts, since what follows usually depends on it, e.g. the fdatasync
+// after a write. A read or write that transfers fewer bytes than asked for
+// makes the kernel cancel the rest of the chain, so the bytes that are left
+// are submitted again, followed by the rest of the chain. Sends and
+// receives are submitted with MSG_WAITALL so that the kernel does the same
+// for them. A transfer that can't make any progress, e.g. a read at the end
+// of the file, or an operation other than these that breaks the chain, such
+// as a short splice, fails the chain with EIO. The last operation's short
+// transfer is its result, as usual.
+//
+// Operations whose opcode the kernel doesn't support are run one at a time
+// with their blocking fallback, the same way op_sender runs them, and the
+// supported operations between them are linked as usual.
+//
+// A stop request cancels whichever operations are still outstanding and
+// the chain completes with set_done(). The operations must all belong to
+// the same context.
+template <typename... Ops>
+class io_uring_context::linked_sender {
+  static constexpr std::size_t count = sizeof...(Ops);
+
+  using last_op = std::tuple_element_t<count - 1, std::tuple<Ops...>>;
+
+  static constexpr std::uint8_t opcodes[count] = {Ops::opcode...};
+  using result_type = decltype(std::declval<last_op&>().complete(0));
+
+  template <template <typename...> class Tuple, typename T>
+  struct value_tuple {
+    using type = Tuple<T>;
+  };
+  template <template <typename...> class Tuple>
+  struct value_tuple<Tuple, void> {
+    using type = Tuple<>;
+  };
 
   template <typename Receiver>
-  class operation : private completion_base {
+  class operation
+    : private operation_base
+    , private linuxos::cancellable_io_operation<
+          operation<Receiver>,
+          io_uring_context,
+          Receiver> {
     friend io_uring_context;
+    friend linuxos::
+        cancellable_io_operation<operation, io_uring_context, Receiver>;
+
+    static constexpr bool is_stop_ever_possible = (Ops::cancellable || ...) &&
+        !is_stop_never_possible_v<stop_token_type_t<Receiver>>;
 
    public:
     template <typename Receiver2>
-    explicit operation(const write_sender& sender, Receiver2&& r)
-        : context_(sender.context_),
-          fd_(sender.fd_),
-          offset_(sender.offset_),
+    explicit operation(std::tuple<Ops...>&& ops, Receiver2&& r)
+        : context_(std::get<0>(ops).context_),
+          ops_(std::move(ops)),
           receiver_((Receiver2 &&) r) {
-      buffer_[0].iov_base = (void*)sender.buffer_.data();
-      buffer_[0].iov_len = sender.buffer_.size();
+      for (auto& link : links_) {
+        link.op_ = this;
+      }
     }
 
     void start() noexcept {
+      this->listen_for_stop();
+
       if (!context_.is_running_on_io_thread()) {
         this->execute_ = &operation::on_schedule_complete;
         context_.schedule_remote(this);
@@ -546,58 +1503,1773 @@ class io_uring_context::write_sender {
     void start_io() noexcept {
       UNIFEX_ASSERT(context_.is_running_on_io_thread());
 
-      auto populateSqe = [this](io_uring_sqe & sqe) noexcept {
-        sqe.opcode = IORING_OP_WRITEV;
-        sqe.flags = 0;
-        sqe.ioprio = 0;
-        sqe.fd = fd_;
-        sqe.off = offset_;
-        sqe.addr = reinterpret_cast<std::uintptr_t>(&buffer_[0]);
-        sqe.len = 1;
-        sqe.rw_flags = 0;
-        sqe.user_data = reinterpret_cast<std::uintptr_t>(
-            static_cast<completion_base*>(this));
-        sqe.__pad2[0] = sqe.__pad2[1] = sqe.__pad2[2] = 0;
-
-        this->execute_ = &operation::on_write_complete;
-      };
+      if constexpr (is_stop_ever_possible) {
+        if (get_stop_token(receiver_).stop_requested()) {
+          result_ = -ECANCELED;
+          complete();
+          return;
+        }
+      }
 
-      if (!context_.try_submit_io(populateSqe)) {
-        this->execute_ = &operation::on_schedule_complete;
-        context_.schedule_pending_io(this);
+      const bool sameContext = std::apply(
+          [this](const Ops&... ops) noexcept {
+            return ((&ops.context_ == &context_) && ...);
+          },
+          ops_);
+      if (!sameContext) {
+        result_ = -EINVAL;
+        complete();
+        return;
       }
+
+      submit_links();
+    }
+
+    // Submits the links from nextLink_ onwards, up to the first one whose
+    // opcode the kernel doesn't support. Those are run with their blocking
+    // fallback instead.
+    void submit_links() noexcept {
+      UNIFEX_ASSERT(context_.is_running_on_io_thread());
+
+      if (this->cancel_requested()) {
+        result_ = -ECANCELED;
+        complete();
+        return;
+      }
+
+      while (!context_.is_op_supported(opcodes[nextLink_])) {
+        auto& link = links_[nextLink_];
+        link.result_ = fallback(nextLink_);
+        link.completed_ = true;
+        if (link.result_ < 0) {
+          result_ = link.result_;
+          complete();
+          return;
+        }
+        if (++nextLink_ == count) {
+          result_ = link.result_;
+          complete();
+          return;
+        }
+      }
+
+      batchCount_ = 1;
+      while (nextLink_ + batchCount_ < count &&
+             context_.is_op_supported(opcodes[nextLink_ + batchCount_])) {
+        ++batchCount_;
+      }
+
+      auto populateSqe = [this](io_uring_sqe & sqe, std::uint32_t index) noexcept {
+        auto& link = links_[nextLink_ + index];
+        populate(sqe, nextLink_ + index);
+        if (index + 1 < batchCount_) {
+          sqe.flags |= IOSQE_IO_LINK;
+        }
+        if (nextLink_ + index + 1 < count) {
+          wait_all(sqe);
+        }
+        sqe.user_data = reinterpret_cast<std::uintptr_t>(
+            static_cast<completion_base*>(&link));
+
+        // A link cancelled by a short transfer is submitted again.
+        link.completed_ = false;
+      };
+
+      if (context_.try_submit_io_chain(batchCount_, populateSqe)) {
+        submitted_ = true;
+        remainingCount_ = batchCount_;
+      } else {
+        this->execute_ = &operation::on_resubmit;
+        context_.schedule_pending_io(this);
+      }
+    }
+
+    // Runs once there is space in the submission queue for the rest of the
+    // chain.
+    static void on_resubmit(operation_base* op) noexcept {
+      static_cast<operation*>(op)->submit_links();
+    }
+
+    void populate(io_uring_sqe& sqe, std::uint32_t index) noexcept {
+      std::uint32_t i = 0;
+      std::apply(
+          [&](Ops&... ops) noexcept {
+            ((i++ == index ? ops.populate(sqe) : void()), ...);
+          },
+          ops_);
+    }
+
+    // Have the kernel carry on after a short send or receive, so that it
+    // only completes early at the end of the stream, and then breaks the
+    // chain like a short read or write.
+    static void wait_all(io_uring_sqe& sqe) noexcept {
+      switch (sqe.opcode) {
+        case IORING_OP_SEND:
+        case IORING_OP_RECV:
+        case IORING_OP_SENDMSG:
+        case IORING_OP_RECVMSG:
+          sqe.msg_flags |= MSG_WAITALL;
+          break;
+        default:
+          break;
+      }
+    }
+
+    // Skips what the link at 'index' has transferred, and returns whether
+    // there is any of its buffer left.
+    bool advance(std::uint32_t index, int result) noexcept {
+      std::uint32_t i = 0;
+      bool left = false;
+      std::apply(
+          [&](Ops&... ops) noexcept {
+            ((i++ == index ? void(left = op_advance(ops, result)) : void()),
+             ...);
+          },
+          ops_);
+      return left;
+    }
+
+    int fallback(std::uint32_t index) noexcept {
+      std::uint32_t i = 0;
+      int result = 0;
+      std::apply(
+          [&](Ops&... ops) noexcept {
+            ((i++ == index ? void(result = ops.fallback()) : void()), ...);
+          },
+          ops_);
+      return result;
+    }
+
+    static void on_link_complete(operation_base* op) noexcept {
+      auto& link = *static_cast<link_completion*>(op);
+      link.completed_ = true;
+      auto& self = *link.op_;
+      if (--self.remainingCount_ == 0) {
+        self.submitted_ = false;
+        self.on_links_complete();
+      }
+    }
+
+    // Called once all the links of the last submission have completed.
+    void on_links_complete() noexcept {
+      const std::uint32_t end = nextLink_ + batchCount_;
+      for (std::uint32_t i = nextLink_; i < end; ++i) {
+        const int result = links_[i].result_;
+        if (result >= 0) {
+          if (i + 1 < count && advance(i, result)) {
+            if (result == 0 ||
+                (i + 1 < end && links_[i + 1].result_ != -ECANCELED)) {
+              // No progress, so there's no point trying again, or the next
+              // operation has already run without waiting for the rest.
+              result_ = -EIO;
+              complete();
+              return;
+            }
+            // Transfer the rest before carrying on with the chain.
+            nextLink_ = i;
+            submit_links();
+            return;
+          }
+          continue;
+        }
+        if (result == -ECANCELED && i > nextLink_ &&
+            !this->cancel_requested()) {
+          // The previous operation broke the chain although it succeeded,
+          // and there's nothing of it we can submit again.
+          result_ = -EIO;
+          complete();
+          return;
+        }
+        result_ = result;
+        complete();
+        return;
+      }
+
+      if (end == count) {
+        result_ = links_[count - 1].result_;
+        complete();
+      } else {
+        nextLink_ = end;
+        submit_links();
+      }
+    }
+
+    void complete() noexcept {
+      if (this->ready_to_deliver()) {
+        deliver();
+      }
+    }
+
+    void deliver() noexcept {
+      if (this->cancel_requested() && is_interrupted_result(result_)) {
+        result_ = -ECANCELED;
+      }
+      if (result_ >= 0) {
+        UNIFEX_TRY {
+          complete_predecessors(std::make_index_sequence<count - 1>{});
+          auto& last = std::get<count - 1>(ops_);
+          if constexpr (std::is_void_v<result_type>) {
+            last.complete(result_);
+            unifex::set_value(std::move(receiver_));
+          } else {
+            unifex::set_value(std::move(receiver_), last.complete(result_));
+          }
+        } UNIFEX_CATCH (...) {
+          unifex::set_error(std::move(receiver_), std::current_exception());
+        }
+      } else if (result_ == -ECANCELED) {
+        abandon_links(std::make_index_sequence<count>{});
+        unifex::set_done(std::move(receiver_));
+      } else {
+        abandon_links(std::make_index_sequence<count>{});
+        unifex::set_error(
+            std::move(receiver_),
+            std::error_code{-result_, std::system_category()});
+      }
+    }
+
+    // Let the other operations produce their values, so that any resources
+    // they hold are released, and discard them.
+    template <std::size_t... Indices>
+    void complete_predecessors(std::index_sequence<Indices...>) {
+      (static_cast<void>(
+           std::get<Indices>(ops_).complete(links_[Indices].result_)),
+       ...);
+    }
+
+    // The chain failed. Let the operations that did succeed release their
+    // resources as above, and tell the others that they didn't complete.
+    template <std::size_t... Indices>
+    void abandon_links(std::index_sequence<Indices...>) noexcept {
+      (abandon_link<Indices>(), ...);
+    }
+
+    template <std::size_t Index>
+    void abandon_link() noexcept {
+      auto& op = std::get<Index>(ops_);
+      const auto& link = links_[Index];
+      if (link.completed_ && link.result_ >= 0) {
+        static_cast<void>(op.complete(link.result_));
+      } else {
+        op_failed(op, link.completed_ ? link.result_ : -ECANCELED);
+      }
+    }
+
+    bool cancel_io() noexcept {
+      if (!submitted_) {
+        // Still waiting for space in the submission queue. start_io() will
+        // see the stop request when it gets to run.
+        return true;
+      }
+
+      // Only one operation of the chain is running at a time, but we can't
+      // tell which one, so try to cancel all of those that were submitted
+      // and haven't completed. Cancelling the running one fails the rest of
+      // the chain.
+      completion_base* outstanding[count];
+      std::uint32_t outstandingCount = 0;
+      for (std::uint32_t i = nextLink_; i < nextLink_ + batchCount_; ++i) {
+        if (!links_[i].completed_) {
+          outstanding[outstandingCount++] = &links_[i];
+        }
+      }
+
+      auto populateSqe = [&](io_uring_sqe & sqe, std::uint32_t index) noexcept {
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(outstanding[index]);
+        sqe.user_data = context_.ignored_user_data();
+      };
+
+      if (context_.try_submit_io_chain(outstandingCount, populateSqe)) {
+        return true;
+      }
+      context_.schedule_pending_io(this->cancel_operation());
+      return false;
+    }
+
+    struct link_completion : completion_base {
+      link_completion() noexcept {
+        this->execute_ = &operation::on_link_complete;
+      }
+      operation* op_;
+      bool completed_ = false;
+    };
+
+    io_uring_context& context_;
+    std::tuple<Ops...> ops_;
+    Receiver receiver_;
+    link_completion links_[count];
+    // The first link of the last submission.
+    std::uint32_t nextLink_ = 0;
+    // The number of links in, and the completions still to arrive for, the
+    // last submission.
+    std::uint32_t batchCount_ = 0;
+    std::uint32_t remainingCount_ = 0;
+    int result_ = 0;
+    bool submitted_ = false;
+  };
+
+ public:
+  template <
+      template <typename...> class Variant,
+      template <typename...> class Tuple>
+  using value_types = Variant<typename value_tuple<Tuple, result_type>::type>;
+
+  // Note: Only case it might complete with exception_ptr is if the
+  // receiver's set_value() exits with an exception.
+  template <template <typename...> class Variant>
+  using error_types = Variant<std::error_code, std::exception_ptr>;
+
+  static constexpr bool sends_done = true;
+
+  explicit linked_sender(std::tuple<Ops...> ops) noexcept(
+      (std::is_nothrow_move_constructible_v<Ops> && ...))
+    : ops_(std::move(ops)) {}
+
+  template <typename Receiver>
+  operation<remove_cvref_t<Receiver>> connect(Receiver&& r) && {
+    return operation<remove_cvref_t<Receiver>>{
+        std::move(ops_), (Receiver &&) r};
+  }
+
+ private:
+  friend io_uring_context;
+
+  std::tuple<Ops...> ops_;
+};
+
+template <typename... Ops>
+std::tuple<Ops...> io_uring_context::take_linked_ops(
+    linked_sender<Ops...>&& sender) noexcept(
+    (std::is_nothrow_move_constructible_v<Ops> && ...)) {
+  return std::move(sender.ops_);
+}
+
+template <typename... Ops>
+io_uring_context::linked_sender<Ops...> io_uring_context::make_linked_sender(
+    std::tuple<Ops...>&& ops) noexcept(
+    (std::is_nothrow_move_constructible_v<Ops> && ...)) {
+  return linked_sender<Ops...>{std::move(ops)};
+}
+
+template <typename File, int Flags>
+struct io_uring_context::open_op {
+  static constexpr std::uint8_t opcode = IORING_OP_OPENAT;
+  static constexpr bool cancellable = false;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(path_.c_str());
+    sqe.len = 0644;
+    sqe.open_flags = Flags;
+  }
+
+  File complete(int result) noexcept {
+    return File{context_, result};
+  }
+
+  int fallback() noexcept {
+    int fd = ::open(path_.c_str(), Flags, 0644);
+    return fd < 0 ? -errno : fd;
+  }
+
+  io_uring_context& context_;
+  filesystem::path path_;
+};
+
+// Closes the plain descriptor, since IORING_OP_CLOSE doesn't accept fixed
+// files. The file keeps its descriptor and fixed-file slot until the close
+// has completed, so that operations linked before the close can still use
+// them, and keeps owning the descriptor if the close never ran.
+struct io_uring_context::close_op {
+  static constexpr std::uint8_t opcode = IORING_OP_CLOSE;
+  static constexpr bool cancellable = false;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.fd = fd_;
+  }
+
+  void complete(int) noexcept {
+    // The descriptor is closed already, so just drop the fixed-file slot.
+    static_cast<void>(file_->release());
+  }
+
+  void failed(int result) noexcept {
+    // Other than these, errors are reported after the descriptor has been
+    // closed.
+    if (result != -ECANCELED && result != -EBADF) {
+      static_cast<void>(file_->release());
+    }
+  }
+
+  int fallback() noexcept {
+    return ::close(fd_) < 0 ? -errno : 0;
+  }
+
+  io_uring_context& context_;
+  registered_fd* file_;
+  int fd_;
+};
+
+struct io_uring_context::fsync_op {
+  static constexpr std::uint8_t opcode = IORING_OP_FSYNC;
+  static constexpr bool cancellable = false;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.fsync_flags = fsyncFlags_;
+  }
+
+  void complete(int) noexcept {}
+
+  int fallback() noexcept {
+    int result = (fsyncFlags_ & IORING_FSYNC_DATASYNC) != 0
+        ? ::fdatasync(fd_->get())
+        : ::fsync(fd_->get());
+    return result < 0 ? -errno : 0;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  std::uint32_t fsyncFlags_;
+};
+
+struct io_uring_context::fallocate_op {
+  static constexpr std::uint8_t opcode = IORING_OP_FALLOCATE;
+  static constexpr bool cancellable = false;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.off = static_cast<std::uint64_t>(offset_);
+    sqe.addr = static_cast<std::uint64_t>(length_);
+    sqe.len = 0; // mode
+  }
+
+  void complete(int) noexcept {}
+
+  int fallback() noexcept {
+    return ::fallocate(fd_->get(), 0, offset_, length_) < 0 ? -errno : 0;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  std::int64_t offset_;
+  std::int64_t length_;
+};
+
+struct io_uring_context::statx_op {
+  static constexpr std::uint8_t opcode = IORING_OP_STATX;
+  static constexpr bool cancellable = false;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    // Stat the descriptor itself. IORING_OP_STATX doesn't accept fixed
+    // files.
+    sqe.opcode = opcode;
+    sqe.fd = fd_->get();
+    sqe.addr = reinterpret_cast<std::uintptr_t>("");
+    sqe.len = STATX_BASIC_STATS;
+    sqe.off = reinterpret_cast<std::uintptr_t>(&buffer_);
+    sqe.statx_flags = AT_EMPTY_PATH;
+  }
+
+  struct statx complete(int) noexcept {
+    return buffer_;
+  }
+
+  int fallback() noexcept {
+    return ::statx(fd_->get(), "", AT_EMPTY_PATH, STATX_BASIC_STATS, &buffer_) < 0
+        ? -errno
+        : 0;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  struct statx buffer_;
+};
+
+// Splicing to or from a pipe or socket can wait indefinitely, so like the
+// socket operations these don't fall back to blocking syscalls.
+
+struct io_uring_context::splice_op {
+  static constexpr std::uint8_t opcode = IORING_OP_SPLICE;
+  static constexpr bool cancellable = true;
+
+  // The most the kernel moves in one splice or tee.
+  static constexpr std::size_t max_length = 0x7ffff000;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    populate_splice(sqe, *in_, inOffset_, *out_, outOffset_, length_);
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* in_;
+  std::int64_t inOffset_;
+  registered_fd* out_;
+  std::int64_t outOffset_;
+  std::uint32_t length_;
+};
+
+struct io_uring_context::tee_op {
+  static constexpr std::uint8_t opcode = IORING_OP_TEE;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.fd = out_->sqe_fd();
+    sqe.flags = out_->sqe_flags();
+    sqe.splice_fd_in = in_->sqe_fd();
+    sqe.len = length_;
+    sqe.splice_flags = in_->sqe_flags() != 0 ? SPLICE_F_FD_IN_FIXED : 0;
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* in_;
+  registered_fd* out_;
+  std::uint32_t length_;
+};
+
+// Operations common to files and sockets.
+class io_uring_context::descriptor_base {
+ protected:
+  explicit descriptor_base(io_uring_context& context, int fd) noexcept
+      : context_(context), fd_(context, fd) {}
+
+ private:
+  friend op_sender<close_op> tag_invoke(
+      tag_t<async_close>, descriptor_base& d) noexcept {
+    return op_sender<close_op>{close_op{d.context_, &d.fd_, d.fd_.get()}};
+  }
+
+  friend op_sender<splice_op> tag_invoke(
+      tag_t<async_splice>,
+      descriptor_base& in,
+      std::int64_t inOffset,
+      descriptor_base& out,
+      std::int64_t outOffset,
+      std::size_t length) noexcept {
+    return op_sender<splice_op>{splice_op{
+        in.context_,
+        &in.fd_,
+        inOffset,
+        &out.fd_,
+        outOffset,
+        static_cast<std::uint32_t>(std::min(length, splice_op::max_length))}};
+  }
+
+  // Defined after sendfile_sender.
+  friend sendfile_sender tag_invoke(
+      tag_t<async_sendfile>,
+      async_socket& socket,
+      file_base& file,
+      std::int64_t offset,
+      std::size_t length) noexcept;
+
+ protected:
+  io_uring_context& context_;
+  registered_fd fd_;
+};
+
+// Operations common to all of the file types.
+class io_uring_context::file_base : public descriptor_base {
+ public:
+  using offset_t = std::int64_t;
+
+ protected:
+  explicit file_base(io_uring_context& context, int fd) noexcept
+      : descriptor_base(context, fd) {}
+
+ private:
+  friend op_sender<fsync_op> tag_invoke(
+      tag_t<async_fsync>, file_base& file) noexcept {
+    return op_sender<fsync_op>{fsync_op{file.context_, &file.fd_, 0}};
+  }
+
+  friend op_sender<fsync_op> tag_invoke(
+      tag_t<async_fdatasync>, file_base& file) noexcept {
+    return op_sender<fsync_op>{
+        fsync_op{file.context_, &file.fd_, IORING_FSYNC_DATASYNC}};
+  }
+
+  friend op_sender<fallocate_op> tag_invoke(
+      tag_t<async_fallocate>,
+      file_base& file,
+      offset_t offset,
+      offset_t length) noexcept {
+    return op_sender<fallocate_op>{
+        fallocate_op{file.context_, &file.fd_, offset, length}};
+  }
+
+  friend op_sender<statx_op> tag_invoke(
+      tag_t<async_statx>, file_base& file) noexcept {
+    return op_sender<statx_op>{statx_op{file.context_, &file.fd_, {}}};
+  }
+};
+
+class io_uring_context::async_read_only_file : public file_base {
+ public:
+  explicit async_read_only_file(io_uring_context& context, int fd) noexcept
+      : file_base(context, fd) {}
+
+ private:
+  friend scheduler;
+
+  friend read_sender tag_invoke(
+      tag_t<async_read_some_at>,
+      async_read_only_file& file,
+      offset_t offset,
+      span<std::byte> buffer) noexcept {
+    return read_sender{
+        file.context_, file.fd_.sqe_fd(), offset, buffer, file.fd_.sqe_flags()};
+  }
+};
+
+class io_uring_context::async_write_only_file : public file_base {
+ public:
+  explicit async_write_only_file(io_uring_context& context, int fd) noexcept
+      : file_base(context, fd) {}
+
+ private:
+  friend scheduler;
+
+  friend write_sender tag_invoke(
+      tag_t<async_write_some_at>,
+      async_write_only_file& file,
+      offset_t offset,
+      span<const std::byte> buffer) noexcept {
+    return write_sender{
+        file.context_, file.fd_.sqe_fd(), offset, buffer, file.fd_.sqe_flags()};
+  }
+};
+
+class io_uring_context::async_read_write_file : public file_base {
+ public:
+  explicit async_read_write_file(io_uring_context& context, int fd) noexcept
+      : file_base(context, fd) {}
+
+ private:
+  friend scheduler;
+
+  friend write_sender tag_invoke(
+      tag_t<async_write_some_at>,
+      async_read_write_file& file,
+      offset_t offset,
+      span<const std::byte> buffer) noexcept {
+    return write_sender{
+        file.context_, file.fd_.sqe_fd(), offset, buffer, file.fd_.sqe_flags()};
+  }
+
+  friend read_sender tag_invoke(
+      tag_t<async_read_some_at>,
+      async_read_write_file& file,
+      offset_t offset,
+      span<std::byte> buffer) noexcept {
+    return read_sender{
+        file.context_, file.fd_.sqe_fd(), offset, buffer, file.fd_.sqe_flags()};
+  }
+};
+
+// The read end of a pipe.
+class io_uring_context::async_pipe_reader : public descriptor_base {
+ public:
+  explicit async_pipe_reader(io_uring_context& context, int fd) noexcept
+      : descriptor_base(context, fd) {}
+
+ private:
+  friend op_sender<read_op> tag_invoke(
+      tag_t<async_read_some>,
+      async_pipe_reader& pipe,
+      span<std::byte> buffer) noexcept {
+    return op_sender<read_op>{read_op{
+        pipe.context_,
+        pipe.fd_.sqe_fd(),
+        pipe.fd_.sqe_flags(),
+        -1,
+        {buffer.data(), buffer.size()}}};
+  }
+
+  friend op_sender<tee_op> tag_invoke(
+      tag_t<async_tee>,
+      async_pipe_reader& in,
+      async_pipe_writer& out,
+      std::size_t length) noexcept;
+};
+
+// The write end of a pipe.
+class io_uring_context::async_pipe_writer : public descriptor_base {
+ public:
+  explicit async_pipe_writer(io_uring_context& context, int fd) noexcept
+      : descriptor_base(context, fd) {}
+
+ private:
+  friend op_sender<tee_op> tag_invoke(
+      tag_t<async_tee>,
+      async_pipe_reader& in,
+      async_pipe_writer& out,
+      std::size_t length) noexcept;
+
+  friend op_sender<write_op> tag_invoke(
+      tag_t<async_write_some>,
+      async_pipe_writer& pipe,
+      span<const std::byte> buffer) noexcept {
+    return op_sender<write_op>{write_op{
+        pipe.context_,
+        pipe.fd_.sqe_fd(),
+        pipe.fd_.sqe_flags(),
+        -1,
+        {const_cast<std::byte*>(buffer.data()), buffer.size()}}};
+  }
+};
+
+inline io_uring_context::op_sender<io_uring_context::tee_op> tag_invoke(
+    tag_t<async_tee>,
+    io_uring_context::async_pipe_reader& in,
+    io_uring_context::async_pipe_writer& out,
+    std::size_t length) noexcept {
+  return io_uring_context::op_sender<io_uring_context::tee_op>{
+      io_uring_context::tee_op{
+          in.context_,
+          &in.fd_,
+          &out.fd_,
+          static_cast<std::uint32_t>(
+              std::min(length, io_uring_context::splice_op::max_length))}};
+}
+
+// A set of equally sized buffers that the kernel picks from when data
+// arrives on a receive that selects a buffer, so idle connections don't
+// hold one. Each buffer is handed back to the kernel when the
+// provided_buffer holding it is destroyed.
+//
+// The buffers are registered as a provided buffer ring
+// (IORING_REGISTER_PBUF_RING), which userspace refills without a syscall.
+// If the kernel doesn't support buffer rings, or never hands out a buffer
+// from the ring, the pool falls back to providing each buffer with
+// IORING_OP_PROVIDE_BUFFERS.
+//
+// The pool must be created before run() is called or on the I/O thread, and
+// must outlive any operation and provided_buffer that uses it.
+class io_uring_context::provided_buffer_pool {
+ public:
+  // 'count' must be a power of two no greater than 32768.
+  provided_buffer_pool(
+      io_uring_context& context, std::uint32_t count, std::uint32_t bufferSize);
+  ~provided_buffer_pool();
+
+  provided_buffer_pool(const provided_buffer_pool&) = delete;
+  provided_buffer_pool& operator=(const provided_buffer_pool&) = delete;
+
+  std::uint16_t group_id() const noexcept { return groupId_; }
+  std::uint32_t buffer_count() const noexcept { return count_; }
+  std::uint32_t buffer_size() const noexcept { return bufferSize_; }
+
+  // Whether the buffers are currently handed over through a buffer ring.
+  bool uses_buffer_ring() const noexcept;
+
+ private:
+  friend io_uring_context;
+  friend provided_buffer;
+  friend receive_multishot_op;
+
+  std::byte* buffer(std::uint16_t bufferId) const noexcept {
+    return provideOp_->buffer(bufferId);
+  }
+
+  // Record that the kernel handed out the buffer. Called on the I/O thread.
+  void claim(std::uint16_t bufferId) noexcept;
+
+  // Hand the buffer back to the kernel. May be called from any thread.
+  void recycle(std::uint16_t bufferId) noexcept;
+
+  // Called on the I/O thread when a receive found no buffer. Returns true
+  // if the kernel has buffers to pick from again. Otherwise they are all
+  // held by the consumers, and 'resume' is scheduled once one is recycled.
+  bool replenish(operation_base* resume) noexcept;
+
+  // Forget a 'resume' passed to replenish(). Called on the I/O thread.
+  // Returns false if it has already been scheduled.
+  bool cancel_wait(operation_base* resume) noexcept;
+
+  // recycle() with mutex_ held.
+  void recycle_locked(std::uint16_t bufferId) noexcept;
+
+  void switch_to_provide_buffers() noexcept;
+
+  // Hands buffers back with IORING_OP_PROVIDE_BUFFERS on the I/O thread.
+  // It owns the storage, so that it can outlive the pool: once the pool is
+  // destroyed it takes the buffers back from the kernel with
+  // IORING_OP_REMOVE_BUFFERS, and deletes itself when that completes.
+  struct provide_operation : completion_base {
+    provide_operation(
+        io_uring_context& context,
+        std::uint16_t groupId,
+        std::uint32_t count,
+        std::uint32_t bufferSize);
+
+    std::byte* buffer(std::uint16_t bufferId) const noexcept {
+      return storage_.get() + std::size_t(bufferId) * bufferSize_;
+    }
+
+    // Queue the operation unless it already is. Called with mutex_ held.
+    void schedule() noexcept;
+
+    static void on_provide(operation_base* op) noexcept;
+    static void on_removed(operation_base* op) noexcept;
+
+    io_uring_context& context_;
+    std::uint16_t groupId_;
+    std::uint32_t count_;
+    std::uint32_t bufferSize_;
+    std::unique_ptr<std::byte[]> storage_;
+
+    std::mutex mutex_;
+    bool queued_ = false;
+    // Set when the pool is destroyed.
+    bool retired_ = false;
+    // Buffers waiting to be handed back.
+    std::vector<std::uint16_t> returned_;
+  };
+
+  io_uring_context& context_;
+  std::uint16_t groupId_;
+  std::uint32_t count_;
+  std::uint32_t bufferSize_;
+  std::unique_ptr<provide_operation> provideOp_;
+  mmap_region ringMmap_;
+  io_uring_buf_ring* ring_ = nullptr;
+
+  // Taken before provideOp_->mutex_ when both are needed.
+  mutable std::mutex mutex_;
+  bool usesRing_ = false;
+  bool ringDelivered_ = false;
+  std::uint16_t tail_ = 0;
+  std::uint32_t heldCount_ = 0;
+  std::vector<bool> held_;
+  // Streams waiting for a buffer to be recycled.
+  operation_queue waiting_;
+};
+
+// A buffer from a provided_buffer_pool holding received data.
+class io_uring_context::provided_buffer {
+ public:
+  provided_buffer(
+      provided_buffer_pool& pool,
+      std::uint16_t bufferId,
+      std::size_t size) noexcept
+    : pool_(&pool), bufferId_(bufferId), size_(size) {}
+
+  provided_buffer(provided_buffer&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)),
+      bufferId_(other.bufferId_),
+      size_(other.size_) {}
+
+  ~provided_buffer() {
+    if (pool_ != nullptr) {
+      pool_->recycle(bufferId_);
+    }
+  }
+
+  provided_buffer& operator=(provided_buffer other) noexcept {
+    std::swap(pool_, other.pool_);
+    std::swap(bufferId_, other.bufferId_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  span<const std::byte> data() const noexcept {
+    return span<const std::byte>{pool_->buffer(bufferId_), size_};
+  }
+
+  std::size_t size() const noexcept { return size_; }
+
+ private:
+  provided_buffer_pool* pool_;
+  std::uint16_t bufferId_;
+  std::size_t size_;
+};
+
+// A stream of the results of a multishot operation. One submission keeps
+// producing completions until it fails or is cancelled, and the stream
+// queues the results that arrive before the consumer asks for them. If the
+// kernel doesn't support the multishot form of the operation, the stream
+// submits the single-shot form for each call to next() instead.
+//
+// Op describes the operation:
+//  - 'populate(sqe, multishot)' fills in the submission queue entry.
+//  - 'retry(result, flags, resume)' sees every result first, and returns a
+//    multishot_retry saying whether to pass it on or drop it and submit the
+//    operation again. For multishot_retry::wait, the Op later schedules
+//    'resume' onto the I/O thread, from any thread.
+//  - 'cancel_wait(resume)' is called on the I/O thread when the stream is
+//    cleaned up while it waits. It returns false if 'resume' has already
+//    been scheduled.
+//  - 'is_end(result)' says whether a result marks the end of the stream.
+//  - 'complete(result, flags)' produces the value for a result.
+//  - 'discard(result, flags)' releases what a result refers to when it is
+//    not passed on.
+//
+// An error ends the stream after it is delivered. cleanup() cancels the
+// operation and must complete before the stream is destroyed.
+template <typename Op>
+class io_uring_context::multishot_stream {
+  using value_type = decltype(std::declval<Op&>().complete(0, 0));
+
+  struct result {
+    int result_;
+    std::uint32_t flags_;
+  };
+
+  // State shared with the next() and cleanup() operations. Only accessed on
+  // the I/O thread.
+  struct state : multishot_base {
+    explicit state(io_uring_context& context, Op&& op) noexcept
+      : context_(context),
+        op_(std::move(op)),
+        pumpOp_(*this, &state::on_pump),
+        resumeOp_(*this, &state::on_resume) {
+      this->onCompletion_ = &state::on_completion;
+    }
+
+    // Called from the completion loop, so just records the result.
+    static void on_completion(
+        multishot_base* base, int result, std::uint32_t flags) noexcept {
+      auto& self = *static_cast<state*>(base);
+      if ((flags & IORING_CQE_F_MORE) == 0) {
+        self.armed_ = false;
+      }
+
+      if (result == -EINVAL && self.multishot_ && !self.succeeded_) {
+        // The kernel doesn't know the multishot flag.
+        self.multishot_ = false;
+      } else if (const multishot_retry retry =
+                     self.op_.retry(result, flags, &self.resumeOp_);
+                 retry != multishot_retry::none) {
+        // Resubmit when the consumer next asks for a result, or once
+        // resumed.
+        self.waiting_ = retry == multishot_retry::wait;
+      } else if (result == -ECANCELED && self.cleanup_ != nullptr) {
+        // Cancelled by cleanup().
+      } else {
+        self.succeeded_ = self.succeeded_ || result >= 0;
+        self.results_.push_back(multishot_stream::result{result, flags});
+      }
+      self.schedule_pump();
+    }
+
+    void schedule_pump() noexcept {
+      if (!pumpQueued_) {
+        pumpQueued_ = true;
+        context_.schedule_local(&pumpOp_);
+      }
+    }
+
+    static void on_pump(operation_base* op) noexcept {
+      auto& self = static_cast<pump_operation*>(op)->state_;
+      self.pumpQueued_ = false;
+      self.pump();
+    }
+
+    static void on_resume(operation_base* op) noexcept {
+      auto& self = static_cast<pump_operation*>(op)->state_;
+      self.waiting_ = false;
+      self.pump();
+    }
+
+    // Move things along: finish a cleanup, hand a result to a waiting
+    // next() or submit the operation for it.
+    void pump() noexcept {
+      if (cleanup_ != nullptr) {
+        if (armed_) {
+          if (!cancelSubmitted_) {
+            submit_cancel();
+          }
+          return;
+        }
+        if (waiting_) {
+          if (!op_.cancel_wait(&resumeOp_)) {
+            // Already on its way, and it pumps again once it runs.
+            return;
+          }
+          waiting_ = false;
+        }
+        if (pumpQueued_) {
+          // Let the queued pump finish up so that nothing refers to the
+          // state once cleanup completes.
+          return;
+        }
+        while (!results_.empty()) {
+          op_.discard(results_.front().result_, results_.front().flags_);
+          results_.pop_front();
+        }
+        context_.schedule_local(std::exchange(cleanup_, nullptr));
+        return;
+      }
+
+      if (waiter_ == nullptr) {
+        return;
+      }
+      if (!results_.empty() || ended_) {
+        context_.schedule_local(std::exchange(waiter_, nullptr));
+      } else if (!armed_ && !waiting_) {
+        submit();
+      }
+    }
+
+    void submit() noexcept {
+      auto populateSqe = [this](io_uring_sqe & sqe) noexcept {
+        op_.populate(sqe, multishot_);
+        sqe.user_data = multishot_user_data(this);
+      };
+
+      if (context_.try_submit_io(populateSqe)) {
+        armed_ = true;
+      } else if (!pumpQueued_) {
+        pumpQueued_ = true;
+        context_.schedule_pending_io(&pumpOp_);
+      }
+    }
+
+    void submit_cancel() noexcept {
+      auto populateSqe = [this](io_uring_sqe & sqe) noexcept {
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = multishot_user_data(this);
+        sqe.user_data = context_.ignored_user_data();
+      };
+
+      if (context_.try_submit_io(populateSqe)) {
+        cancelSubmitted_ = true;
+      } else if (!pumpQueued_) {
+        pumpQueued_ = true;
+        context_.schedule_pending_io(&pumpOp_);
+      }
+    }
+
+    struct pump_operation : operation_base {
+      explicit pump_operation(
+          state& s, void (*execute)(operation_base*) noexcept) noexcept
+        : state_(s) {
+        this->execute_ = execute;
+      }
+      state& state_;
+    };
+
+    io_uring_context& context_;
+    Op op_;
+    std::deque<result> results_;
+    operation_base* waiter_ = nullptr;
+    operation_base* cleanup_ = nullptr;
+    pump_operation pumpOp_;
+    // Scheduled by the Op to end a multishot_retry::wait.
+    pump_operation resumeOp_;
+    bool pumpQueued_ = false;
+    bool armed_ = false;
+    bool waiting_ = false;
+    bool multishot_ = true;
+    bool succeeded_ = false;
+    bool ended_ = false;
+    bool cancelSubmitted_ = false;
+  };
+
+  template <typename Receiver>
+  class next_operation
+    : private operation_base
+    , private linuxos::cancellable_io_operation<
+          next_operation<Receiver>,
+          io_uring_context,
+          Receiver> {
+    friend linuxos::
+        cancellable_io_operation<next_operation, io_uring_context, Receiver>;
+
+    static constexpr bool is_stop_ever_possible =
+        !is_stop_never_possible_v<stop_token_type_t<Receiver>>;
+
+   public:
+    template <typename Receiver2>
+    explicit next_operation(state& s, Receiver2&& r)
+      : context_(s.context_), state_(s), receiver_((Receiver2 &&) r) {}
+
+    void start() noexcept {
+      this->listen_for_stop();
+
+      this->execute_ = &next_operation::on_start;
+      if (!context_.is_running_on_io_thread()) {
+        context_.schedule_remote(this);
+      } else {
+        on_start(this);
+      }
+    }
+
+   private:
+    static void on_start(operation_base* op) noexcept {
+      auto& self = *static_cast<next_operation*>(op);
+      if constexpr (is_stop_ever_possible) {
+        if (get_stop_token(self.receiver_).stop_requested()) {
+          self.finish();
+          return;
+        }
+      }
+
+      UNIFEX_ASSERT(self.state_.waiter_ == nullptr);
+      self.execute_ = &next_operation::on_ready;
+      self.state_.waiter_ = &self;
+      self.state_.pump();
+    }
+
+    static void on_ready(operation_base* op) noexcept {
+      static_cast<next_operation*>(op)->finish();
+    }
+
+    void finish() noexcept {
+      if (this->ready_to_deliver()) {
+        deliver();
+      }
+    }
+
+    void deliver() noexcept {
+      auto& results = state_.results_;
+      if (state_.ended_ || results.empty() ||
+          get_stop_token(receiver_).stop_requested()) {
+        // A stop request leaves any queued result for the next call.
+        unifex::set_done(std::move(receiver_));
+        return;
+      }
+
+      const result r = results.front();
+      results.pop_front();
+      if (r.result_ < 0 || state_.op_.is_end(r.result_)) {
+        state_.ended_ = true;
+        state_.op_.discard(r.result_, r.flags_);
+        if (r.result_ < 0) {
+          unifex::set_error(
+              std::move(receiver_),
+              std::error_code{-r.result_, std::system_category()});
+        } else {
+          unifex::set_done(std::move(receiver_));
+        }
+        return;
+      }
+
+      UNIFEX_TRY {
+        unifex::set_value(
+            std::move(receiver_), state_.op_.complete(r.result_, r.flags_));
+      } UNIFEX_CATCH (...) {
+        unifex::set_error(std::move(receiver_), std::current_exception());
+      }
+    }
+
+    // The multishot operation itself keeps running; only cleanup() cancels
+    // it.
+    bool cancel_io() noexcept {
+      if (state_.waiter_ == this) {
+        state_.waiter_ = nullptr;
+        finish();
+      }
+      // Otherwise on_start() or on_ready() is still queued and will see the
+      // stop request.
+      return true;
+    }
+
+    io_uring_context& context_;
+    state& state_;
+    Receiver receiver_;
+  };
+
+  template <typename Receiver>
+  class cleanup_operation : private operation_base {
+   public:
+    template <typename Receiver2>
+    explicit cleanup_operation(state& s, Receiver2&& r)
+      : state_(s), receiver_((Receiver2 &&) r) {}
+
+    void start() noexcept {
+      this->execute_ = &cleanup_operation::on_start;
+      if (!state_.context_.is_running_on_io_thread()) {
+        state_.context_.schedule_remote(this);
+      } else {
+        on_start(this);
+      }
+    }
+
+   private:
+    static void on_start(operation_base* op) noexcept {
+      auto& self = *static_cast<cleanup_operation*>(op);
+      UNIFEX_ASSERT(self.state_.waiter_ == nullptr);
+      self.execute_ = &cleanup_operation::on_complete;
+      self.state_.cleanup_ = &self;
+      self.state_.pump();
+    }
+
+    static void on_complete(operation_base* op) noexcept {
+      auto& self = *static_cast<cleanup_operation*>(op);
+      unifex::set_value(std::move(self.receiver_));
+    }
+
+    state& state_;
+    Receiver receiver_;
+  };
+
+  class next_sender {
+   public:
+    template <
+        template <typename...> class Variant,
+        template <typename...> class Tuple>
+    using value_types = Variant<Tuple<value_type>>;
+
+    template <template <typename...> class Variant>
+    using error_types = Variant<std::error_code, std::exception_ptr>;
+
+    static constexpr bool sends_done = true;
+
+    explicit next_sender(state& s) noexcept : state_(s) {}
+
+    template <typename Receiver>
+    next_operation<remove_cvref_t<Receiver>> connect(Receiver&& r) const {
+      return next_operation<remove_cvref_t<Receiver>>{state_, (Receiver &&) r};
+    }
+
+   private:
+    state& state_;
+  };
+
+  class cleanup_sender {
+   public:
+    template <
+        template <typename...> class Variant,
+        template <typename...> class Tuple>
+    using value_types = Variant<Tuple<>>;
+
+    template <template <typename...> class Variant>
+    using error_types = Variant<>;
+
+    static constexpr bool sends_done = false;
+
+    explicit cleanup_sender(state& s) noexcept : state_(s) {}
+
+    template <typename Receiver>
+    cleanup_operation<remove_cvref_t<Receiver>> connect(Receiver&& r) const {
+      return cleanup_operation<remove_cvref_t<Receiver>>{
+          state_, (Receiver &&) r};
+    }
+
+   private:
+    state& state_;
+  };
+
+ public:
+  explicit multishot_stream(io_uring_context& context, Op op)
+    : state_(std::make_unique<state>(context, std::move(op))) {}
+
+  next_sender next() noexcept { return next_sender{*state_}; }
+
+  cleanup_sender cleanup() noexcept { return cleanup_sender{*state_}; }
+
+ private:
+  std::unique_ptr<state> state_;
+};
+
+struct io_uring_context::receive_multishot_op {
+  void populate(io_uring_sqe& sqe, bool multishot) noexcept {
+    sqe.opcode = IORING_OP_RECV;
+    sqe.flags = fd_->sqe_flags() | IOSQE_BUFFER_SELECT;
+    sqe.fd = fd_->sqe_fd();
+    sqe.buf_group = pool_->group_id();
+    if (multishot) {
+      sqe.ioprio = IORING_RECV_MULTISHOT;
+    }
+  }
+
+  multishot_retry retry(
+      int result, std::uint32_t flags, operation_base* resume) noexcept {
+    if ((flags & IORING_CQE_F_BUFFER) != 0) {
+      pool_->claim(
+          static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
     }
+    if (result != -ENOBUFS) {
+      return multishot_retry::none;
+    }
+    // Running out of buffers while the consumers hold them all is expected
+    // with a pool shared by many streams, so wait for one to come back
+    // rather than ending the stream.
+    return pool_->replenish(resume) ? multishot_retry::resubmit
+                                    : multishot_retry::wait;
+  }
 
-    static void on_write_complete(operation_base* op) noexcept {
-      auto& self = *static_cast<operation*>(op);
-      if (self.result_ >= 0) {
-        if constexpr (noexcept(unifex::set_value(std::move(self.receiver_), ssize_t(self.result_)))) {
-          unifex::set_value(std::move(self.receiver_), ssize_t(self.result_));
+  bool cancel_wait(operation_base* resume) noexcept {
+    return pool_->cancel_wait(resume);
+  }
+
+  static bool is_end(int result) noexcept {
+    return result == 0;
+  }
+
+  provided_buffer complete(int result, std::uint32_t flags) noexcept {
+    UNIFEX_ASSERT((flags & IORING_CQE_F_BUFFER) != 0);
+    return provided_buffer{
+        *pool_,
+        static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT),
+        static_cast<std::size_t>(result)};
+  }
+
+  void discard(int, std::uint32_t flags) noexcept {
+    if ((flags & IORING_CQE_F_BUFFER) != 0) {
+      pool_->recycle(
+          static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
+    }
+  }
+
+  registered_fd* fd_;
+  provided_buffer_pool* pool_;
+};
+
+// The socket operations don't fall back to blocking syscalls on kernels
+// that lack the opcode, since waiting for a peer could stall the I/O thread
+// indefinitely.
+
+struct io_uring_context::recv_op {
+  static constexpr std::uint8_t opcode = IORING_OP_RECVMSG;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    if (context_.is_op_supported(IORING_OP_RECV)) {
+      sqe.opcode = IORING_OP_RECV;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(buffer_.iov_base);
+      sqe.len = static_cast<std::uint32_t>(buffer_.iov_len);
+    } else {
+      // IORING_OP_RECV was added in 5.6.
+      std::memset(&message_, 0, sizeof(message_));
+      message_.msg_iov = &buffer_;
+      message_.msg_iovlen = 1;
+      sqe.opcode = IORING_OP_RECVMSG;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(&message_);
+      sqe.len = 1;
+    }
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  bool advance(int result) noexcept {
+    return advance_buffer(buffer_, static_cast<std::size_t>(result));
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  iovec buffer_;
+  msghdr message_;
+};
+
+struct io_uring_context::send_op {
+  static constexpr std::uint8_t opcode = IORING_OP_SENDMSG;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.msg_flags = MSG_NOSIGNAL;
+    if (context_.is_op_supported(IORING_OP_SEND)) {
+      sqe.opcode = IORING_OP_SEND;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(buffer_.iov_base);
+      sqe.len = static_cast<std::uint32_t>(buffer_.iov_len);
+    } else {
+      // IORING_OP_SEND was added in 5.6.
+      std::memset(&message_, 0, sizeof(message_));
+      message_.msg_iov = &buffer_;
+      message_.msg_iovlen = 1;
+      sqe.opcode = IORING_OP_SENDMSG;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(&message_);
+      sqe.len = 1;
+    }
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  bool advance(int result) noexcept {
+    return advance_buffer(buffer_, static_cast<std::size_t>(result));
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  iovec buffer_;
+  msghdr message_;
+};
+
+struct io_uring_context::receive_message_op {
+  static constexpr std::uint8_t opcode = IORING_OP_RECVMSG;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.addr = reinterpret_cast<std::uintptr_t>(message_);
+    sqe.len = 1;
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  msghdr* message_;
+};
+
+struct io_uring_context::send_message_op {
+  static constexpr std::uint8_t opcode = IORING_OP_SENDMSG;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.addr = reinterpret_cast<std::uintptr_t>(message_);
+    sqe.len = 1;
+    sqe.msg_flags = MSG_NOSIGNAL;
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  const msghdr* message_;
+};
+
+struct io_uring_context::send_zero_copy_op {
+  static constexpr std::uint8_t opcode = IORING_OP_SEND;
+  static constexpr bool cancellable = true;
+  static constexpr bool has_notification = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.addr = reinterpret_cast<std::uintptr_t>(buffer_.iov_base);
+    sqe.len = static_cast<std::uint32_t>(buffer_.iov_len);
+    sqe.msg_flags = MSG_NOSIGNAL;
+    if (context_.is_op_supported(IORING_OP_SEND_ZC)) {
+      sqe.opcode = IORING_OP_SEND_ZC;
+      const int bufferIndex =
+          context_.find_registered_buffer(buffer_.iov_base, buffer_.iov_len);
+      if (bufferIndex >= 0) {
+        sqe.ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe.buf_index = static_cast<std::uint16_t>(bufferIndex);
+      }
+    } else {
+      // IORING_OP_SEND_ZC was added in 6.0. A plain send is done with the
+      // buffer as soon as it completes.
+      sqe.opcode = IORING_OP_SEND;
+    }
+  }
+
+  ssize_t complete(int result) noexcept {
+    return result;
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
+  }
+
+  io_uring_context& context_;
+  registered_fd* fd_;
+  iovec buffer_;
+};
+
+// Sends part of a file on a socket by splicing it into a pipe from the
+// context's pool and from there into the socket, so that the data never
+// passes through userspace. Each chunk of up to the pipe's capacity is
+// submitted as a linked pair of splices. If the socket takes less than the
+// whole chunk, the rest is drained from the pipe before reading more of the
+// file.
+class io_uring_context::sendfile_sender {
+  template <typename Receiver>
+  class operation
+    : private operation_base
+    , private linuxos::cancellable_io_operation<
+          operation<Receiver>,
+          io_uring_context,
+          Receiver> {
+    friend io_uring_context;
+    friend linuxos::
+        cancellable_io_operation<operation, io_uring_context, Receiver>;
+
+    static constexpr bool is_stop_ever_possible =
+        !is_stop_never_possible_v<stop_token_type_t<Receiver>>;
+
+   public:
+    template <typename Receiver2>
+    explicit operation(const sendfile_sender& sender, Receiver2&& r)
+        : context_(sender.context_),
+          socket_(sender.socket_),
+          file_(sender.file_),
+          offset_(sender.offset_),
+          remaining_(sender.length_),
+          receiver_((Receiver2 &&) r) {}
+
+    void start() noexcept {
+      this->listen_for_stop();
+
+      this->execute_ = &operation::on_start;
+      if (!context_.is_running_on_io_thread()) {
+        context_.schedule_remote(this);
+      } else {
+        start_io();
+      }
+    }
+
+   private:
+    static void on_start(operation_base* op) noexcept {
+      static_cast<operation*>(op)->start_io();
+    }
+
+    void start_io() noexcept {
+      UNIFEX_ASSERT(context_.is_running_on_io_thread());
+
+      if (!context_.is_op_supported(IORING_OP_SPLICE)) {
+        finish(-EOPNOTSUPP);
+        return;
+      }
+
+      if (const int result = context_.acquire_pipe(pipe_); result < 0) {
+        finish(result);
+        return;
+      }
+
+      step();
+    }
+
+    static void on_step(operation_base* op) noexcept {
+      static_cast<operation*>(op)->step();
+    }
+
+    // Submit the next splice(s), or finish once the whole range is sent.
+    void step() noexcept {
+      if (this->cancel_requested()) {
+        finish(-ECANCELED);
+        return;
+      }
+
+      std::uint32_t count;
+      if (pipeBytes_ > 0) {
+        splicingIn_ = false;
+        chunk_ = pipeBytes_;
+        count = 1;
+      } else if (remaining_ > 0) {
+        splicingIn_ = true;
+        chunk_ = static_cast<std::uint32_t>(
+            std::min<std::size_t>(remaining_, pipe_.capacity_));
+        count = 2;
+      } else {
+        finish(0);
+        return;
+      }
+
+      auto populateSqe = [this](io_uring_sqe & sqe, std::uint32_t index) noexcept {
+        if (index == 0 && splicingIn_) {
+          populate_splice(
+              sqe,
+              file_->sqe_fd(),
+              file_->sqe_flags() != 0,
+              offset_,
+              pipe_.writer_.get(),
+              0,
+              -1,
+              chunk_);
+          sqe.flags |= IOSQE_IO_LINK;
+          sqe.user_data = reinterpret_cast<std::uintptr_t>(
+              static_cast<completion_base*>(&in_));
         } else {
-          UNIFEX_TRY {
-            unifex::set_value(std::move(self.receiver_), ssize_t(self.result_));
-          } UNIFEX_CATCH (...) {
-            unifex::set_error(std::move(self.receiver_), std::current_exception());
-          }
+          populate_splice(
+              sqe,
+              pipe_.reader_.get(),
+              false,
+              -1,
+              socket_->sqe_fd(),
+              socket_->sqe_flags(),
+              -1,
+              chunk_);
+          sqe.user_data = reinterpret_cast<std::uintptr_t>(
+              static_cast<completion_base*>(&out_));
+        }
+      };
+
+      if (context_.try_submit_io_chain(count, populateSqe)) {
+        outstandingCount_ = count;
+      } else {
+        this->execute_ = &operation::on_step;
+        context_.schedule_pending_io(this);
+      }
+    }
+
+    static void on_splice_complete(operation_base* op) noexcept {
+      auto& self = static_cast<splice_completion*>(op)->op_;
+      if (--self.outstandingCount_ == 0) {
+        self.on_chunk_complete();
+      }
+    }
+
+    void on_chunk_complete() noexcept {
+      bool shortRead = false;
+      if (splicingIn_) {
+        const int result = in_.result_;
+        if (result < 0) {
+          finish(result);
+          return;
+        }
+        if (result == 0) {
+          // End of file.
+          remaining_ = 0;
+        } else {
+          pipeBytes_ += result;
+          offset_ += result;
+          remaining_ -= result;
+        }
+        shortRead = static_cast<std::uint32_t>(result) != chunk_;
+      }
+
+      const int result = out_.result_;
+      if (result == -ECANCELED && shortRead) {
+        // The short read broke the link. Drain what it did read.
+      } else if (result < 0) {
+        finish(result);
+        return;
+      } else {
+        pipeBytes_ -= result;
+        sent_ += result;
+      }
+
+      step();
+    }
+
+    void finish(int result) noexcept {
+      result_ = result;
+      if (pipe_.reader_.valid()) {
+        if (pipeBytes_ == 0) {
+          context_.release_pipe(std::move(pipe_));
+        } else {
+          // Data left in the pipe would end up in the next send.
+          pipe_ = pooled_pipe{};
+        }
+      }
+      complete();
+    }
+
+    void complete() noexcept {
+      if (this->ready_to_deliver()) {
+        deliver();
+      }
+    }
+
+    void deliver() noexcept {
+      if (this->cancel_requested() && is_interrupted_result(result_)) {
+        result_ = -ECANCELED;
+      }
+      if (result_ >= 0) {
+        UNIFEX_TRY {
+          unifex::set_value(std::move(receiver_), sent_);
+        } UNIFEX_CATCH (...) {
+          unifex::set_error(std::move(receiver_), std::current_exception());
         }
-      } else if (self.result_ == -ECANCELED) {
-        unifex::set_done(std::move(self.receiver_));
+      } else if (result_ == -ECANCELED) {
+        unifex::set_done(std::move(receiver_));
       } else {
         unifex::set_error(
-            std::move(self.receiver_),
-            std::error_code{-self.result_, std::system_category()});
+            std::move(receiver_),
+            std::error_code{-result_, std::system_category()});
       }
     }
 
+    bool cancel_io() noexcept {
+      if (outstandingCount_ == 0) {
+        // Not started yet or waiting for space in the submission queue.
+        // step() will see the stop request when it gets to run.
+        return true;
+      }
+
+      auto populateSqe = [this](io_uring_sqe & sqe, std::uint32_t index) noexcept {
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(static_cast<completion_base*>(
+            index == 0 && splicingIn_ ? &in_ : &out_));
+        sqe.user_data = context_.ignored_user_data();
+      };
+
+      if (context_.try_submit_io_chain(splicingIn_ ? 2 : 1, populateSqe)) {
+        return true;
+      }
+      context_.schedule_pending_io(this->cancel_operation());
+      return false;
+    }
+
+    struct splice_completion : completion_base {
+      explicit splice_completion(operation& op) noexcept : op_(op) {
+        this->execute_ = &operation::on_splice_complete;
+      }
+      operation& op_;
+    };
+
     io_uring_context& context_;
-    int fd_;
-    offset_t offset_;
-    iovec buffer_[1];
+    registered_fd* socket_;
+    registered_fd* file_;
+    std::int64_t offset_;
+    std::size_t remaining_;
     Receiver receiver_;
+
+    pooled_pipe pipe_;
+    // Bytes read into the pipe and not yet sent.
+    std::uint32_t pipeBytes_ = 0;
+    // Length of the splice(s) in flight.
+    std::uint32_t chunk_ = 0;
+    std::uint32_t outstandingCount_ = 0;
+    bool splicingIn_ = false;
+    ssize_t sent_ = 0;
+    int result_ = 0;
+    splice_completion in_{*this};
+    splice_completion out_{*this};
   };
 
  public:
-  // Produces number of bytes read.
+  // Produces the number of bytes sent.
   template <
       template <typename...> class Variant,
       template <typename...> class Tuple>
@@ -610,97 +3282,209 @@ class io_uring_context::write_sender {
 
   static constexpr bool sends_done = true;
 
-  explicit write_sender(
+  explicit sendfile_sender(
       io_uring_context& context,
-      int fd,
-      offset_t offset,
-      span<const std::byte> buffer) noexcept
-      : context_(context), fd_(fd), offset_(offset), buffer_(buffer) {}
+      registered_fd* socket,
+      registered_fd* file,
+      std::int64_t offset,
+      std::size_t length) noexcept
+      : context_(context),
+        socket_(socket),
+        file_(file),
+        offset_(offset),
+        length_(length) {}
 
   template <typename Receiver>
-  operation<remove_cvref_t<Receiver>> connect(Receiver&& r) {
+  operation<remove_cvref_t<Receiver>> connect(Receiver&& r) && {
     return operation<remove_cvref_t<Receiver>>{*this, (Receiver &&) r};
   }
 
  private:
   io_uring_context& context_;
-  int fd_;
-  offset_t offset_;
-  span<const std::byte> buffer_;
+  registered_fd* socket_;
+  registered_fd* file_;
+  std::int64_t offset_;
+  std::size_t length_;
 };
 
-class io_uring_context::async_read_only_file {
+// A connected stream socket.
+class io_uring_context::async_socket : public descriptor_base {
  public:
-  using offset_t = std::int64_t;
-
-  explicit async_read_only_file(io_uring_context& context, int fd) noexcept
-      : context_(context), fd_(fd) {}
+  explicit async_socket(io_uring_context& context, int fd) noexcept
+      : descriptor_base(context, fd) {}
 
  private:
-  friend scheduler;
-
-  friend read_sender tag_invoke(
-      tag_t<async_read_some_at>,
-      async_read_only_file& file,
-      offset_t offset,
+  friend op_sender<recv_op> tag_invoke(
+      tag_t<async_read_some>,
+      async_socket& socket,
       span<std::byte> buffer) noexcept {
-    return read_sender{file.context_, file.fd_.get(), offset, buffer};
+    return op_sender<recv_op>{
+        recv_op{socket.context_, &socket.fd_, {buffer.data(), buffer.size()}, {}}};
+  }
+
+  friend op_sender<send_op> tag_invoke(
+      tag_t<async_write_some>,
+      async_socket& socket,
+      span<const std::byte> buffer) noexcept {
+    return op_sender<send_op>{send_op{
+        socket.context_,
+        &socket.fd_,
+        {const_cast<std::byte*>(buffer.data()), buffer.size()},
+        {}}};
+  }
+
+  friend op_sender<receive_message_op> tag_invoke(
+      tag_t<async_receive_message>,
+      async_socket& socket,
+      msghdr& message) noexcept {
+    return op_sender<receive_message_op>{
+        receive_message_op{socket.context_, &socket.fd_, &message}};
+  }
+
+  friend op_sender<send_message_op> tag_invoke(
+      tag_t<async_send_message>,
+      async_socket& socket,
+      const msghdr& message) noexcept {
+    return op_sender<send_message_op>{
+        send_message_op{socket.context_, &socket.fd_, &message}};
+  }
+
+  friend op_sender<send_zero_copy_op> tag_invoke(
+      tag_t<async_send_zero_copy>,
+      async_socket& socket,
+      span<const std::byte> buffer) noexcept {
+    return op_sender<send_zero_copy_op>{send_zero_copy_op{
+        socket.context_,
+        &socket.fd_,
+        {const_cast<std::byte*>(buffer.data()), buffer.size()}}};
+  }
+
+  friend multishot_stream<receive_multishot_op> tag_invoke(
+      tag_t<async_receive_stream>,
+      async_socket& socket,
+      provided_buffer_pool& pool) {
+    return multishot_stream<receive_multishot_op>{
+        socket.context_, receive_multishot_op{&socket.fd_, &pool}};
+  }
+};
+
+inline io_uring_context::sendfile_sender tag_invoke(
+    tag_t<async_sendfile>,
+    io_uring_context::async_socket& socket,
+    io_uring_context::file_base& file,
+    std::int64_t offset,
+    std::size_t length) noexcept {
+  return io_uring_context::sendfile_sender{
+      socket.context_, &socket.fd_, &file.fd_, offset, length};
+}
+
+struct io_uring_context::accept_op {
+  static constexpr std::uint8_t opcode = IORING_OP_ACCEPT;
+  static constexpr bool cancellable = true;
+
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.accept_flags = SOCK_CLOEXEC;
+  }
+
+  async_socket complete(int result) noexcept {
+    return async_socket{context_, result};
+  }
+
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
   }
 
   io_uring_context& context_;
-  safe_file_descriptor fd_;
+  registered_fd* fd_;
 };
 
-class io_uring_context::async_write_only_file {
- public:
-  using offset_t = std::int64_t;
+struct io_uring_context::connect_op {
+  static constexpr std::uint8_t opcode = IORING_OP_CONNECT;
+  static constexpr bool cancellable = true;
 
-  explicit async_write_only_file(io_uring_context& context, int fd) noexcept
-      : context_(context), fd_(fd) {}
+  void populate(io_uring_sqe& sqe) noexcept {
+    sqe.opcode = opcode;
+    sqe.fd = socket_.get();
+    sqe.addr = reinterpret_cast<std::uintptr_t>(address_.data());
+    sqe.off = address_.size();
+  }
 
- private:
-  friend scheduler;
+  async_socket complete(int) noexcept {
+    return async_socket{context_, socket_.release()};
+  }
 
-  friend write_sender tag_invoke(
-      tag_t<async_write_some_at>,
-      async_write_only_file& file,
-      offset_t offset,
-      span<const std::byte> buffer) noexcept {
-    return write_sender{file.context_, file.fd_.get(), offset, buffer};
+  int fallback() noexcept {
+    return -EOPNOTSUPP;
   }
 
   io_uring_context& context_;
-  safe_file_descriptor fd_;
+  safe_file_descriptor socket_;
+  socket_address address_;
 };
 
-class io_uring_context::async_read_write_file {
- public:
-  using offset_t = std::int64_t;
+struct io_uring_context::accept_multishot_op {
+  void populate(io_uring_sqe& sqe, bool multishot) noexcept {
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.flags = fd_->sqe_flags();
+    sqe.fd = fd_->sqe_fd();
+    sqe.accept_flags = SOCK_CLOEXEC;
+    if (multishot) {
+      sqe.ioprio = IORING_ACCEPT_MULTISHOT;
+    }
+  }
 
-  explicit async_read_write_file(io_uring_context& context, int fd) noexcept
-      : context_(context), fd_(fd) {}
+  static multishot_retry
+  retry(int, std::uint32_t, operation_base*) noexcept {
+    return multishot_retry::none;
+  }
 
- private:
-  friend scheduler;
+  static bool cancel_wait(operation_base*) noexcept {
+    return true;
+  }
 
-  friend write_sender tag_invoke(
-      tag_t<async_write_some_at>,
-      async_read_write_file& file,
-      offset_t offset,
-      span<const std::byte> buffer) noexcept {
-    return write_sender{file.context_, file.fd_.get(), offset, buffer};
+  static bool is_end(int) noexcept {
+    return false;
   }
 
-  friend read_sender tag_invoke(
-      tag_t<async_read_some_at>,
-      async_read_write_file& file,
-      offset_t offset,
-      span<std::byte> buffer) noexcept {
-    return read_sender{file.context_, file.fd_.get(), offset, buffer};
+  async_socket complete(int result, std::uint32_t) noexcept {
+    return async_socket{context_, result};
+  }
+
+  static void discard(int result, std::uint32_t) noexcept {
+    if (result >= 0) {
+      ::close(result);
+    }
   }
 
   io_uring_context& context_;
-  safe_file_descriptor fd_;
+  registered_fd* fd_;
+};
+
+// A socket listening for incoming connections.
+class io_uring_context::async_listener : public descriptor_base {
+ public:
+  explicit async_listener(io_uring_context& context, int fd) noexcept
+      : descriptor_base(context, fd) {}
+
+  // The address the socket is bound to, including the port the kernel
+  // picked if it was bound to port zero.
+  socket_address local_address() const;
+
+ private:
+  friend op_sender<accept_op> tag_invoke(
+      tag_t<async_accept>, async_listener& listener) noexcept {
+    return op_sender<accept_op>{accept_op{listener.context_, &listener.fd_}};
+  }
+
+  friend multishot_stream<accept_multishot_op> tag_invoke(
+      tag_t<async_accept_stream>, async_listener& listener) {
+    return multishot_stream<accept_multishot_op>{
+        listener.context_,
+        accept_multishot_op{listener.context_, &listener.fd_}};
+  }
 };
 
 class io_uring_context::schedule_at_sender {
@@ -930,6 +3714,48 @@ class io_uring_context::scheduler {
       scheduler s,
       const filesystem::path& path);
 
+  friend std::pair<async_pipe_reader, async_pipe_writer> tag_invoke(
+      tag_t<open_pipe>, scheduler s);
+
+  friend async_listener tag_invoke(
+      tag_t<open_listening_socket>,
+      scheduler s,
+      const socket_address& address,
+      int backlog);
+  friend op_sender<connect_op> tag_invoke(
+      tag_t<async_connect>,
+      scheduler s,
+      const socket_address& address);
+
+  using async_open_read_only_op =
+      open_op<async_read_only_file, O_RDONLY | O_CLOEXEC>;
+  using async_open_read_write_op =
+      open_op<async_read_write_file, O_RDWR | O_CREAT | O_CLOEXEC>;
+  using async_open_write_only_op =
+      open_op<async_write_only_file, O_WRONLY | O_CREAT | O_CLOEXEC>;
+
+  friend op_sender<async_open_read_only_op> tag_invoke(
+      tag_t<async_open_file_read_only>,
+      scheduler s,
+      const filesystem::path& path) {
+    return op_sender<async_open_read_only_op>{
+        async_open_read_only_op{*s.context_, path}};
+  }
+  friend op_sender<async_open_read_write_op> tag_invoke(
+      tag_t<async_open_file_read_write>,
+      scheduler s,
+      const filesystem::path& path) {
+    return op_sender<async_open_read_write_op>{
+        async_open_read_write_op{*s.context_, path}};
+  }
+  friend op_sender<async_open_write_only_op> tag_invoke(
+      tag_t<async_open_file_write_only>,
+      scheduler s,
+      const filesystem::path& path) {
+    return op_sender<async_open_write_only_op>{
+        async_open_write_only_op{*s.context_, path}};
+  }
+
   friend bool operator==(scheduler a, scheduler b) noexcept {
     return a.context_ == b.context_;
   }
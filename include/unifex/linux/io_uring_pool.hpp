@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/config.hpp>
+#if !UNIFEX_NO_LIBURING
+
+#include <unifex/file_concepts.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/pipe_concepts.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/tag_invoke.hpp>
+#include <unifex/type_traits.hpp>
+#include <unifex/linux/io_uring_context.hpp>
+#include <unifex/linux/monotonic_clock.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <unifex/detail/prologue.hpp>
+
+namespace unifex {
+namespace linuxos {
+
+// Construction-time parameters for an io_uring_pool.
+struct io_uring_pool_options {
+  // Number of rings, each run by a thread of its own. Zero creates one ring
+  // per CPU that the process is allowed to run on.
+  std::uint32_t ringCount = 0;
+
+  // Options for every ring. attachTo is ignored, see shareWorkerPool.
+  io_uring_context_options ringOptions;
+
+  // Have the rings share the kernel async worker pool of the first ring
+  // (IORING_SETUP_ATTACH_WQ) instead of each creating its own.
+  bool shareWorkerPool = false;
+
+  // Pin the thread of ring i to the i'th CPU that the process is allowed to
+  // run on, wrapping around if there are more rings than CPUs.
+  bool pinThreads = true;
+};
+
+// A set of io_uring_contexts, each run by its own thread, behind a single
+// scheduler.
+//
+// The scheduler sends work started from one of the pool's threads to that
+// thread's ring, so continuations stay on the core they are running on and
+// never go through another ring's remote queue. Work started from any other
+// thread goes to the ring with the fewest operations in flight.
+//
+// Files and sockets belong to the ring that opened them, and all of their
+// I/O is submitted to that ring. Open them through get_ring_scheduler() to
+// choose the ring.
+class io_uring_pool {
+ public:
+  using options = io_uring_pool_options;
+
+  class scheduler;
+
+  io_uring_pool();
+
+  explicit io_uring_pool(const options& opts);
+
+  // Stops the rings and joins their threads. Outstanding operations must
+  // have completed.
+  ~io_uring_pool();
+
+  io_uring_pool(const io_uring_pool&) = delete;
+  io_uring_pool& operator=(const io_uring_pool&) = delete;
+
+  scheduler get_scheduler() noexcept;
+
+  std::uint32_t ring_count() const noexcept {
+    return static_cast<std::uint32_t>(rings_.size());
+  }
+
+  io_uring_context& ring(std::uint32_t index) noexcept {
+    return *rings_[index];
+  }
+
+  // A scheduler that always uses the given ring.
+  io_uring_context::scheduler get_ring_scheduler(std::uint32_t index) noexcept {
+    return rings_[index]->get_scheduler();
+  }
+
+ private:
+  // The ring of the calling thread if it is one of the pool's threads,
+  // otherwise the ring with the fewest operations in flight.
+  io_uring_context& pick_ring() noexcept;
+
+  std::vector<std::unique_ptr<io_uring_context>> rings_;
+  std::vector<std::thread> threads_;
+  inplace_stop_source stopSource_;
+
+  // Where pick_ring() starts looking, so that idle rings are used in turn.
+  std::atomic<std::uint32_t> nextRing_{0};
+};
+
+class io_uring_pool::scheduler {
+  // The CPOs that are forwarded to the scheduler of the picked ring.
+  template <typename CPO>
+  static constexpr bool is_ring_cpo_v = is_one_of_v<
+      CPO,
+      tag_t<open_file_read_only>,
+      tag_t<open_file_write_only>,
+      tag_t<open_file_read_write>,
+      tag_t<async_open_file_read_only>,
+      tag_t<async_open_file_write_only>,
+      tag_t<async_open_file_read_write>,
+      tag_t<open_pipe>,
+      tag_t<open_listening_socket>,
+      tag_t<async_connect>>;
+
+ public:
+  using time_point = monotonic_clock::time_point;
+
+  scheduler(const scheduler&) noexcept = default;
+  scheduler& operator=(const scheduler&) = default;
+  ~scheduler() = default;
+
+  io_uring_context::schedule_sender schedule() const noexcept {
+    return pick().schedule();
+  }
+
+  time_point now() const noexcept {
+    return monotonic_clock::now();
+  }
+
+  io_uring_context::schedule_at_sender schedule_at(
+      const time_point& dueTime) const noexcept {
+    return pick().schedule_at(dueTime);
+  }
+
+ private:
+  friend io_uring_pool;
+
+  template <
+      typename CPO,
+      typename... Args,
+      std::enable_if_t<is_ring_cpo_v<CPO>, int> = 0>
+  friend auto tag_invoke(CPO cpo, scheduler s, Args&&... args)
+      -> callable_result_t<CPO, io_uring_context::scheduler, Args...> {
+    return cpo(s.pick(), (Args &&) args...);
+  }
+
+  friend bool operator==(scheduler a, scheduler b) noexcept {
+    return a.pool_ == b.pool_;
+  }
+  friend bool operator!=(scheduler a, scheduler b) noexcept {
+    return a.pool_ != b.pool_;
+  }
+
+  explicit scheduler(io_uring_pool& pool) noexcept : pool_(&pool) {}
+
+  io_uring_context::scheduler pick() const noexcept {
+    return pool_->pick_ring().get_scheduler();
+  }
+
+  io_uring_pool* pool_;
+};
+
+inline io_uring_pool::scheduler io_uring_pool::get_scheduler() noexcept {
+  return scheduler{*this};
+}
+
+} // namespace linuxos
+} // namespace unifex
+
+#include <unifex/detail/epilogue.hpp>
+
+#endif // !UNIFEX_NO_LIBURING
@@ -52,6 +52,11 @@ class safe_file_descriptor {
 
   void close() noexcept;
 
+  // Give up ownership of the file descriptor without closing it.
+  int release() noexcept {
+    return std::exchange(fd_, -1);
+  }
+
  private:
   int fd_;
 };
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <unifex/detail/prologue.hpp>
+
+namespace unifex {
+namespace linuxos {
+
+// An IPv4, IPv6 or Unix domain socket address.
+class socket_address {
+ public:
+  socket_address() noexcept : length_(0) {
+    std::memset(&storage_, 0, sizeof(storage_));
+  }
+
+  socket_address(const sockaddr* address, socklen_t length) noexcept
+      : socket_address() {
+    if (length > sizeof(storage_)) {
+      length = sizeof(storage_);
+    }
+    std::memcpy(&storage_, address, length);
+    length_ = length;
+  }
+
+  // The IPv4 loopback address. A port of zero lets the kernel pick a free
+  // port when binding.
+  static socket_address ipv4_loopback(std::uint16_t port = 0) noexcept {
+    return ipv4(INADDR_LOOPBACK, port);
+  }
+
+  // The IPv4 wildcard address.
+  static socket_address ipv4_any(std::uint16_t port = 0) noexcept {
+    return ipv4(INADDR_ANY, port);
+  }
+
+  // The Unix domain socket address for the filesystem path 'path'. Paths
+  // too long for sockaddr_un are truncated.
+  static socket_address unix_domain(const char* path) noexcept {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    const std::size_t length =
+        strnlen(path, sizeof(address.sun_path) - 1);
+    std::memcpy(address.sun_path, path, length);
+    return socket_address{
+        reinterpret_cast<const sockaddr*>(&address),
+        static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + length + 1)};
+  }
+
+  const sockaddr* data() const noexcept {
+    return reinterpret_cast<const sockaddr*>(&storage_);
+  }
+
+  socklen_t size() const noexcept {
+    return length_;
+  }
+
+  int family() const noexcept {
+    return storage_.ss_family;
+  }
+
+  // The port of an IPv4 or IPv6 address.
+  std::uint16_t port() const noexcept {
+    if (family() == AF_INET6) {
+      return ntohs(reinterpret_cast<const sockaddr_in6&>(storage_).sin6_port);
+    }
+    return ntohs(reinterpret_cast<const sockaddr_in&>(storage_).sin_port);
+  }
+
+ private:
+  static socket_address ipv4(in_addr_t hostAddress, std::uint16_t port) noexcept {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(hostAddress);
+    return socket_address{
+        reinterpret_cast<const sockaddr*>(&address), sizeof(address)};
+  }
+
+  sockaddr_storage storage_;
+  socklen_t length_;
+};
+
+} // namespace linuxos
+} // namespace unifex
+
+#include <unifex/detail/epilogue.hpp>
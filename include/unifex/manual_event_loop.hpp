@@ -149,8 +149,29 @@ class context {
 
   void stop();
 
+  // While a submission_batch is alive, operations on this loop that are
+  // started on the constructing thread are collected and appended to the
+  // loop's queue under a single lock when the batch is destroyed.
+  class submission_batch {
+   public:
+    explicit submission_batch(context& loop) noexcept;
+    ~submission_batch();
+
+    submission_batch(const submission_batch&) = delete;
+    submission_batch& operator=(const submission_batch&) = delete;
+
+   private:
+    friend context;
+
+    context& loop_;
+    submission_batch* previous_;
+    task_base* head_ = nullptr;
+    task_base* tail_ = nullptr;
+  };
+
  private:
   void enqueue(task_base* task);
+  void enqueue_list(task_base* head, task_base* tail);
 
   std::mutex mutex_;
   std::condition_variable cv_;
@@ -19,6 +19,8 @@
 
 #include <unifex/io_concepts.hpp>
 
+#include <cstddef>
+
 #include <unifex/detail/prologue.hpp>
 
 namespace unifex {
@@ -35,9 +37,62 @@ inline const struct open_pipe_cpo {
     return unifex::tag_invoke(*this, (Executor &&) executor);
   }
 } open_pipe{};
+
+// Returns a sender that moves up to 'length' bytes from 'in' to 'out'
+// without copying them through userspace, and produces the number of bytes
+// moved. At least one of the two must be a pipe. An offset of -1 uses (and
+// advances) the descriptor's own position, and must be given for pipes and
+// sockets.
+inline const struct async_splice_cpo {
+  template <
+      typename Source,
+      typename SourceOffset,
+      typename Sink,
+      typename SinkOffset>
+  auto operator()(
+      Source& in,
+      SourceOffset inOffset,
+      Sink& out,
+      SinkOffset outOffset,
+      std::size_t length) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_splice_cpo,
+               Source&,
+               SourceOffset,
+               Sink&,
+               SinkOffset,
+               std::size_t>)
+          -> tag_invoke_result_t<
+              async_splice_cpo,
+              Source&,
+              SourceOffset,
+              Sink&,
+              SinkOffset,
+              std::size_t> {
+    return unifex::tag_invoke(*this, in, inOffset, out, outOffset, length);
+  }
+} async_splice{};
+
+// Returns a sender that duplicates up to 'length' bytes from one pipe into
+// another without consuming them from 'in', and produces the number of
+// bytes duplicated.
+inline const struct async_tee_cpo {
+  template <typename Source, typename Sink>
+  auto operator()(Source& in, Sink& out, std::size_t length) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_tee_cpo,
+               Source&,
+               Sink&,
+               std::size_t>)
+          -> tag_invoke_result_t<async_tee_cpo, Source&, Sink&, std::size_t> {
+    return unifex::tag_invoke(*this, in, out, length);
+  }
+} async_tee{};
 } // namespace _pipe_cpo
 
 using _pipe_cpo::open_pipe;
+using _pipe_cpo::async_splice;
+using _pipe_cpo::async_tee;
 } // namespace unifex
 
 #include <unifex/detail/epilogue.hpp>
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/tag_invoke.hpp>
+
+#include <unifex/io_concepts.hpp>
+
+#include <cstddef>
+
+#include <unifex/detail/prologue.hpp>
+
+// Stream sockets are read from and written to with the async_read_some()
+// and async_write_some() CPOs from io_concepts.hpp. The CPOs here cover
+// establishing connections and message-oriented I/O.
+
+namespace unifex {
+namespace _socket {
+// Create a socket bound to 'address' that listens for incoming connections.
+// Returns the listening socket.
+inline const struct open_listening_socket_cpo {
+  template <typename Scheduler, typename Address>
+  auto operator()(Scheduler&& s, const Address& address, int backlog) const
+      noexcept(is_nothrow_tag_invocable_v<
+               open_listening_socket_cpo,
+               Scheduler,
+               const Address&,
+               int>)
+          -> tag_invoke_result_t<
+              open_listening_socket_cpo,
+              Scheduler,
+              const Address&,
+              int> {
+    return unifex::tag_invoke(*this, (Scheduler &&) s, address, backlog);
+  }
+} open_listening_socket{};
+
+// Create a datagram socket bound to 'address'. Returns the socket.
+inline const struct open_datagram_socket_cpo {
+  template <typename Scheduler, typename Address>
+  auto operator()(Scheduler&& s, const Address& address) const
+      noexcept(is_nothrow_tag_invocable_v<
+               open_datagram_socket_cpo,
+               Scheduler,
+               const Address&>)
+          -> tag_invoke_result_t<
+              open_datagram_socket_cpo,
+              Scheduler,
+              const Address&> {
+    return unifex::tag_invoke(*this, (Scheduler &&) s, address);
+  }
+} open_datagram_socket{};
+
+// Returns a sender that accepts the next incoming connection on a listening
+// socket and produces the connected socket.
+inline const struct async_accept_cpo {
+  template <typename Listener>
+  auto operator()(Listener& listener) const
+      noexcept(is_nothrow_tag_invocable_v<async_accept_cpo, Listener&>)
+          -> tag_invoke_result_t<async_accept_cpo, Listener&> {
+    return unifex::tag_invoke(*this, listener);
+  }
+} async_accept{};
+
+// Returns a sender that connects a new socket to 'address' and produces the
+// connected socket.
+inline const struct async_connect_cpo {
+  template <typename Scheduler, typename Address>
+  auto operator()(Scheduler&& s, const Address& address) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_connect_cpo,
+               Scheduler,
+               const Address&>)
+          -> tag_invoke_result_t<async_connect_cpo, Scheduler, const Address&> {
+    return unifex::tag_invoke(*this, (Scheduler &&) s, address);
+  }
+} async_connect{};
+
+// Returns a sender that sends the message described by 'message' and
+// produces the number of bytes sent. The message and the buffers it refers
+// to must remain valid until the operation completes.
+inline const struct async_send_message_cpo {
+  template <typename Socket, typename Message>
+  auto operator()(Socket& socket, const Message& message) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_send_message_cpo,
+               Socket&,
+               const Message&>)
+          -> tag_invoke_result_t<
+              async_send_message_cpo,
+              Socket&,
+              const Message&> {
+    return unifex::tag_invoke(*this, socket, message);
+  }
+} async_send_message{};
+
+// Returns a sender that receives a message into the buffers described by
+// 'message' and produces the number of bytes received.
+inline const struct async_receive_message_cpo {
+  template <typename Socket, typename Message>
+  auto operator()(Socket& socket, Message& message) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_receive_message_cpo,
+               Socket&,
+               Message&>)
+          -> tag_invoke_result_t<async_receive_message_cpo, Socket&, Message&> {
+    return unifex::tag_invoke(*this, socket, message);
+  }
+} async_receive_message{};
+
+// Returns a stream of the sockets for incoming connections on a listening
+// socket. The stream's cleanup() stops accepting.
+inline const struct async_accept_stream_cpo {
+  template <typename Listener>
+  auto operator()(Listener& listener) const
+      noexcept(is_nothrow_tag_invocable_v<async_accept_stream_cpo, Listener&>)
+          -> tag_invoke_result_t<async_accept_stream_cpo, Listener&> {
+    return unifex::tag_invoke(*this, listener);
+  }
+} async_accept_stream{};
+
+// Returns a stream of the data received on a socket, each chunk held in a
+// buffer taken from 'pool'. The stream ends when the peer shuts down its
+// end of the connection.
+inline const struct async_receive_stream_cpo {
+  template <typename Socket, typename BufferPool>
+  auto operator()(Socket& socket, BufferPool& pool) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_receive_stream_cpo,
+               Socket&,
+               BufferPool&>)
+          -> tag_invoke_result_t<async_receive_stream_cpo, Socket&, BufferPool&> {
+    return unifex::tag_invoke(*this, socket, pool);
+  }
+} async_receive_stream{};
+
+// Returns a sender that sends up to 'length' bytes of 'file', starting at
+// 'offset', on a connected socket without copying them through userspace.
+// Produces the number of bytes sent, which is less than 'length' if the end
+// of the file is reached first.
+inline const struct async_sendfile_cpo {
+  template <typename Socket, typename File, typename Offset>
+  auto operator()(Socket& socket, File& file, Offset offset, std::size_t length)
+      const noexcept(is_nothrow_tag_invocable_v<
+                     async_sendfile_cpo,
+                     Socket&,
+                     File&,
+                     Offset,
+                     std::size_t>)
+          -> tag_invoke_result_t<
+              async_sendfile_cpo,
+              Socket&,
+              File&,
+              Offset,
+              std::size_t> {
+    return unifex::tag_invoke(*this, socket, file, offset, length);
+  }
+} async_sendfile{};
+
+// Like async_write_some(), but the kernel sends straight from 'buffer'
+// instead of copying it. The sender only completes once the kernel no
+// longer refers to the buffer, so it can be reused straight away.
+inline const struct async_send_zero_copy_cpo {
+  template <typename Socket, typename Buffer>
+  auto operator()(Socket& socket, Buffer&& buffer) const
+      noexcept(is_nothrow_tag_invocable_v<
+               async_send_zero_copy_cpo,
+               Socket&,
+               Buffer>)
+          -> tag_invoke_result_t<async_send_zero_copy_cpo, Socket&, Buffer> {
+    return unifex::tag_invoke(*this, socket, (Buffer &&) buffer);
+  }
+} async_send_zero_copy{};
+} // namespace _socket
+
+using _socket::open_listening_socket;
+using _socket::open_datagram_socket;
+using _socket::async_accept;
+using _socket::async_connect;
+using _socket::async_send_message;
+using _socket::async_receive_message;
+using _socket::async_accept_stream;
+using _socket::async_receive_stream;
+using _socket::async_sendfile;
+using _socket::async_send_zero_copy;
+} // namespace unifex
+
+#include <unifex/detail/epilogue.hpp>
@@ -15,8 +15,13 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <thread>
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
 #include <unifex/detail/prologue.hpp>
 
 namespace unifex {
@@ -27,7 +32,7 @@ class spin_wait {
 
   void wait() noexcept {
     if (count_++ < yield_threshold) {
-      // TODO: _mm_pause();
+      cpu_relax();
     } else {
       if (count_ == 0) {
         count_ = yield_threshold;
@@ -37,6 +42,16 @@ class spin_wait {
   }
 
  private:
+  static void cpu_relax() noexcept {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    _mm_pause();
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+  }
+
   static constexpr std::uint32_t yield_threshold = 20;
 
   std::uint32_t count_ = 0;
@@ -15,13 +15,26 @@
  */
 #pragma once
 
+#include <unifex/bulk_schedule.hpp>
+#include <unifex/execution_policy.hpp>
+#include <unifex/get_execution_policy.hpp>
+#include <unifex/get_priority.hpp>
 #include <unifex/get_stop_token.hpp>
+#include <unifex/manual_lifetime.hpp>
 #include <unifex/receiver_concepts.hpp>
 #include <unifex/scheduler_concepts.hpp>
 #include <unifex/sender_concepts.hpp>
 #include <unifex/stop_token_concepts.hpp>
 #include <unifex/detail/intrusive_queue.hpp>
+#include <unifex/detail/work_stealing_deque.hpp>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <thread>
 #include <type_traits>
 #include <vector>
@@ -33,11 +46,146 @@
 
 namespace unifex {
 namespace _static_thread_pool {
+  using clock_t = std::chrono::steady_clock;
+  using time_point = clock_t::time_point;
+
   struct task_base {
     task_base* next;
     void (*execute)(task_base*) noexcept;
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+    // When the task was handed to the workers.
+    time_point enqueueTime;
+#endif
   };
 
+  class context;
+
+  // A task that waits in one worker's timer list until it is due, and is
+  // then queued on that worker like any other task.
+  struct timer_base : task_base {
+    enum class state : std::uint8_t {
+      // Not in the timer list yet.
+      pending,
+      // In the timer list, waiting for its due time.
+      scheduled,
+      // Taken out of the timer list, either because it is due or because
+      // it was cancelled.
+      done
+    };
+
+    context* pool_ = nullptr;
+    timer_base* timerNext_ = nullptr;
+    timer_base* timerPrev_ = nullptr;
+    time_point dueTime_;
+    // Index of the worker whose timer list holds this timer.
+    std::uint32_t worker_ = 0;
+    // Protected by the worker's lock.
+    state state_ = state::pending;
+  };
+
+  class timer_cancel_callback {
+    timer_base* const timer_;
+  public:
+    explicit timer_cancel_callback(timer_base* timer) noexcept
+      : timer_(timer) {}
+
+    void operator()() noexcept;
+  };
+
+  // Selects how tasks are distributed among the worker threads.
+  enum class queue_policy {
+    // Each worker owns a mutex-protected FIFO queue. Tasks are pushed to the
+    // queues in round-robin order and a worker that runs out of work tries
+    // to pop from each of the other workers' queues in turn.
+    round_robin,
+
+    // Each worker owns a lock-free Chase-Lev deque in addition to its
+    // mutex-protected inbox. A worker moves tasks from its inbox into its
+    // deque and pops them from the LIFO end, while idle workers steal from
+    // the FIFO end of other workers' deques without taking any locks.
+    work_stealing
+  };
+
+  struct options {
+    // Number of worker threads to create.
+    // Zero selects the number of CPUs the process may use, that is
+    // std::thread::hardware_concurrency() limited by the cgroup CPU quota
+    // on Linux, or a single thread for an elastic pool.
+    std::uint32_t threadCount = 0;
+
+    // If greater than threadCount the pool is elastic: threadCount workers
+    // always run, and up to maxThreadCount - threadCount extra workers are
+    // started, one every growAfter, while all workers are busy and work is
+    // still queued. Extra workers exit after being idle for idleTimeout.
+    // Extra workers are not pinned and do not belong to any NUMA node.
+    // Zero, or a value not greater than threadCount, gives a fixed size pool.
+    std::uint32_t maxThreadCount = 0;
+    std::chrono::nanoseconds growAfter = std::chrono::milliseconds(1);
+    std::chrono::nanoseconds idleTimeout = std::chrono::seconds(10);
+
+    queue_policy queuePolicy = queue_policy::round_robin;
+
+    // When a worker schedules a task onto its own pool, keep the task in a
+    // per-worker "next task" slot and run it as soon as the current task
+    // returns, instead of queueing it behind older tasks. This keeps hot
+    // continuations on the same core. Tasks in the slot cannot be stolen.
+    bool lifoSlot = false;
+
+    // How long an idle worker keeps spinning, looking for new work, before
+    // it parks on its condition variable. Spinning avoids the cost of a
+    // futex wake-up on the producer side when work arrives in short
+    // intervals, at the cost of burning CPU while idle.
+    // Zero parks immediately.
+    std::chrono::nanoseconds spinDuration{0};
+
+    // CPUs to pin each worker thread to. Worker i is pinned to the CPUs in
+    // cpuSets[i % cpuSets.size()]. Empty leaves placement to the OS.
+    // Only supported on Linux, ignored elsewhere.
+    std::vector<std::vector<std::uint32_t>> cpuSets;
+
+    // Group the workers by NUMA node, as read from /sys/devices/system/node.
+    // Only the CPUs the process is allowed to run on count, and nodes with
+    // none of those are skipped. Workers are spread evenly across the
+    // remaining nodes and pinned to the allowed CPUs of their node, unless
+    // cpuSets is given in which case each worker belongs to the node of the
+    // first CPU in its set. Idle workers try to steal from workers on their
+    // own node before crossing to another node, and get_scheduler_for_node()
+    // schedules work onto a single node.
+    bool numaAware = false;
+  };
+
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+  // Counters summed over all workers, see context::snapshot().
+  struct stats {
+    // Tasks handed to the workers, including due timers, and tasks run.
+    std::uint64_t tasksEnqueued = 0;
+    std::uint64_t tasksExecuted = 0;
+    // Tasks a worker took from another worker's queue, deque or timer list.
+    std::uint64_t tasksStolen = 0;
+    // Non-blocking pushes that found the queue's lock busy.
+    std::uint64_t failedTryPushes = 0;
+    // Non-blocking pops and steals that did not get a task.
+    std::uint64_t failedTryPops = 0;
+    // Enqueues that had to block on a worker's lock because every
+    // non-blocking push failed.
+    std::uint64_t blockingPushes = 0;
+    // Number of times the workers parked, and the total time spent parked.
+    std::uint64_t parks = 0;
+    std::chrono::nanoseconds parkedTime{0};
+
+    // Time from a task being handed to the workers until it starts running.
+    // Bucket i counts the tasks that waited for [2^i, 2^(i+1)) nanoseconds,
+    // except that bucket 0 also counts 0ns and the last bucket is unbounded.
+    static constexpr std::size_t latency_bucket_count = 32;
+    std::array<std::uint64_t, latency_bucket_count> latencyHistogram{};
+
+    // Tasks that are queued or running.
+    std::uint64_t queue_depth() const noexcept {
+      return tasksEnqueued > tasksExecuted ? tasksEnqueued - tasksExecuted : 0;
+    }
+  };
+#endif
+
   template <typename Receiver>
   struct _op {
     class type;
@@ -45,17 +193,51 @@ namespace _static_thread_pool {
   template <typename Receiver>
   using operation = typename _op<remove_cvref_t<Receiver>>::type;
 
+  template <typename Integral, typename Receiver>
+  struct _bulk_op {
+    class type;
+  };
+  template <typename Integral, typename Receiver>
+  using bulk_operation =
+      typename _bulk_op<Integral, remove_cvref_t<Receiver>>::type;
+
+  template <typename Receiver>
+  struct _timer_op {
+    class type;
+  };
+  template <typename Receiver>
+  using timer_operation = typename _timer_op<remove_cvref_t<Receiver>>::type;
+
   class context {
     template <typename Receiver>
     friend struct _op;
+    template <typename Integral, typename Receiver>
+    friend struct _bulk_op;
+    template <typename Receiver>
+    friend struct _timer_op;
+    friend timer_cancel_callback;
+
+    using task_queue = intrusive_queue<task_base, &task_base::next>;
+
   public:
+    using options = _static_thread_pool::options;
+    using queue_policy = _static_thread_pool::queue_policy;
+    using clock_t = _static_thread_pool::clock_t;
+    using time_point = _static_thread_pool::time_point;
+
     context();
     context(std::uint32_t threadCount);
+    explicit context(const options& opts);
     ~context();
 
+    // Identifies a scheduler that may run work on any worker.
+    static constexpr std::uint32_t any_node = ~std::uint32_t(0);
+
     class scheduler {
       template <typename Receiver>
       friend struct _op;
+      template <typename Receiver>
+      friend struct _timer_op;
       class schedule_sender {
       public:
         template <
@@ -71,7 +253,7 @@ namespace _static_thread_pool {
       private:
         template <typename Receiver>
         operation<Receiver> make_operation_(Receiver&& r) const {
-          return operation<Receiver>{pool_, (Receiver &&) r};
+          return operation<Receiver>{pool_, node_, priority_, (Receiver &&) r};
         }
 
         template(typename Receiver)
@@ -83,14 +265,187 @@ namespace _static_thread_pool {
 
         friend class context::scheduler;
 
-        explicit schedule_sender(context& pool) noexcept
-          : pool_(pool) {}
+        explicit schedule_sender(
+            context& pool,
+            std::uint32_t node,
+            std::optional<priority> prio) noexcept
+          : pool_(pool)
+          , node_(node)
+          , priority_(prio) {}
 
         context& pool_;
+        std::uint32_t node_;
+        std::optional<priority> priority_;
+      };
+
+      // Splits the index space into one chunk per worker thread, when the
+      // receiver's execution policy allows for parallel execution, and runs
+      // the chunks concurrently.
+      template <typename Integral>
+      class bulk_schedule_sender {
+      public:
+        template <
+            template <typename...> class Variant,
+            template <typename...> class Tuple>
+        using value_types = Variant<Tuple<>>;
+
+        template <
+            template <typename...> class Variant,
+            template <typename...> class Tuple>
+        using next_types = Variant<Tuple<Integral>>;
+
+        template <template <typename...> class Variant>
+        using error_types = Variant<std::exception_ptr>;
+
+        static constexpr bool sends_done = true;
+
+      private:
+        template <typename Receiver>
+        bulk_operation<Integral, Receiver> make_operation_(Receiver&& r) const {
+          return bulk_operation<Integral, Receiver>{
+              pool_, node_, priority_, count_, (Receiver &&) r};
+        }
+
+        template(typename Receiver)
+          (requires receiver_of<Receiver> AND
+              is_next_receiver_v<Receiver, Integral>)
+        friend bulk_operation<Integral, Receiver>
+        tag_invoke(tag_t<connect>, bulk_schedule_sender s, Receiver&& r) {
+          return s.make_operation_((Receiver &&) r);
+        }
+
+        friend class context::scheduler;
+
+        explicit bulk_schedule_sender(
+            context& pool,
+            std::uint32_t node,
+            std::optional<priority> prio,
+            Integral count) noexcept
+          : pool_(pool)
+          , node_(node)
+          , priority_(prio)
+          , count_(std::move(count)) {}
+
+        context& pool_;
+        std::uint32_t node_;
+        std::optional<priority> priority_;
+        Integral count_;
+      };
+
+      // Completes on the pool once the due time is reached. The timer is
+      // kept by the worker that started the operation, or by the next
+      // worker in round-robin order when started from another thread, and
+      // runs on that worker unless it is busy and an idle worker takes it
+      // over. Timed work always runs at normal priority.
+      class schedule_at_sender {
+      public:
+        template <
+            template <typename...> class Variant,
+            template <typename...> class Tuple>
+        using value_types = Variant<Tuple<>>;
+
+        template <template <typename...> class Variant>
+        using error_types = Variant<>;
+
+        static constexpr bool sends_done = true;
+
+      private:
+        template <typename Receiver>
+        timer_operation<Receiver> make_operation_(Receiver&& r) const {
+          return timer_operation<Receiver>{
+              pool_, node_, dueTime_, std::nullopt, (Receiver &&) r};
+        }
+
+        template(typename Receiver)
+          (requires receiver_of<Receiver>)
+        friend timer_operation<Receiver>
+        tag_invoke(tag_t<connect>, schedule_at_sender s, Receiver&& r) {
+          return s.make_operation_((Receiver &&) r);
+        }
+
+        friend class context::scheduler;
+
+        explicit schedule_at_sender(
+            context& pool, std::uint32_t node, time_point dueTime) noexcept
+          : pool_(pool)
+          , node_(node)
+          , dueTime_(dueTime) {}
+
+        context& pool_;
+        std::uint32_t node_;
+        time_point dueTime_;
+      };
+
+      // Like schedule_at_sender, with the due time computed when the
+      // operation is started.
+      class schedule_after_sender {
+      public:
+        template <
+            template <typename...> class Variant,
+            template <typename...> class Tuple>
+        using value_types = Variant<Tuple<>>;
+
+        template <template <typename...> class Variant>
+        using error_types = Variant<>;
+
+        static constexpr bool sends_done = true;
+
+      private:
+        template <typename Receiver>
+        timer_operation<Receiver> make_operation_(Receiver&& r) const {
+          return timer_operation<Receiver>{
+              pool_, node_, time_point{}, delay_, (Receiver &&) r};
+        }
+
+        template(typename Receiver)
+          (requires receiver_of<Receiver>)
+        friend timer_operation<Receiver>
+        tag_invoke(tag_t<connect>, schedule_after_sender s, Receiver&& r) {
+          return s.make_operation_((Receiver &&) r);
+        }
+
+        friend class context::scheduler;
+
+        explicit schedule_after_sender(
+            context& pool, std::uint32_t node, clock_t::duration delay) noexcept
+          : pool_(pool)
+          , node_(node)
+          , delay_(delay) {}
+
+        context& pool_;
+        std::uint32_t node_;
+        clock_t::duration delay_;
       };
 
       schedule_sender make_sender_() const {
-        return schedule_sender{pool_};
+        return schedule_sender{pool_, node_, priority_};
+      }
+
+      schedule_at_sender make_at_sender_(time_point dueTime) const {
+        return schedule_at_sender{pool_, node_, dueTime};
+      }
+
+      schedule_after_sender make_after_sender_(clock_t::duration delay) const {
+        return schedule_after_sender{pool_, node_, delay};
+      }
+
+      friend schedule_at_sender tag_invoke(
+          tag_t<schedule_at>, const scheduler& s, time_point dueTime) noexcept {
+        return s.make_at_sender_(dueTime);
+      }
+
+      template <typename Rep, typename Ratio>
+      friend schedule_after_sender tag_invoke(
+          tag_t<schedule_after>,
+          const scheduler& s,
+          std::chrono::duration<Rep, Ratio> delay) noexcept {
+        // Round up so that the work never runs early.
+        return s.make_after_sender_(
+            std::chrono::ceil<clock_t::duration>(delay));
+      }
+
+      friend time_point tag_invoke(tag_t<now>, const scheduler&) noexcept {
+        return clock_t::now();
       }
 
       friend schedule_sender
@@ -98,49 +453,369 @@ namespace _static_thread_pool {
         return s.make_sender_();
       }
 
+      template <typename Integral>
+      bulk_schedule_sender<Integral> make_bulk_sender_(Integral count) const {
+        return bulk_schedule_sender<Integral>{
+            pool_, node_, priority_, std::move(count)};
+      }
+
+      template(typename Integral)
+        (requires std::is_integral_v<Integral>)
+      friend bulk_schedule_sender<Integral>
+      tag_invoke(tag_t<bulk_schedule>, const scheduler& s, Integral count) noexcept {
+        return s.make_bulk_sender_(std::move(count));
+      }
+
       friend class context;
-      explicit scheduler(context& pool) noexcept
-        : pool_(pool) {}
+      explicit scheduler(
+          context& pool,
+          std::uint32_t node,
+          std::optional<priority> prio) noexcept
+        : pool_(pool)
+        , node_(node)
+        , priority_(prio) {}
 
       friend bool operator==(scheduler a, scheduler b) noexcept {
-        return &a.pool_ == &b.pool_;
+        return &a.pool_ == &b.pool_ && a.node_ == b.node_ &&
+            a.priority_ == b.priority_;
       }
       friend bool operator!=(scheduler a, scheduler b) noexcept {
-        return &a.pool_ != &b.pool_;
+        return !(a == b);
       }
 
       context& pool_;
+      // Index into context::nodes_, or any_node.
+      std::uint32_t node_;
+      // If empty, the priority is taken from get_priority() of the receiver.
+      std::optional<priority> priority_;
     };
 
-    scheduler get_scheduler() noexcept { return scheduler{*this}; }
+    // Work scheduled through this scheduler runs at the priority returned by
+    // get_priority() on the receiver, which defaults to priority::normal.
+    scheduler get_scheduler() noexcept {
+      return scheduler{*this, any_node, std::nullopt};
+    }
+
+    // Work scheduled through this scheduler always runs at the given
+    // priority. Workers run high priority tasks before normal ones, and
+    // normal ones before background ones, but every so often they look at
+    // the lower priority lanes first so that these are not starved.
+    scheduler get_scheduler(priority prio) noexcept {
+      return scheduler{*this, any_node, prio};
+    }
+
+    // Returns a scheduler that only runs work on the workers placed on the
+    // given NUMA node. Throws std::invalid_argument if the pool has no
+    // workers on that node. A pool that is not NUMA-aware puts all of its
+    // workers on node 0.
+    scheduler get_scheduler_for_node(
+        std::uint32_t node, std::optional<priority> prio = std::nullopt);
+
+    // While a submission_batch is alive, operations on this pool that are
+    // started on the constructing thread are collected instead of being
+    // enqueued one at a time. They are handed to the workers when the batch
+    // is destroyed, taking each worker's lock once and waking at most one
+    // worker per task. e.g.
+    //
+    //   {
+    //     static_thread_pool::submission_batch batch{pool};
+    //     for (auto& item : items) {
+    //       scope.spawn_on(pool.get_scheduler(), process(item));
+    //     }
+    //   } // all items are submitted here
+    //
+    // None of the collected operations run until the batch is destroyed,
+    // so don't wait for them to complete inside the batch's lifetime.
+    class submission_batch {
+    public:
+      explicit submission_batch(context& pool);
+      ~submission_batch();
+
+      submission_batch(const submission_batch&) = delete;
+      submission_batch& operator=(const submission_batch&) = delete;
+
+    private:
+      friend class context;
+
+      context& pool_;
+      submission_batch* previous_;
+      // One queue per node and priority, the last ones for tasks that may
+      // run on any node.
+      std::vector<task_queue> tasks_;
+    };
 
     void request_stop() noexcept;
 
+    // Number of worker threads currently running. Only changes over time
+    // for an elastic pool.
+    std::uint32_t thread_count() const noexcept;
+
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+    using stats = _static_thread_pool::stats;
+
+    // Sums the counters of all workers. The counters are updated with
+    // relaxed atomics, so a snapshot taken while the pool is busy is not
+    // guaranteed to be consistent across counters.
+    // Only available when the library is built with
+    // UNIFEX_STATIC_THREAD_POOL_STATS enabled.
+    stats snapshot() const noexcept;
+#endif
+
   private:
+    // Maximum number of tasks held in each worker's work-stealing deque.
+    static constexpr std::size_t work_stealing_deque_capacity = 256;
+
+    // Maximum number of tasks a worker runs in a row from its "next task"
+    // slot before it goes back to its queue, so that a pair of tasks that
+    // keep rescheduling each other cannot starve the rest of the queue.
+    static constexpr std::uint32_t max_consecutive_next_tasks = 3;
+
+    // One lane per priority, indexed by the priority's value.
+    static constexpr std::size_t lane_count = 3;
+    static constexpr std::size_t normal_lane =
+        static_cast<std::size_t>(priority::normal);
+
+    // Every this many tasks a worker looks for work in its lanes starting
+    // from the lowest priority, so that a steady stream of higher priority
+    // work cannot starve lower priority work.
+    static constexpr std::uint32_t starvation_interval = 32;
+
+    // How long the timers of a busy worker must be overdue before an idle
+    // worker takes them over. Gives the owner the chance to run them itself
+    // once its current task finishes.
+    static constexpr std::chrono::microseconds timer_steal_grace{1000};
+
+    static std::size_t lane_of(priority prio) noexcept {
+      return static_cast<std::size_t>(prio);
+    }
+
+    // Per-worker counters, see stats. Updating them compiles to nothing
+    // unless UNIFEX_STATIC_THREAD_POOL_STATS is enabled.
+    enum class stat : std::uint8_t {
+      tasks_enqueued,
+      tasks_executed,
+      tasks_stolen,
+      failed_try_pushes,
+      failed_try_pops,
+      blocking_pushes,
+      parks,
+      parked_nanoseconds,
+      count
+    };
+
+    static void stamp([[maybe_unused]] task_base* task) noexcept {
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+      task->enqueueTime = clock_t::now();
+#endif
+    }
+
     class thread_state {
     public:
-      task_base* try_pop();
-      task_base* pop();
-      bool try_push(task_base* task);
-      void push(task_base* task);
+      task_base* try_pop(std::size_t lane);
+      // Like try_pop() but also reports whether more tasks are left.
+      task_base* try_steal(std::size_t lane, bool& hasMore);
+      // Blocks until a task is available, stop is requested, wake() is
+      // called or the deadline is reached, in which case timedOut is set.
+      // Due timers are queued while waiting. Returns the highest priority
+      // task available and its lane, or nullptr if no task was available.
+      task_base* pop(std::size_t& lane, time_point deadline, bool& timedOut);
+      // Whether any task is waiting in the worker's queues.
+      bool has_queued_work();
+      task_queue try_pop_all(std::size_t lane);
+      bool try_push(task_base* task, std::size_t lane);
+      void push(task_base* task, std::size_t lane);
+      void push_front(task_queue tasks, std::size_t lane);
+      void push_back(task_queue tasks, std::size_t lane);
+      void wake();
       void request_stop();
+      bool is_stop_requested();
+
+      void count([[maybe_unused]] stat s, [[maybe_unused]] std::uint64_t n = 1) noexcept {
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+        stats_[static_cast<std::size_t>(s)].fetch_add(n, std::memory_order_relaxed);
+#endif
+      }
+
+      // Counts a task that is about to run.
+      void count_start([[maybe_unused]] task_base* task) noexcept;
+
+      // Returns false if the timer was cancelled before it could be added.
+      bool add_timer(timer_base* timer);
+      // Returns true if the timer was still in the list.
+      bool remove_timer(timer_base* timer);
+      // Queues the timers that are due by 'now' in the normal lane.
+      void fire_due_timers(time_point now);
+      // Takes the timers that are due by 'now', unless the lock is busy.
+      task_queue try_take_due_timers(time_point now);
+
+      static constexpr std::int64_t no_timer_due =
+          std::numeric_limits<std::int64_t>::max();
+
+      // Due time of the first timer, in clock_t ticks since its epoch, or
+      // no_timer_due. Lets anyone check for due timers without locking.
+      std::atomic<std::int64_t> nextTimerDue_{no_timer_due};
+
+      // Set while the worker is about to park, or parked, in pop().
+      // Producers only notify the worker's condition variable while this is
+      // set.
+      std::atomic<bool> sleeping_{false};
+
+      // Only used with queue_policy::work_stealing.
+      // Pushed and popped by the owning worker, stolen by other workers.
+      work_stealing_deque<task_base, work_stealing_deque_capacity> deque_;
+
+      // Only accessed by the owning worker. See options::lifoSlot.
+      task_base* nextTask_ = nullptr;
+      std::uint32_t nextTaskRunCount_ = 0;
+
+      // Only accessed by the owning worker. See starvation_interval.
+      std::uint32_t tasksUntilLowPriorityTurn_ = starvation_interval;
+
+      // Index into context::nodes_ of the node this worker is placed on,
+      // or any_node for the extra workers of an elastic pool.
+      std::uint32_t node_ = 0;
+
+      // Only used for the extra workers of an elastic pool. Set while a
+      // thread is running this worker.
+      std::atomic<bool> active_{false};
+
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+      // Mostly updated by the owning worker, keep them away from the fields
+      // that other workers touch.
+      alignas(64) std::atomic<std::uint64_t>
+          stats_[static_cast<std::size_t>(stat::count)] = {};
+      std::atomic<std::uint64_t> latencyHistogram_[stats::latency_bucket_count] = {};
+#endif
+
+      // The other workers, in the order to look for work to steal.
+      // Workers on the same node come first.
+      std::vector<std::uint32_t> victims_;
 
     private:
+      // These must be called with mut_ held.
+      task_base* pop_highest_priority(std::size_t& lane);
+      task_queue take_due_timers(time_point now);
+      void unlink_timer(timer_base* timer);
+      void update_next_timer_due();
+
       std::mutex mut_;
       std::condition_variable cv_;
-      intrusive_queue<task_base, &task_base::next> queue_;
+      task_queue queues_[lane_count];
+      // Doubly-linked list in ascending order of due time.
+      timer_base* timersHead_ = nullptr;
+      timer_base* timersTail_ = nullptr;
       bool stopRequested_ = false;
+      bool wakeRequested_ = false;
+    };
+
+    struct numa_node {
+      // NUMA node number as reported by the OS.
+      std::uint32_t id = 0;
+      // Indices of the workers placed on this node.
+      std::vector<std::uint32_t> workers;
+      std::atomic<std::uint32_t> nextThread{0};
     };
 
+    // Assigns each worker to a NUMA node and computes its steal order.
+    // Returns the CPUs to pin each worker to.
+    std::vector<std::vector<std::uint32_t>> place_workers(const options& opts);
+
     void run(std::uint32_t index) noexcept;
     void join() noexcept;
 
-    void enqueue(task_base* task) noexcept;
+    bool is_elastic() const noexcept {
+      return maxThreadCount_ > threadCount_;
+    }
+
+    // Called whenever a worker may be missing: wakes up the supervisor of an
+    // elastic pool if all workers are busy.
+    void note_busy() noexcept;
+    // Body of the supervisor thread of an elastic pool, which starts extra
+    // workers while the pool stays saturated.
+    void supervise() noexcept;
+    bool is_saturated() noexcept;
+    void start_extra_worker();
 
+    task_base* try_pop_next_task(std::uint32_t index) noexcept;
+    task_base* try_pop_round_robin(std::uint32_t index, std::size_t lane) noexcept;
+    task_base* try_pop_work_stealing(std::uint32_t index) noexcept;
+    task_base* try_pop_lane(std::uint32_t index, std::size_t lane) noexcept;
+    task_base* try_pop_any(std::uint32_t index) noexcept;
+    task_base* spin_for_task(std::uint32_t index) noexcept;
+
+    // Picks the worker that keeps a timer for the given node.
+    std::uint32_t timer_worker(std::uint32_t node) noexcept;
+    void add_timer(timer_base* timer) noexcept;
+    void cancel_timer(timer_base* timer) noexcept;
+    void fire_due_timers(std::uint32_t index) noexcept;
+    // Takes over overdue timers from other workers that are too busy to run
+    // them.
+    task_base* steal_due_timers(std::uint32_t index) noexcept;
+    // When the earliest timer of a busy worker we may steal from becomes
+    // overdue enough to take over.
+    time_point next_peer_timer_due(std::uint32_t index) noexcept;
+    void wake_peer(std::uint32_t index) noexcept;
+
+    void enqueue(
+        task_base* task,
+        std::uint32_t node = any_node,
+        priority prio = priority::normal) noexcept;
+    void enqueue_local(
+        std::uint32_t index, task_base* task, std::size_t lane) noexcept;
+    // Hands a list of tasks to the workers that may run work for the given
+    // node, splitting it evenly between them.
+    void enqueue_batch(
+        task_queue tasks, std::uint32_t node, priority prio) noexcept;
+
+    // Number of workers that may run work for the given node.
+    std::uint32_t worker_count(std::uint32_t node) const noexcept {
+      return node == any_node
+          ? threadCount_
+          : static_cast<std::uint32_t>(nodes_[node].workers.size());
+    }
+
+    // Index of the i'th worker that may run work for the given node.
+    std::uint32_t worker_index(std::uint32_t node, std::uint32_t i) const noexcept {
+      return node == any_node ? i : nodes_[node].workers[i];
+    }
+
+    // Picks the position, in [0, worker_count(node)), of the next worker to
+    // hand work for the given node to.
+    std::uint32_t next_worker(std::uint32_t node) noexcept {
+      auto& counter = node == any_node ? nextThread_ : nodes_[node].nextThread;
+      return counter.fetch_add(1, std::memory_order_relaxed) % worker_count(node);
+    }
+
+    // Number of workers that always run. Work from outside the pool only
+    // goes to these; the extra workers of an elastic pool take it by
+    // stealing. Only an extra worker itself pushes to its own queues, when
+    // its tasks schedule more work or timers, and it retires only once they
+    // are empty.
     std::uint32_t threadCount_;
+    std::uint32_t maxThreadCount_;
+    std::chrono::nanoseconds growAfter_;
+    std::chrono::nanoseconds idleTimeout_;
+    queue_policy queuePolicy_;
+    bool lifoSlot_;
+    std::chrono::nanoseconds spinDuration_;
     std::vector<std::thread> threads_;
     std::vector<thread_state> threadStates_;
+    std::vector<numa_node> nodes_;
     std::atomic<std::uint32_t> nextThread_;
+    std::atomic<std::uint32_t> sleepingCount_{0};
+
+    // Number of tasks queued in each lane across all workers, used to skip
+    // looking at empty lanes. Not maintained for the normal lane.
+    std::atomic<std::uint32_t> laneTaskCounts_[lane_count] = {};
+
+    // Only used by elastic pools.
+    std::thread supervisor_;
+    std::mutex supervisorMut_;
+    std::condition_variable supervisorCv_;
+    bool supervisorStopRequested_ = false;
+    // Set when a producer or worker saw all workers busy, cleared by the
+    // supervisor once the pool is no longer saturated.
+    std::atomic<bool> busy_{false};
   };
 
   template <typename Receiver>
@@ -148,11 +823,19 @@ namespace _static_thread_pool {
     friend context::scheduler::schedule_sender;
 
     context& pool_;
+    std::uint32_t node_;
     Receiver receiver_;
+    priority priority_;
 
-    explicit type(context& pool, Receiver&& r)
+    explicit type(
+        context& pool,
+        std::uint32_t node,
+        std::optional<priority> prio,
+        Receiver&& r)
       : pool_(pool)
-      , receiver_((Receiver &&) r) {
+      , node_(node)
+      , receiver_((Receiver &&) r)
+      , priority_(prio ? *prio : get_priority(receiver_)) {
       this->execute = [](task_base* t) noexcept {
         auto& op = *static_cast<type*>(t);
         if constexpr (!is_stop_never_possible_v<
@@ -167,7 +850,7 @@ namespace _static_thread_pool {
     }
 
     void enqueue_(task_base* op) const {
-      pool_.enqueue(op);
+      pool_.enqueue(op, node_, priority_);
     }
 
     friend void tag_invoke(tag_t<start>, type& op) noexcept {
@@ -175,6 +858,232 @@ namespace _static_thread_pool {
     }
   };
 
+  template <typename Integral, typename Receiver>
+  class _bulk_op<Integral, Receiver>::type {
+    template <typename>
+    friend class context::scheduler::bulk_schedule_sender;
+
+    using policy_t = decltype(get_execution_policy(UNIFEX_DECLVAL(Receiver&)));
+
+    static constexpr bool is_parallel =
+        is_one_of_v<policy_t, parallel_policy, parallel_unsequenced_policy>;
+    static constexpr bool is_unsequenced =
+        is_one_of_v<policy_t, unsequenced_policy, parallel_unsequenced_policy>;
+
+    struct chunk_task : task_base {
+      type* op_;
+      Integral begin_;
+      Integral end_;
+    };
+
+    context& pool_;
+    std::uint32_t node_;
+    Receiver receiver_;
+    priority priority_;
+    std::uint32_t chunkCount_;
+    std::unique_ptr<chunk_task[]> chunks_;
+    std::atomic<std::uint32_t> remainingChunks_{0};
+    std::atomic<bool> stopped_{false};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+
+    explicit type(
+        context& pool,
+        std::uint32_t node,
+        std::optional<priority> prio,
+        Integral count,
+        Receiver&& r)
+      : pool_(pool)
+      , node_(node)
+      , receiver_((Receiver &&) r)
+      , priority_(prio ? *prio : get_priority(receiver_))
+      , chunkCount_(chunk_count(pool.worker_count(node), count))
+      , chunks_(std::make_unique<chunk_task[]>(chunkCount_)) {
+      // Spread any remainder over the first chunks.
+      const Integral total = count > Integral(0) ? count : Integral(0);
+      const Integral base = total / static_cast<Integral>(chunkCount_);
+      const Integral extra = total % static_cast<Integral>(chunkCount_);
+      Integral begin(0);
+      for (std::uint32_t i = 0; i < chunkCount_; ++i) {
+        const Integral size =
+            base + (static_cast<Integral>(i) < extra ? Integral(1) : Integral(0));
+        auto& chunk = chunks_[i];
+        chunk.execute = &execute_chunk;
+        chunk.op_ = this;
+        chunk.begin_ = begin;
+        chunk.end_ = static_cast<Integral>(begin + size);
+        begin = chunk.end_;
+      }
+    }
+
+    static std::uint32_t
+    chunk_count(std::uint32_t workerCount, Integral count) noexcept {
+      if constexpr (is_parallel) {
+        if (count > Integral(1)) {
+          using unsigned_t = std::make_unsigned_t<Integral>;
+          return static_cast<std::uint32_t>(std::min<std::uint64_t>(
+              workerCount,
+              static_cast<std::uint64_t>(static_cast<unsigned_t>(count))));
+        }
+      }
+      (void)workerCount;
+      (void)count;
+      return 1;
+    }
+
+    static void execute_chunk(task_base* t) noexcept {
+      auto& chunk = *static_cast<chunk_task*>(t);
+      type& op = *chunk.op_;
+      op.run_chunk(chunk.begin_, chunk.end_);
+      if (op.remainingChunks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        op.complete();
+      }
+    }
+
+    void run_chunk(Integral begin, Integral end) noexcept {
+      auto stopToken = get_stop_token(receiver_);
+      UNIFEX_TRY {
+        for (Integral subBegin = begin; subBegin < end;
+             subBegin += static_cast<Integral>(bulk_cancellation_chunk_size)) {
+          if constexpr (!is_stop_never_possible_v<decltype(stopToken)>) {
+            if (stopToken.stop_requested()) {
+              stopped_.store(true, std::memory_order_relaxed);
+              return;
+            }
+          }
+          if (failed_.load(std::memory_order_relaxed)) {
+            return;
+          }
+
+          const Integral subEnd = static_cast<Integral>(std::min(
+              end,
+              static_cast<Integral>(
+                  subBegin + static_cast<Integral>(bulk_cancellation_chunk_size))));
+          if constexpr (is_unsequenced) {
+UNIFEX_DIAGNOSTIC_PUSH
+
+            // Vectorisable version
+#if defined(__clang__)
+            #pragma clang diagnostic ignored "-Wpass-failed"
+            #pragma clang loop vectorize(enable) interleave(enable)
+#elif defined(__GNUC__)
+            #pragma GCC ivdep
+#elif defined(_MSC_VER)
+            #pragma loop(ivdep)
+#endif
+            for (Integral i(subBegin); i < subEnd; ++i) {
+              unifex::set_next(receiver_, Integral(i));
+            }
+
+UNIFEX_DIAGNOSTIC_POP
+          } else {
+            // Sequenced version
+            for (Integral i(subBegin); i < subEnd; ++i) {
+              unifex::set_next(receiver_, Integral(i));
+            }
+          }
+        }
+      } UNIFEX_CATCH (...) {
+        // Keep the first error and stop the other chunks early.
+        if (!failed_.exchange(true, std::memory_order_relaxed)) {
+          error_ = std::current_exception();
+        }
+      }
+    }
+
+    // Called on the thread that finished the last chunk.
+    void complete() noexcept {
+      if (failed_.load(std::memory_order_relaxed)) {
+        unifex::set_error((Receiver &&) receiver_, std::move(error_));
+      } else if (stopped_.load(std::memory_order_relaxed)) {
+        unifex::set_done((Receiver &&) receiver_);
+      } else if constexpr (is_nothrow_receiver_of_v<Receiver>) {
+        unifex::set_value((Receiver &&) receiver_);
+      } else {
+        UNIFEX_TRY {
+          unifex::set_value((Receiver &&) receiver_);
+        } UNIFEX_CATCH (...) {
+          unifex::set_error((Receiver &&) receiver_, std::current_exception());
+        }
+      }
+    }
+
+    void start_() noexcept {
+      // The operation may complete, and be destroyed, as soon as the last
+      // chunk is enqueued so don't touch 'this' after that.
+      remainingChunks_.store(chunkCount_, std::memory_order_relaxed);
+
+      if (chunkCount_ == 1) {
+        pool_.enqueue(&chunks_[0], node_, priority_);
+        return;
+      }
+
+      // There is at most one chunk per worker, so this puts each chunk on
+      // a different worker.
+      context::task_queue tasks;
+      for (std::uint32_t i = 0; i < chunkCount_; ++i) {
+        tasks.push_back(&chunks_[i]);
+      }
+      pool_.enqueue_batch(std::move(tasks), node_, priority_);
+    }
+
+    friend void tag_invoke(tag_t<start>, type& op) noexcept {
+      op.start_();
+    }
+  };
+
+  template <typename Receiver>
+  class _timer_op<Receiver>::type : timer_base {
+    friend context::scheduler::schedule_at_sender;
+    friend context::scheduler::schedule_after_sender;
+
+    std::uint32_t node_;
+    std::optional<clock_t::duration> delay_;
+    UNIFEX_NO_UNIQUE_ADDRESS Receiver receiver_;
+    UNIFEX_NO_UNIQUE_ADDRESS manual_lifetime<typename stop_token_type_t<
+        Receiver&>::template callback_type<timer_cancel_callback>>
+        cancelCallback_;
+
+    explicit type(
+        context& pool,
+        std::uint32_t node,
+        time_point dueTime,
+        std::optional<clock_t::duration> delay,
+        Receiver&& r)
+      : node_(node)
+      , delay_(delay)
+      , receiver_((Receiver &&) r) {
+      this->pool_ = &pool;
+      this->dueTime_ = dueTime;
+      this->execute = [](task_base* t) noexcept {
+        auto& op = *static_cast<type*>(t);
+        op.cancelCallback_.destruct();
+        if constexpr (!is_stop_never_possible_v<
+                          stop_token_type_t<Receiver>>) {
+          if (get_stop_token(op.receiver_).stop_requested()) {
+            unifex::set_done((Receiver &&) op.receiver_);
+            return;
+          }
+        }
+        unifex::set_value((Receiver &&) op.receiver_);
+      };
+    }
+
+    void start_() noexcept {
+      if (delay_) {
+        this->dueTime_ = clock_t::now() + *delay_;
+      }
+      this->worker_ = this->pool_->timer_worker(node_);
+      cancelCallback_.construct(
+          get_stop_token(receiver_), timer_cancel_callback{this});
+      this->pool_->add_timer(this);
+    }
+
+    friend void tag_invoke(tag_t<start>, type& op) noexcept {
+      op.start_();
+    }
+  };
+
 } // _static_thread_pool
 
 using static_thread_pool = _static_thread_pool::context;
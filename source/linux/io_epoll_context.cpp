@@ -22,11 +22,13 @@
 #include <unifex/scope_guard.hpp>
 #include <unifex/exception.hpp>
 
+#include <algorithm>
 #include <cstring>
 #include <system_error>
 #include <thread>
 
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <sys/uio.h>
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
@@ -66,9 +68,14 @@ static thread_local io_epoll_context* currentThreadContext;
 
 static constexpr void* remote_queue_event_user_data = nullptr;
 
-static constexpr std::uint32_t io_epoll_max_event_count = 256;
+// Events for sockets carry their socket_registration with this bit set, to
+// tell them apart from the operations that register themselves.
+static constexpr std::uintptr_t socket_user_data_tag = 1;
 
-io_epoll_context::io_epoll_context() {
+io_epoll_context::io_epoll_context() : io_epoll_context(options{}) {}
+
+io_epoll_context::io_epoll_context(const options& opts)
+  : events_(std::max(opts.maxEventsPerWait, 1u)) {
   {
     int fd = epoll_create(1);
     if (fd < 0) {
@@ -129,6 +136,22 @@ io_epoll_context::io_epoll_context() {
 }
 
 io_epoll_context::~io_epoll_context() {
+  // Sockets destroyed on another thread after run() returned leave their
+  // registrations queued for an I/O thread that no longer runs, so free
+  // them here.
+  (void)remoteQueue_.try_mark_active();
+  auto items = remoteQueue_.dequeue_all();
+  items.prepend(std::move(localQueue_));
+  while (!items.empty()) {
+    auto* item = items.pop_front();
+    if (item->execute_ == &socket_closer::on_closed) {
+      --item->enqueued_;
+      socket_closer::on_closed(item);
+    } else {
+      localQueue_.push_back(item);
+    }
+  }
+
   epoll_event event = {};
   (void)epoll_ctl(epollFd_.get(), EPOLL_CTL_DEL, remoteQueueEventFd_.get(), &event);
   (void)epoll_ctl(epollFd_.get(), EPOLL_CTL_DEL, timerFd_.get(), &event);
@@ -251,11 +274,10 @@ void io_epoll_context::acquire_completion_queue_items() {
 
   LOG("epoll_wait()");
 
-  epoll_event completions[io_epoll_max_event_count];
   int result = epoll_wait(
     epollFd_.get(),
-    completions,
-    io_epoll_max_event_count,
+    events_.data(),
+    static_cast<int>(events_.size()),
     localQueue_.empty() ? -1 : 0);
   if (result < 0) {
     int errorCode = errno;
@@ -268,7 +290,7 @@ void io_epoll_context::acquire_completion_queue_items() {
   operation_queue completionQueue;
 
   for (std::uint32_t i = 0; i < count; ++i) {
-    auto& completed = completions[i];
+    auto& completed = events_[i];
 
     if (completed.data.ptr == remote_queue_event_user_data) {
       LOG("got remote queue wakeup");
@@ -312,6 +334,30 @@ void io_epoll_context::acquire_completion_queue_items() {
       continue;
     }
 
+    const auto userData = reinterpret_cast<std::uintptr_t>(completed.data.ptr);
+    if ((userData & socket_user_data_tag) != 0) {
+      LOGX("socket event %i\n", completed.events);
+      auto& socket = *reinterpret_cast<socket_registration*>(
+          userData & ~socket_user_data_tag);
+
+      // Resume the operations waiting for this edge. Errors and hang-ups
+      // wake both, so that their syscalls report them.
+      auto wake = [&](completion_base*& waiter) noexcept {
+        if (auto* op = std::exchange(waiter, nullptr)) {
+          UNIFEX_ASSERT(op->enqueued_.load() == 0);
+          ++op->enqueued_;
+          completionQueue.push_back(op);
+        }
+      };
+      if ((completed.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0) {
+        wake(socket.reader_);
+      }
+      if ((completed.events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0) {
+        wake(socket.writer_);
+      }
+      continue;
+    }
+
     LOGX("completion event %i\n", completed.events);
     auto& completionState = *reinterpret_cast<completion_base*>(completed.data.ptr);
 
@@ -468,6 +514,232 @@ std::pair<io_epoll_context::async_reader, io_epoll_context::async_writer> tag_in
   return {io_epoll_context::async_reader{*scheduler.context_, fd[0]}, io_epoll_context::async_writer{*scheduler.context_, fd[1]}};
 }
 
+static int open_file(const filesystem::path& path, int flags) {
+  int result = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+  return result;
+}
+
+io_epoll_context::async_file tag_invoke(
+    tag_t<open_file_read_only>,
+    io_epoll_context::scheduler scheduler,
+    const filesystem::path& path) {
+  return io_epoll_context::async_file{
+      *scheduler.context_, open_file(path, O_RDONLY)};
+}
+
+io_epoll_context::async_file tag_invoke(
+    tag_t<open_file_write_only>,
+    io_epoll_context::scheduler scheduler,
+    const filesystem::path& path) {
+  return io_epoll_context::async_file{
+      *scheduler.context_, open_file(path, O_WRONLY | O_CREAT)};
+}
+
+io_epoll_context::async_file tag_invoke(
+    tag_t<open_file_read_write>,
+    io_epoll_context::scheduler scheduler,
+    const filesystem::path& path) {
+  return io_epoll_context::async_file{
+      *scheduler.context_, open_file(path, O_RDWR | O_CREAT)};
+}
+
+static ssize_t check_file_result(ssize_t result) {
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+  return result;
+}
+
+ssize_t io_epoll_context::async_file::read_some_at(
+    offset_t offset, span<std::byte> buffer) {
+  return check_file_result(
+      ::pread(fd_.get(), buffer.data(), buffer.size(), offset));
+}
+
+ssize_t io_epoll_context::async_file::write_some_at(
+    offset_t offset, span<const std::byte> buffer) {
+  return check_file_result(
+      ::pwrite(fd_.get(), buffer.data(), buffer.size(), offset));
+}
+
+void tag_invoke(tag_t<close_file>, io_epoll_context::async_file& file) {
+  // The descriptor is released even if close() fails, as retrying it could
+  // close one that has since been reused.
+  check_file_result(::close(file.fd_.release()));
+}
+
+void tag_invoke(tag_t<fsync_file>, io_epoll_context::async_file& file) {
+  check_file_result(::fsync(file.fd_.get()));
+}
+
+void tag_invoke(tag_t<fdatasync_file>, io_epoll_context::async_file& file) {
+  check_file_result(::fdatasync(file.fd_.get()));
+}
+
+void tag_invoke(
+    tag_t<fallocate_file>,
+    io_epoll_context::async_file& file,
+    io_epoll_context::async_file::offset_t offset,
+    io_epoll_context::async_file::offset_t length) {
+  check_file_result(::fallocate(file.fd_.get(), 0, offset, length));
+}
+
+struct statx tag_invoke(tag_t<statx_file>, io_epoll_context::async_file& file) {
+  struct statx buffer;
+  check_file_result(::statx(
+      file.fd_.get(), "", AT_EMPTY_PATH, STATX_BASIC_STATS, &buffer));
+  return buffer;
+}
+
+io_epoll_context::socket_handle io_epoll_context::register_socket(
+    int fd, std::uint32_t events) {
+  auto socket = std::make_unique<socket_registration>(
+      *this, safe_file_descriptor{fd});
+
+  epoll_event event = {};
+  event.events = events | EPOLLET;
+  event.data.ptr = reinterpret_cast<void*>(
+      reinterpret_cast<std::uintptr_t>(socket.get()) | socket_user_data_tag);
+  if (epoll_ctl(epollFd_.get(), EPOLL_CTL_ADD, fd, &event) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category(), "epoll_ctl EPOLL_CTL_ADD socket"});
+  }
+
+  return socket_handle{socket.release()};
+}
+
+void io_epoll_context::socket_closer::operator()(
+    socket_registration* socket) const noexcept {
+  UNIFEX_ASSERT(socket->reader_ == nullptr && socket->writer_ == nullptr);
+
+  // Closing the descriptor removes it from the epoll set.
+  socket->fd_.close();
+
+  auto& context = socket->context_;
+  if (context.is_running_on_io_thread()) {
+    delete socket;
+  } else {
+    socket->execute_ = &socket_closer::on_closed;
+    context.schedule_remote(socket);
+  }
+}
+
+void io_epoll_context::socket_closer::on_closed(operation_base* op) noexcept {
+  delete static_cast<socket_registration*>(op);
+}
+
+namespace {
+safe_file_descriptor open_socket(int family, int type) {
+  int result = ::socket(family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category(), "socket"});
+  }
+  return safe_file_descriptor{result};
+}
+
+socket_address local_address_of(int fd) {
+  sockaddr_storage address;
+  socklen_t length = sizeof(address);
+  if (getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category(), "getsockname"});
+  }
+  return socket_address{reinterpret_cast<const sockaddr*>(&address), length};
+}
+} // namespace
+
+socket_address io_epoll_context::async_socket::local_address() const {
+  return local_address_of(socket_->fd_.get());
+}
+
+socket_address io_epoll_context::async_listener::local_address() const {
+  return local_address_of(socket_->fd_.get());
+}
+
+ssize_t io_epoll_context::connect_op::perform() noexcept {
+  const int fd = socket_.socket_->fd_.get();
+  if (!connecting_) {
+    if (::connect(fd, address_.data(), address_.size()) == 0) {
+      return 0;
+    }
+    const int errorCode = errno;
+    if (errorCode != EINPROGRESS) {
+      return -errorCode;
+    }
+    connecting_ = true;
+    return -EAGAIN;
+  }
+
+  int errorCode = 0;
+  socklen_t length = sizeof(errorCode);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &errorCode, &length) < 0) {
+    return -errno;
+  }
+  if (errorCode != 0) {
+    return -errorCode;
+  }
+
+  // Writable without an error can also be the state the socket was in
+  // before connecting, so make sure it has a peer now.
+  sockaddr_storage peer;
+  socklen_t peerLength = sizeof(peer);
+  if (getpeername(fd, reinterpret_cast<sockaddr*>(&peer), &peerLength) < 0) {
+    return errno == ENOTCONN ? -EAGAIN : -errno;
+  }
+  return 0;
+}
+
+io_epoll_context::async_listener tag_invoke(
+    tag_t<open_listening_socket>,
+    io_epoll_context::scheduler scheduler,
+    const socket_address& address,
+    int backlog) {
+  safe_file_descriptor fd = open_socket(address.family(), SOCK_STREAM);
+
+  const int enable = 1;
+  if ((address.family() != AF_UNIX &&
+       setsockopt(fd.get(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0) ||
+      bind(fd.get(), address.data(), address.size()) < 0 ||
+      listen(fd.get(), backlog) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  return io_epoll_context::async_listener{*scheduler.context_, fd.release()};
+}
+
+io_epoll_context::socket_sender<io_epoll_context::connect_op> tag_invoke(
+    tag_t<async_connect>,
+    io_epoll_context::scheduler scheduler,
+    const socket_address& address) {
+  safe_file_descriptor fd = open_socket(address.family(), SOCK_STREAM);
+
+  return io_epoll_context::socket_sender<io_epoll_context::connect_op>{
+      io_epoll_context::connect_op{
+          io_epoll_context::async_socket{*scheduler.context_, fd.release()},
+          address}};
+}
+
+io_epoll_context::async_socket tag_invoke(
+    tag_t<open_datagram_socket>,
+    io_epoll_context::scheduler scheduler,
+    const socket_address& address) {
+  safe_file_descriptor fd = open_socket(address.family(), SOCK_DGRAM);
+
+  if (bind(fd.get(), address.data(), address.size()) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  return io_epoll_context::async_socket{*scheduler.context_, fd.release()};
+}
+
 } // namespace unifex::linuxos
 
 #endif // !UNIFEX_NO_EPOLL
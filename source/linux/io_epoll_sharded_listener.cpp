@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unifex/config.hpp>
+#if !UNIFEX_NO_EPOLL
+
+#include <unifex/linux/io_epoll_sharded_listener.hpp>
+
+#include <unifex/exception.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/linux/safe_file_descriptor.hpp>
+
+#include "thread_affinity.hpp"
+
+#include <algorithm>
+#include <system_error>
+
+#include <sys/socket.h>
+
+namespace unifex::linuxos {
+
+namespace {
+// A non-blocking socket listening on 'address' that shares the address with
+// the other shards' sockets.
+safe_file_descriptor open_shard_socket(
+    const socket_address& address, int backlog) {
+  int result = ::socket(
+      address.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category(), "socket"});
+  }
+  safe_file_descriptor fd{result};
+
+  const int enable = 1;
+  if (setsockopt(fd.get(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0 ||
+      setsockopt(fd.get(), SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0 ||
+      bind(fd.get(), address.data(), address.size()) < 0 ||
+      listen(fd.get(), backlog) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+  return fd;
+}
+} // namespace
+
+io_epoll_sharded_listener::io_epoll_sharded_listener(
+    const socket_address& address)
+  : io_epoll_sharded_listener(address, options{}) {}
+
+io_epoll_sharded_listener::io_epoll_sharded_listener(
+    const socket_address& address, const options& opts)
+  : localAddress_(address) {
+  const std::vector<std::uint32_t> cpus = allowed_cpus();
+  const std::uint32_t shardCount = opts.shardCount != 0
+      ? opts.shardCount
+      : std::max(static_cast<std::uint32_t>(cpus.size()), 1u);
+
+  contexts_.reserve(shardCount);
+  for (std::uint32_t i = 0; i < shardCount; ++i) {
+    contexts_.push_back(std::make_unique<io_epoll_context>(opts.contextOptions));
+  }
+
+  // Close whichever listeners were opened, then stop and join whichever
+  // threads were started, if any step fails. The contexts are still running
+  // when the listeners close so that they can release them.
+  scope_guard stopOnFailure = [this]() noexcept {
+    listeners_.clear();
+    stopSource_.request_stop();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  };
+
+  threads_.reserve(shardCount);
+  for (std::uint32_t i = 0; i < shardCount; ++i) {
+    std::vector<std::uint32_t> threadCpus;
+    if (opts.pinThreads && !cpus.empty()) {
+      threadCpus.push_back(cpus[i % cpus.size()]);
+    }
+    threads_.push_back(start_pinned_thread(
+        std::move(threadCpus),
+        [this, i] { contexts_[i]->run(stopSource_.get_token()); }));
+  }
+
+  // Binding the first shard picks the port if the address has port zero,
+  // and the others then bind to that port.
+  listeners_.reserve(shardCount);
+  for (std::uint32_t i = 0; i < shardCount; ++i) {
+    listeners_.emplace_back(
+        *contexts_[i], open_shard_socket(localAddress_, opts.backlog).release());
+    if (i == 0) {
+      localAddress_ = listeners_.front().local_address();
+    }
+  }
+
+  stopOnFailure.release();
+}
+
+io_epoll_sharded_listener::~io_epoll_sharded_listener() {
+  listeners_.clear();
+  stopSource_.request_stop();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+} // namespace unifex::linuxos
+
+#endif // !UNIFEX_NO_EPOLL
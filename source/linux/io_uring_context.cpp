@@ -25,7 +25,10 @@
 
 #include "io_uring_syscall.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
+#include <iterator>
 #include <system_error>
 
 #include <fcntl.h>
@@ -250,15 +253,134 @@ static thread_local io_uring_context* currentThreadContext;
 
 static constexpr __u64 remote_queue_event_user_data = 0;
 
-io_uring_context::io_uring_context() {
+// io_uring constants that are newer than the kernel headers we may be built
+// against.
+#ifndef IORING_SETUP_SQ_AFF
+#define IORING_SETUP_SQ_AFF (1U << 2)
+#endif
+#ifndef IORING_SETUP_CQSIZE
+#define IORING_SETUP_CQSIZE (1U << 3)
+#endif
+#ifndef IORING_SETUP_CLAMP
+#define IORING_SETUP_CLAMP (1U << 4)
+#endif
+#ifndef IORING_SETUP_ATTACH_WQ
+#define IORING_SETUP_ATTACH_WQ (1U << 5)
+#endif
+#ifndef IORING_SETUP_R_DISABLED
+#define IORING_SETUP_R_DISABLED (1U << 6)
+#endif
+#ifndef IORING_SETUP_SINGLE_ISSUER
+#define IORING_SETUP_SINGLE_ISSUER (1U << 12)
+#endif
+#ifndef IORING_SETUP_DEFER_TASKRUN
+#define IORING_SETUP_DEFER_TASKRUN (1U << 13)
+#endif
+#ifndef IORING_SQ_NEED_WAKEUP
+#define IORING_SQ_NEED_WAKEUP (1U << 0)
+#endif
+#ifndef IORING_ENTER_SQ_WAKEUP
+#define IORING_ENTER_SQ_WAKEUP (1U << 1)
+#endif
+#ifndef IORING_REGISTER_ENABLE_RINGS
+#define IORING_REGISTER_ENABLE_RINGS 12
+#endif
+
+io_uring_context::io_uring_context() : io_uring_context(options{}) {}
+
+io_uring_context::io_uring_context(const options& opts) {
+  std::uint32_t flags = 0;
+  if (opts.cqEntries != 0) {
+    flags |= IORING_SETUP_CQSIZE;
+  }
+  if (opts.clamp) {
+    flags |= IORING_SETUP_CLAMP;
+  }
+  if (opts.attachTo != nullptr) {
+    flags |= IORING_SETUP_ATTACH_WQ;
+  }
+  if (opts.singleIssuer || opts.deferTaskrun) {
+    // The ring is bound to the task that enables it, which should be the
+    // thread that calls run() rather than the one constructing the context.
+    flags |= IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_R_DISABLED;
+  }
+  if (opts.deferTaskrun) {
+    flags |= IORING_SETUP_DEFER_TASKRUN;
+  }
+  if (opts.sqPoll) {
+    flags |= IORING_SETUP_SQPOLL;
+    if (opts.sqPollCpu >= 0) {
+      flags |= IORING_SETUP_SQ_AFF;
+    }
+  }
+
+  // Older kernels reject unknown setup flags with EINVAL. These are all
+  // optimisations, so drop them one at a time, newest first, and retry.
+  // Without IORING_SETUP_CQSIZE the completion queue gets the default size,
+  // which cq_entry_count() reports.
+  static constexpr std::uint32_t optionalFlags[] = {
+      IORING_SETUP_DEFER_TASKRUN,
+      IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_R_DISABLED,
+      IORING_SETUP_ATTACH_WQ,
+      IORING_SETUP_CLAMP,
+      IORING_SETUP_SQ_AFF,
+      IORING_SETUP_SQPOLL,
+      IORING_SETUP_CQSIZE};
+
   io_uring_params params;
-  std::memset(&params, 0, sizeof(params));
+  int ret;
+  int errorCode = 0;
+  std::size_t nextOptional = 0;
+  while (true) {
+    std::memset(&params, 0, sizeof(params));
+    params.flags = flags;
+    if ((flags & IORING_SETUP_CQSIZE) != 0) {
+      params.cq_entries = opts.cqEntries;
+    }
+    if ((flags & IORING_SETUP_ATTACH_WQ) != 0) {
+      params.wq_fd = static_cast<__u32>(opts.attachTo->iouringFd_.get());
+    }
+    if ((flags & IORING_SETUP_SQPOLL) != 0) {
+      params.sq_thread_idle = static_cast<__u32>(opts.sqPollIdle.count());
+      if ((flags & IORING_SETUP_SQ_AFF) != 0) {
+        params.sq_thread_cpu = static_cast<__u32>(opts.sqPollCpu);
+      }
+    }
+
+    ret = io_uring_setup(opts.sqEntries, &params);
+    if (ret >= 0) {
+      break;
+    }
+
+    errorCode = errno;
+    if (errorCode == EPERM && (flags & IORING_SETUP_SQPOLL) != 0) {
+      // Before Linux 5.11 SQPOLL required CAP_SYS_ADMIN.
+      LOG("io_uring_setup() refused SQPOLL");
+      flags &= ~(IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF);
+      continue;
+    }
+    if (errorCode != EINVAL) {
+      break;
+    }
+
+    while (nextOptional < std::size(optionalFlags) &&
+           (flags & optionalFlags[nextOptional]) == 0) {
+      ++nextOptional;
+    }
+    if (nextOptional == std::size(optionalFlags)) {
+      break;
+    }
+
+    LOGX("io_uring_setup() rejected flags %#x\n", optionalFlags[nextOptional]);
+    flags &= ~optionalFlags[nextOptional++];
+  }
 
-  int ret = io_uring_setup(256, &params);
   if (ret < 0) {
-    throw_(std::system_error{-ret, std::system_category()});
+    throw_(std::system_error{errorCode, std::system_category()});
   }
   iouringFd_ = safe_file_descriptor{ret};
+  setupFlags_ = flags;
+  ringDisabled_ = (flags & IORING_SETUP_R_DISABLED) != 0;
 
   {
     auto cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
@@ -324,6 +446,7 @@ io_uring_context::io_uring_context() {
         reinterpret_cast<std::atomic<unsigned>*>(sqBlock + params.sq_off.head);
     sqTail_ =
         reinterpret_cast<std::atomic<unsigned>*>(sqBlock + params.sq_off.tail);
+    sqLocalTail_ = sqTail_->load(std::memory_order_relaxed);
     sqFlags_ =
         reinterpret_cast<std::atomic<unsigned>*>(sqBlock + params.sq_off.flags);
     sqDropped_ = reinterpret_cast<std::atomic<unsigned>*>(
@@ -359,10 +482,70 @@ io_uring_context::io_uring_context() {
     remoteQueueEventFd_ = safe_file_descriptor{fd};
   }
 
+  {
+    // Find out which opcodes the kernel supports. Probing was added in 5.6
+    // along with most of the file opcodes, so if it isn't available assume
+    // only the opcodes from before then are.
+    constexpr std::size_t maxOps = 256;
+    std::vector<std::byte> buffer(
+        sizeof(io_uring_probe) + maxOps * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+    int result = io_uring_register(
+        iouringFd_.get(), IORING_REGISTER_PROBE, probe, maxOps);
+    if (result == 0) {
+      for (std::size_t i = 0; i < probe->ops_len; ++i) {
+        if ((probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0) {
+          supportedOps_.set(probe->ops[i].op);
+        }
+      }
+    } else {
+      for (std::size_t op = 0; op < IORING_OP_FALLOCATE; ++op) {
+        supportedOps_.set(op);
+      }
+    }
+  }
+
+  if (opts.fixedFileCount > 0 &&
+      (setupFlags_ & IORING_SETUP_SINGLE_ISSUER) == 0) {
+    // Register a table of empty slots that files get installed into as they
+    // are opened. This is only an optimisation, so carry on without it if
+    // the kernel refuses (e.g. the count exceeds RLIMIT_NOFILE).
+    std::vector<int> fds(opts.fixedFileCount, -1);
+    int result = io_uring_register(
+        iouringFd_.get(),
+        IORING_REGISTER_FILES,
+        fds.data(),
+        static_cast<unsigned>(fds.size()));
+    if (result == 0) {
+      freeFixedFiles_.reserve(opts.fixedFileCount);
+      for (std::uint32_t i = opts.fixedFileCount; i > 0; --i) {
+        freeFixedFiles_.push_back(i - 1);
+      }
+    } else {
+      LOGX("registering fixed-file table failed with %i\n", errno);
+    }
+  }
+
   LOG("io_uring_context construction done");
 }
 
-io_uring_context::~io_uring_context() {}
+io_uring_context::~io_uring_context() {
+  // A provided_buffer_pool destroyed after run() returned leaves its storage
+  // to an operation that never gets to run, so free it here.
+  using provide_operation = provided_buffer_pool::provide_operation;
+  (void)remoteQueue_.try_mark_active();
+  auto items = remoteQueue_.dequeue_all();
+  items.prepend(std::move(localQueue_));
+  while (!items.empty()) {
+    auto* item = items.pop_front();
+    if (item->execute_ == &provide_operation::on_provide &&
+        static_cast<provide_operation*>(item)->retired_) {
+      delete static_cast<provide_operation*>(item);
+    } else {
+      localQueue_.push_back(item);
+    }
+  }
+}
 
 void io_uring_context::run_impl(const bool& shouldStop) {
   LOG("run loop started");
@@ -373,6 +556,17 @@ void io_uring_context::run_impl(const bool& shouldStop) {
     LOG("run loop exited");
   };
 
+  if (ringDisabled_) {
+    LOG("enabling ring on the I/O thread");
+    int result = io_uring_register(
+        iouringFd_.get(), IORING_REGISTER_ENABLE_RINGS, nullptr, 0);
+    if (result < 0) {
+      int errorCode = errno;
+      throw_(std::system_error{errorCode, std::system_category()});
+    }
+    ringDisabled_ = false;
+  }
+
   while (true) {
     // Dequeue and process local queue items (ready to run)
     execute_pending_local();
@@ -403,12 +597,25 @@ void io_uring_context::run_impl(const bool& shouldStop) {
       item->execute_(item);
     }
 
+    // Don't count the remote queue's POLL_ADD, which is always there when
+    // the context is idle.
+    const std::uint32_t inFlightCount =
+        pending_operation_count() - (remoteQueueReadSubmitted_ ? 1 : 0);
+    if (inFlightCount_.load(std::memory_order_relaxed) != inFlightCount) {
+      inFlightCount_.store(inFlightCount, std::memory_order_relaxed);
+    }
+
     if (localQueue_.empty() || sqUnflushedCount_ > 0) {
+      // Everything queued during this turn of the loop is published to the
+      // kernel with a single store of the tail.
+      publish_submissions();
+
       const bool isIdle = sqUnflushedCount_ == 0 && localQueue_.empty();
       if (isIdle) {
         if (!remoteQueueReadSubmitted_) {
           LOG("try_register_remote_queue_notification()");
           remoteQueueReadSubmitted_ = try_register_remote_queue_notification();
+          publish_submissions();
         }
       }
 
@@ -421,16 +628,41 @@ void io_uring_context::run_impl(const bool& shouldStop) {
         minCompletionCount = 1;
         flags = IORING_ENTER_GETEVENTS;
       }
+      if ((setupFlags_ & IORING_SETUP_DEFER_TASKRUN) != 0) {
+        // Completions are only posted when we ask for them, so always run
+        // the deferred task-work, even if we don't wait for any.
+        flags |= IORING_ENTER_GETEVENTS;
+      }
+
+      std::uint32_t submitCount = sqUnflushedCount_;
+      if ((setupFlags_ & IORING_SETUP_SQPOLL) != 0) {
+        // The kernel poller picks up entries as soon as the tail is
+        // published, so they are already submitted as far as we're
+        // concerned. Only enter the kernel if the poller went to sleep or
+        // we need to wait for completions.
+        if (submitCount > 0 && sq_poller_needs_wakeup()) {
+          LOG("waking SQ poller thread");
+          flags |= IORING_ENTER_SQ_WAKEUP;
+          count(stat::sq_poller_wakeups);
+        }
+        cqPendingCount_ += submitCount;
+        sqUnflushedCount_ = 0;
+        count(stat::sqes_submitted, submitCount);
+        submitCount = 0;
+        if (flags == 0) {
+          continue;
+        }
+      }
 
       LOGX(
           "io_uring_enter() - submit %u, wait for %i, pending %u\n",
-          sqUnflushedCount_,
+          submitCount,
           minCompletionCount,
           pending_operation_count());
 
       int result = io_uring_enter(
           iouringFd_.get(),
-          sqUnflushedCount_,
+          submitCount,
           minCompletionCount,
           flags,
           nullptr);
@@ -443,9 +675,204 @@ void io_uring_context::run_impl(const bool& shouldStop) {
 
       sqUnflushedCount_ -= result;
       cqPendingCount_ += result;
+      count(stat::enters);
+      count(stat::sqes_submitted, static_cast<std::uint32_t>(result));
+    }
+  }
+}
+
+void io_uring_context::register_buffers(span<const iovec> buffers) {
+  UNIFEX_ASSERT(registeredBuffers_.empty());
+  int result = io_uring_register(
+      iouringFd_.get(),
+      IORING_REGISTER_BUFFERS,
+      buffers.data(),
+      static_cast<unsigned>(buffers.size()));
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  registeredBuffers_.assign(buffers.begin(), buffers.end());
+  index_registered_buffers();
+}
+
+void io_uring_context::update_registered_buffers(
+    std::uint32_t firstIndex, span<const iovec> buffers) {
+  UNIFEX_ASSERT(firstIndex + buffers.size() <= registeredBuffers_.size());
+  io_uring_rsrc_update2 update;
+  std::memset(&update, 0, sizeof(update));
+  update.offset = firstIndex;
+  update.data = reinterpret_cast<std::uintptr_t>(buffers.data());
+  update.nr = static_cast<__u32>(buffers.size());
+
+  int result = io_uring_register(
+      iouringFd_.get(),
+      IORING_REGISTER_BUFFERS_UPDATE,
+      &update,
+      sizeof(update));
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  std::copy(
+      buffers.begin(),
+      buffers.end(),
+      registeredBuffers_.begin() + firstIndex);
+  index_registered_buffers();
+}
+
+void io_uring_context::unregister_buffers() {
+  if (registeredBuffers_.empty()) {
+    return;
+  }
+
+  int result = io_uring_register(
+      iouringFd_.get(), IORING_UNREGISTER_BUFFERS, nullptr, 0);
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  registeredBuffers_.clear();
+  registeredBufferIndex_.clear();
+}
+
+void io_uring_context::index_registered_buffers() {
+  registeredBufferIndex_.clear();
+  for (std::uint32_t i = 0; i < registeredBuffers_.size(); ++i) {
+    const iovec& buffer = registeredBuffers_[i];
+    if (buffer.iov_base != nullptr && buffer.iov_len > 0) {
+      const auto begin = reinterpret_cast<std::uintptr_t>(buffer.iov_base);
+      registeredBufferIndex_.push_back({begin, begin + buffer.iov_len, i});
     }
   }
+  std::sort(
+      registeredBufferIndex_.begin(),
+      registeredBufferIndex_.end(),
+      [](const registered_buffer& a, const registered_buffer& b) noexcept {
+        return a.begin_ < b.begin_;
+      });
+}
+
+int io_uring_context::install_file(int fd) noexcept {
+  std::lock_guard lock{fixedFilesMutex_};
+  if (freeFixedFiles_.empty()) {
+    return -1;
+  }
+
+  const std::uint32_t index = freeFixedFiles_.back();
+  io_uring_files_update update;
+  std::memset(&update, 0, sizeof(update));
+  update.offset = index;
+  update.fds = reinterpret_cast<std::uintptr_t>(&fd);
+  int result = io_uring_register(
+      iouringFd_.get(), IORING_REGISTER_FILES_UPDATE, &update, 1);
+  if (result < 0) {
+    LOGX("installing fixed file failed with %i\n", errno);
+    return -1;
+  }
+
+  freeFixedFiles_.pop_back();
+  return static_cast<int>(index);
+}
+
+void io_uring_context::remove_file(int index) noexcept {
+  UNIFEX_ASSERT(index >= 0);
+  std::lock_guard lock{fixedFilesMutex_};
+
+  // Operations that are still in flight keep their own reference to the
+  // file, so the slot can be reused straight away.
+  int fd = -1;
+  io_uring_files_update update;
+  std::memset(&update, 0, sizeof(update));
+  update.offset = static_cast<__u32>(index);
+  update.fds = reinterpret_cast<std::uintptr_t>(&fd);
+  int result = io_uring_register(
+      iouringFd_.get(), IORING_REGISTER_FILES_UPDATE, &update, 1);
+  if (result < 0) {
+    // The slot still holds the file, so don't hand it out again.
+    LOGX("removing fixed file failed with %i\n", errno);
+    return;
+  }
+
+  // Can't allocate; capacity was reserved for every slot up front.
+  freeFixedFiles_.push_back(static_cast<std::uint32_t>(index));
+}
+
+io_uring_context::registered_fd::registered_fd(
+    io_uring_context& context, int fd) noexcept
+  : context_(context), fd_(fd), fixedIndex_(context.install_file(fd)) {}
+
+io_uring_context::registered_fd::registered_fd(registered_fd&& other) noexcept
+  : context_(other.context_),
+    fd_(std::move(other.fd_)),
+    fixedIndex_(std::exchange(other.fixedIndex_, -1)) {}
+
+int io_uring_context::registered_fd::release() noexcept {
+  if (fixedIndex_ >= 0) {
+    context_.remove_file(std::exchange(fixedIndex_, -1));
+  }
+  return fd_.release();
+}
+
+io_uring_context::registered_fd::~registered_fd() {
+  if (fixedIndex_ >= 0) {
+    context_.remove_file(fixedIndex_);
+  }
+}
+
+int io_uring_context::find_registered_buffer(
+    const void* data, std::size_t size) const noexcept {
+  if (registeredBufferIndex_.empty()) {
+    return -1;
+  }
+
+  // Find the last buffer that starts at or before 'data'.
+  const auto begin = reinterpret_cast<std::uintptr_t>(data);
+  auto it = std::upper_bound(
+      registeredBufferIndex_.begin(),
+      registeredBufferIndex_.end(),
+      begin,
+      [](std::uintptr_t address, const registered_buffer& buffer) noexcept {
+        return address < buffer.begin_;
+      });
+  if (it == registeredBufferIndex_.begin()) {
+    return -1;
+  }
+  --it;
+
+  if (begin + size > it->end_) {
+    return -1;
+  }
+  return static_cast<int>(it->index_);
+}
+
+bool io_uring_context::sq_poller_needs_wakeup() const noexcept {
+  // The poller sets IORING_SQ_NEED_WAKEUP and then re-checks the tail before
+  // sleeping. This fence orders our tail store before the flag load so that
+  // at least one of us sees the other's write.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return (sqFlags_->load(std::memory_order_relaxed) & IORING_SQ_NEED_WAKEUP) !=
+      0;
+}
+
+#if UNIFEX_IO_URING_STATS
+io_uring_context::stats io_uring_context::snapshot() const noexcept {
+  const auto get = [this](stat s) {
+    return stats_[static_cast<std::size_t>(s)].load(std::memory_order_relaxed);
+  };
+
+  stats result;
+  result.enters = get(stat::enters);
+  result.sqesSubmitted = get(stat::sqes_submitted);
+  result.reaps = get(stat::reaps);
+  result.cqesReaped = get(stat::cqes_reaped);
+  result.sqPollerWakeups = get(stat::sq_poller_wakeups);
+  return result;
 }
+#endif
 
 bool io_uring_context::is_running_on_io_thread() const noexcept {
   return this == currentThreadContext;
@@ -518,23 +945,26 @@ void io_uring_context::execute_pending_local() noexcept {
 void io_uring_context::acquire_completion_queue_items() noexcept {
   // Use 'relaxed' load for the head since it should only ever
   // be modified by the current thread.
-  std::uint32_t cqHead = cqHead_->load(std::memory_order_relaxed);
+  const std::uint32_t cqFirst = cqHead_->load(std::memory_order_relaxed);
+  std::uint32_t cqHead = cqFirst;
   std::uint32_t cqTail = cqTail_->load(std::memory_order_acquire);
   LOGX("completion queue head = %u, tail = %u\n", cqHead, cqTail);
 
   if (cqHead != cqTail) {
     const auto mask = cqMask_;
-    const auto count = cqTail - cqHead;
-    UNIFEX_ASSERT(count <= cqEntryCount_);
+    UNIFEX_ASSERT(cqTail - cqHead <= cqEntryCount_);
 
-    operation_base head;
-
-    LOGX("got %u completions\n", count);
+    LOGX("got %u completions\n", cqTail - cqHead);
 
     operation_queue completionQueue;
 
-    for (std::uint32_t i = 0; i < count; ++i) {
-      auto& cqe = cqEntries_[(cqHead + i) & mask];
+    // Keep going until the queue is empty, picking up the completions that
+    // the kernel posts while we're processing the earlier ones, so that all
+    // of them are consumed by a single store of the head.
+    for (; cqHead != cqTail ||
+         cqHead != (cqTail = cqTail_->load(std::memory_order_acquire));
+         ++cqHead) {
+      auto& cqe = cqEntries_[cqHead & mask];
 
       if (cqe.user_data == remote_queue_event_user_data) {
         LOG("got remote queue wakeup");
@@ -583,6 +1013,20 @@ void io_uring_context::acquire_completion_queue_items() noexcept {
       } else if (cqe.user_data == remove_timer_user_data()) {
         // Ignore timer cancellation completion.
         continue;
+      } else if (cqe.user_data == ignored_user_data()) {
+        // Ignore the completion of a cancellation request. The cancelled
+        // operation gets its own completion.
+        continue;
+      } else if ((cqe.user_data & multishot_user_data_tag) != 0) {
+        auto* multishot = reinterpret_cast<multishot_base*>(
+            static_cast<std::uintptr_t>(cqe.user_data) &
+            ~multishot_user_data_tag);
+        if ((cqe.flags & IORING_CQE_F_MORE) != 0) {
+          // The operation is still submitted and will complete again.
+          ++cqPendingCount_;
+        }
+        multishot->onCompletion_(multishot, cqe.res, cqe.flags);
+        continue;
       }
 
       auto& completionState = *reinterpret_cast<completion_base*>(
@@ -598,8 +1042,10 @@ void io_uring_context::acquire_completion_queue_items() noexcept {
     schedule_local(std::move(completionQueue));
 
     // Mark those completion queue entries as consumed.
-    cqHead_->store(cqTail, std::memory_order_release);
-    cqPendingCount_ -= count;
+    cqHead_->store(cqHead, std::memory_order_release);
+    cqPendingCount_ -= cqHead - cqFirst;
+    count(stat::reaps);
+    count(stat::cqes_reaped, cqHead - cqFirst);
   }
 }
 
@@ -630,7 +1076,6 @@ bool io_uring_context::try_register_remote_queue_notification() noexcept {
     sqe.len = 0;
     sqe.poll_events = POLL_IN;
     sqe.user_data = remote_queue_event_user_data;
-    sqe.__pad2[0] = sqe.__pad2[1] = sqe.__pad2[2] = 0;
 
     return true;
   };
@@ -756,7 +1201,6 @@ bool io_uring_context::try_submit_timer_io(const time_point& dueTime) noexcept {
     sqe.rw_flags =
         1; // HACK: Should be 'sqe.timeout_flags = IORING_TIMEOUT_ABS'
     sqe.user_data = timer_user_data();
-    sqe.__pad2[0] = sqe.__pad2[1] = sqe.__pad2[2] = 0;
 
     time_.tv_sec = dueTime.seconds_part();
     time_.tv_nsec = dueTime.nanoseconds_part();
@@ -781,7 +1225,6 @@ bool io_uring_context::try_submit_timer_io_cancel() noexcept {
     sqe.len = 0;
     sqe.rw_flags = 0;
     sqe.user_data = remove_timer_user_data();
-    sqe.__pad2[0] = sqe.__pad2[1] = sqe.__pad2[2] = 0;
   };
 
   return try_submit_io(populateSqe);
@@ -826,6 +1269,366 @@ io_uring_context::async_read_write_file tag_invoke(
   return io_uring_context::async_read_write_file{*scheduler.context_, result};
 }
 
+std::pair<io_uring_context::async_pipe_reader, io_uring_context::async_pipe_writer>
+tag_invoke(tag_t<open_pipe>, io_uring_context::scheduler scheduler) {
+  int fd[2] = {};
+  if (::pipe2(fd, O_CLOEXEC) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category(), "pipe2"});
+  }
+
+  return {
+      io_uring_context::async_pipe_reader{*scheduler.context_, fd[0]},
+      io_uring_context::async_pipe_writer{*scheduler.context_, fd[1]}};
+}
+
+int io_uring_context::acquire_pipe(pooled_pipe& pipe) noexcept {
+  UNIFEX_ASSERT(is_running_on_io_thread());
+
+  if (!idlePipes_.empty()) {
+    pipe = std::move(idlePipes_.back());
+    idlePipes_.pop_back();
+    return 0;
+  }
+
+  int fd[2] = {};
+  if (::pipe2(fd, O_CLOEXEC) < 0) {
+    return -errno;
+  }
+  pipe.reader_ = safe_file_descriptor{fd[0]};
+  pipe.writer_ = safe_file_descriptor{fd[1]};
+
+  // Bigger pipes mean fewer round trips per send. Unprivileged processes
+  // can't go beyond /proc/sys/fs/pipe-max-size, so just keep whatever size
+  // the pipe ends up with.
+  (void)::fcntl(fd[1], F_SETPIPE_SZ, 1 << 20);
+  const int capacity = ::fcntl(fd[1], F_GETPIPE_SZ);
+  pipe.capacity_ = capacity > 0 ? static_cast<std::uint32_t>(capacity) : 4096;
+  return 0;
+}
+
+void io_uring_context::release_pipe(pooled_pipe pipe) noexcept {
+  UNIFEX_ASSERT(is_running_on_io_thread());
+
+  // Enough for a burst of concurrent sends without holding on to
+  // descriptors indefinitely.
+  constexpr std::size_t maxIdlePipes = 16;
+  if (idlePipes_.size() < maxIdlePipes) {
+    UNIFEX_TRY {
+      idlePipes_.push_back(std::move(pipe));
+    } UNIFEX_CATCH (...) {
+      // Just close the pipe.
+    }
+  }
+}
+
+io_uring_context::provided_buffer_pool::provided_buffer_pool(
+    io_uring_context& context, std::uint32_t count, std::uint32_t bufferSize)
+  : context_(context),
+    groupId_(context.nextBufferGroup_++),
+    count_(count),
+    bufferSize_(bufferSize),
+    provideOp_(std::make_unique<provide_operation>(
+        context, groupId_, count, bufferSize)),
+    held_(count, false) {
+  UNIFEX_ASSERT(count > 0 && count <= 32768 && (count & (count - 1)) == 0);
+
+  // The ring must be page-aligned.
+  const std::size_t ringSize = count * sizeof(io_uring_buf);
+  void* ring = mmap(
+      nullptr,
+      ringSize,
+      PROT_READ | PROT_WRITE,
+      MAP_ANONYMOUS | MAP_PRIVATE,
+      -1,
+      0);
+  if (ring == MAP_FAILED) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+  ringMmap_ = mmap_region{ring, ringSize};
+
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<std::uintptr_t>(ring);
+  reg.ring_entries = count;
+  reg.bgid = groupId_;
+  int result = io_uring_register(
+      context_.iouringFd_.get(), IORING_REGISTER_PBUF_RING, &reg, 1);
+  if (result == 0) {
+    usesRing_ = true;
+    ring_ = static_cast<io_uring_buf_ring*>(ring);
+  } else {
+    int errorCode = errno;
+    if (errorCode != EINVAL ||
+        !context_.is_op_supported(IORING_OP_PROVIDE_BUFFERS)) {
+      throw_(std::system_error{errorCode, std::system_category()});
+    }
+    // Buffer rings were added in 5.19.
+    ringMmap_ = mmap_region{};
+  }
+
+  for (std::uint32_t i = 0; i < count; ++i) {
+    recycle(static_cast<std::uint16_t>(i));
+  }
+}
+
+io_uring_context::provided_buffer_pool::~provided_buffer_pool() {
+  std::lock_guard lock{mutex_};
+  if (usesRing_) {
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.bgid = groupId_;
+    [[maybe_unused]] int result = io_uring_register(
+        context_.iouringFd_.get(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    UNIFEX_ASSERT(result == 0);
+    return;
+  }
+
+  // The kernel still refers to the buffers handed over with
+  // IORING_OP_PROVIDE_BUFFERS, and a provide may still be queued, so leave
+  // the storage to the operation. It removes the buffers from the group
+  // before a later pool can reuse the group id, or is freed along with the
+  // context if that no longer runs.
+  auto* op = provideOp_.release();
+  std::lock_guard provideLock{op->mutex_};
+  op->retired_ = true;
+  op->returned_.clear();
+  op->schedule();
+}
+
+bool io_uring_context::provided_buffer_pool::uses_buffer_ring() const noexcept {
+  std::lock_guard lock{mutex_};
+  return usesRing_;
+}
+
+void io_uring_context::provided_buffer_pool::claim(
+    std::uint16_t bufferId) noexcept {
+  std::lock_guard lock{mutex_};
+  UNIFEX_ASSERT(!held_[bufferId]);
+  held_[bufferId] = true;
+  ++heldCount_;
+  ringDelivered_ = ringDelivered_ || usesRing_;
+}
+
+void io_uring_context::provided_buffer_pool::recycle(
+    std::uint16_t bufferId) noexcept {
+  operation_queue waiting;
+  {
+    std::lock_guard lock{mutex_};
+    recycle_locked(bufferId);
+    waiting = std::exchange(waiting_, operation_queue{});
+  }
+
+  // Let the streams that ran out of buffers receive again.
+  if (context_.is_running_on_io_thread()) {
+    context_.schedule_local(std::move(waiting));
+  } else {
+    while (!waiting.empty()) {
+      context_.schedule_remote(waiting.pop_front());
+    }
+  }
+}
+
+void io_uring_context::provided_buffer_pool::recycle_locked(
+    std::uint16_t bufferId) noexcept {
+  if (held_[bufferId]) {
+    held_[bufferId] = false;
+    --heldCount_;
+  }
+
+  if (usesRing_) {
+    auto& entry = ring_->bufs[tail_ & (count_ - 1)];
+    entry.addr = reinterpret_cast<std::uintptr_t>(buffer(bufferId));
+    entry.len = bufferSize_;
+    entry.bid = bufferId;
+    ++tail_;
+
+    // Publish the entry to the kernel, which reads the tail with acquire
+    // semantics.
+    reinterpret_cast<std::atomic<std::uint16_t>*>(&ring_->tail)
+        ->store(tail_, std::memory_order_release);
+  } else {
+    std::lock_guard provideLock{provideOp_->mutex_};
+    provideOp_->returned_.push_back(bufferId);
+    provideOp_->schedule();
+  }
+}
+
+bool io_uring_context::provided_buffer_pool::replenish(
+    operation_base* resume) noexcept {
+  std::lock_guard lock{mutex_};
+  if (heldCount_ == count_) {
+    waiting_.push_back(resume);
+    return false;
+  }
+  if (usesRing_ && !ringDelivered_) {
+    // The ring has buffers in it but the kernel has never picked one, so
+    // it isn't reading the ring.
+    switch_to_provide_buffers();
+  }
+  return true;
+}
+
+bool io_uring_context::provided_buffer_pool::cancel_wait(
+    operation_base* resume) noexcept {
+  std::lock_guard lock{mutex_};
+  bool found = false;
+  operation_queue others;
+  while (!waiting_.empty()) {
+    operation_base* op = waiting_.pop_front();
+    if (op == resume) {
+      found = true;
+    } else {
+      others.push_back(op);
+    }
+  }
+  waiting_ = std::move(others);
+  return found;
+}
+
+void io_uring_context::provided_buffer_pool::switch_to_provide_buffers() noexcept {
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.bgid = groupId_;
+  [[maybe_unused]] int result = io_uring_register(
+      context_.iouringFd_.get(), IORING_UNREGISTER_PBUF_RING, &reg, 1);
+  UNIFEX_ASSERT(result == 0);
+
+  usesRing_ = false;
+  ring_ = nullptr;
+  ringMmap_ = mmap_region{};
+  std::lock_guard provideLock{provideOp_->mutex_};
+  for (std::uint32_t i = 0; i < count_; ++i) {
+    if (!held_[i]) {
+      provideOp_->returned_.push_back(static_cast<std::uint16_t>(i));
+    }
+  }
+  provideOp_->schedule();
+}
+
+io_uring_context::provided_buffer_pool::provide_operation::provide_operation(
+    io_uring_context& context,
+    std::uint16_t groupId,
+    std::uint32_t count,
+    std::uint32_t bufferSize)
+  : context_(context),
+    groupId_(groupId),
+    count_(count),
+    bufferSize_(bufferSize),
+    storage_(new std::byte[std::size_t(count) * bufferSize]) {
+  this->execute_ = &provide_operation::on_provide;
+}
+
+void io_uring_context::provided_buffer_pool::provide_operation::
+    schedule() noexcept {
+  if (!queued_) {
+    queued_ = true;
+    if (context_.is_running_on_io_thread()) {
+      context_.schedule_local(this);
+    } else {
+      context_.schedule_remote(this);
+    }
+  }
+}
+
+void io_uring_context::provided_buffer_pool::provide_operation::on_provide(
+    operation_base* op) noexcept {
+  auto& self = *static_cast<provide_operation*>(op);
+  std::unique_lock lock{self.mutex_};
+  if (self.retired_) {
+    lock.unlock();
+    auto populateSqe = [&](io_uring_sqe & sqe) noexcept {
+      sqe.opcode = IORING_OP_REMOVE_BUFFERS;
+      sqe.fd = static_cast<std::int32_t>(self.count_);
+      sqe.buf_group = self.groupId_;
+      sqe.user_data = reinterpret_cast<std::uintptr_t>(&self);
+    };
+    self.execute_ = &provide_operation::on_removed;
+    if (!self.context_.try_submit_io(populateSqe)) {
+      self.execute_ = &provide_operation::on_provide;
+      self.context_.schedule_pending_io(&self);
+    }
+    return;
+  }
+
+  while (!self.returned_.empty()) {
+    const std::uint16_t bufferId = self.returned_.back();
+    auto populateSqe = [&](io_uring_sqe & sqe) noexcept {
+      sqe.opcode = IORING_OP_PROVIDE_BUFFERS;
+      sqe.fd = 1;
+      sqe.addr = reinterpret_cast<std::uintptr_t>(self.buffer(bufferId));
+      sqe.len = self.bufferSize_;
+      sqe.off = bufferId;
+      sqe.buf_group = self.groupId_;
+      sqe.user_data = self.context_.ignored_user_data();
+    };
+    if (!self.context_.try_submit_io(populateSqe)) {
+      self.context_.schedule_pending_io(&self);
+      return;
+    }
+    self.returned_.pop_back();
+  }
+  self.queued_ = false;
+}
+
+void io_uring_context::provided_buffer_pool::provide_operation::on_removed(
+    operation_base* op) noexcept {
+  // The kernel no longer refers to the storage. If it had none of the
+  // buffers, this fails with ENOENT, which is fine too.
+  delete static_cast<provide_operation*>(op);
+}
+
+socket_address io_uring_context::async_listener::local_address() const {
+  sockaddr_storage address;
+  socklen_t length = sizeof(address);
+  if (getsockname(
+          fd_.get(), reinterpret_cast<sockaddr*>(&address), &length) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+  return socket_address{reinterpret_cast<const sockaddr*>(&address), length};
+}
+
+io_uring_context::async_listener tag_invoke(
+    tag_t<open_listening_socket>,
+    io_uring_context::scheduler scheduler,
+    const socket_address& address,
+    int backlog) {
+  int result = ::socket(address.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+  safe_file_descriptor fd{result};
+
+  const int enable = 1;
+  if (setsockopt(fd.get(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) <
+          0 ||
+      bind(fd.get(), address.data(), address.size()) < 0 ||
+      listen(fd.get(), backlog) < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  return io_uring_context::async_listener{*scheduler.context_, fd.release()};
+}
+
+io_uring_context::op_sender<io_uring_context::connect_op> tag_invoke(
+    tag_t<async_connect>,
+    io_uring_context::scheduler scheduler,
+    const socket_address& address) {
+  int result = ::socket(address.family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (result < 0) {
+    int errorCode = errno;
+    throw_(std::system_error{errorCode, std::system_category()});
+  }
+
+  return io_uring_context::op_sender<io_uring_context::connect_op>{
+      io_uring_context::connect_op{
+          *scheduler.context_, safe_file_descriptor{result}, address}};
+}
+
 } // namespace unifex::linuxos
 
 #endif // UNIFEX_NO_LIBURING
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_LIBURING
+
+#include <unifex/linux/io_uring_pool.hpp>
+
+#include <unifex/scope_guard.hpp>
+
+#include "thread_affinity.hpp"
+
+#include <algorithm>
+
+namespace unifex::linuxos {
+
+namespace {
+// The pool whose ring the current thread runs, if any.
+thread_local const io_uring_pool* currentThreadPool = nullptr;
+thread_local std::uint32_t currentThreadRing = 0;
+} // namespace
+
+io_uring_pool::io_uring_pool() : io_uring_pool(options{}) {}
+
+io_uring_pool::io_uring_pool(const options& opts) {
+  const std::vector<std::uint32_t> cpus = allowed_cpus();
+  const std::uint32_t ringCount = opts.ringCount != 0
+      ? opts.ringCount
+      : std::max(static_cast<std::uint32_t>(cpus.size()), 1u);
+
+  rings_.reserve(ringCount);
+  for (std::uint32_t i = 0; i < ringCount; ++i) {
+    io_uring_context::options ringOptions = opts.ringOptions;
+    ringOptions.attachTo =
+        opts.shareWorkerPool && i > 0 ? rings_.front().get() : nullptr;
+    rings_.push_back(std::make_unique<io_uring_context>(ringOptions));
+  }
+
+  // Stop and join whichever threads were started if starting one of them
+  // fails.
+  scope_guard stopOnFailure = [this]() noexcept {
+    stopSource_.request_stop();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  };
+
+  threads_.reserve(ringCount);
+  for (std::uint32_t i = 0; i < ringCount; ++i) {
+    std::vector<std::uint32_t> threadCpus;
+    if (opts.pinThreads && !cpus.empty()) {
+      threadCpus.push_back(cpus[i % cpus.size()]);
+    }
+    threads_.push_back(start_pinned_thread(std::move(threadCpus), [this, i] {
+      currentThreadPool = this;
+      currentThreadRing = i;
+      rings_[i]->run(stopSource_.get_token());
+    }));
+  }
+
+  stopOnFailure.release();
+}
+
+io_uring_pool::~io_uring_pool() {
+  stopSource_.request_stop();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+io_uring_context& io_uring_pool::pick_ring() noexcept {
+  if (currentThreadPool == this) {
+    return *rings_[currentThreadRing];
+  }
+
+  const auto ringCount = static_cast<std::uint32_t>(rings_.size());
+  const std::uint32_t start =
+      nextRing_.fetch_add(1, std::memory_order_relaxed) % ringCount;
+  std::uint32_t best = start;
+  std::uint32_t bestCount = rings_[start]->in_flight_count();
+  for (std::uint32_t i = 1; i < ringCount && bestCount > 0; ++i) {
+    const std::uint32_t index = (start + i) % ringCount;
+    const std::uint32_t count = rings_[index]->in_flight_count();
+    if (count < bestCount) {
+      best = index;
+      bestCount = count;
+    }
+  }
+  return *rings_[best];
+}
+
+} // namespace unifex::linuxos
+
+#endif // !UNIFEX_NO_LIBURING
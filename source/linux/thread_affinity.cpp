@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread_affinity.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace unifex::linuxos {
+
+std::vector<std::uint32_t> allowed_cpus() {
+  // sched_getaffinity() fails with EINVAL while the set is smaller than the
+  // kernel's, so keep growing it.
+  constexpr std::size_t max_cpu_count = std::size_t{1} << 20;
+  for (std::size_t cpuCount = CPU_SETSIZE; cpuCount <= max_cpu_count;
+       cpuCount *= 2) {
+    cpu_set_t* cpuSet = CPU_ALLOC(cpuCount);
+    if (cpuSet == nullptr) {
+      break;
+    }
+    const std::size_t cpuSetSize = CPU_ALLOC_SIZE(cpuCount);
+    CPU_ZERO_S(cpuSetSize, cpuSet);
+    if (sched_getaffinity(0, cpuSetSize, cpuSet) == 0) {
+      std::vector<std::uint32_t> cpus;
+      for (std::uint32_t cpu = 0; cpu < cpuSetSize * 8; ++cpu) {
+        if (CPU_ISSET_S(cpu, cpuSetSize, cpuSet)) {
+          cpus.push_back(cpu);
+        }
+      }
+      CPU_FREE(cpuSet);
+      return cpus;
+    }
+    const int errorCode = errno;
+    CPU_FREE(cpuSet);
+    if (errorCode != EINVAL) {
+      break;
+    }
+  }
+  return {};
+}
+
+int pin_current_thread(const std::vector<std::uint32_t>& cpus) noexcept {
+  if (cpus.empty()) {
+    return 0;
+  }
+
+  const std::uint32_t cpuCount = *std::max_element(cpus.begin(), cpus.end()) + 1;
+  cpu_set_t* cpuSet = CPU_ALLOC(cpuCount);
+  if (cpuSet == nullptr) {
+    return ENOMEM;
+  }
+  const std::size_t cpuSetSize = CPU_ALLOC_SIZE(cpuCount);
+  CPU_ZERO_S(cpuSetSize, cpuSet);
+  for (std::uint32_t cpu : cpus) {
+    CPU_SET_S(cpu, cpuSetSize, cpuSet);
+  }
+  const int result = pthread_setaffinity_np(pthread_self(), cpuSetSize, cpuSet);
+  CPU_FREE(cpuSet);
+  return result;
+}
+
+} // namespace unifex::linuxos
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unifex/exception.hpp>
+
+#include <cstdint>
+#include <future>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace unifex::linuxos {
+
+// The CPUs that the process is allowed to run on, however many the machine
+// has.
+std::vector<std::uint32_t> allowed_cpus();
+
+// Restrict the calling thread to run on 'cpus' only. Does nothing if 'cpus'
+// is empty. Returns zero on success or the error code.
+int pin_current_thread(const std::vector<std::uint32_t>& cpus) noexcept;
+
+// Start a thread that restricts itself to 'cpus' before it calls 'f', so
+// that nothing 'f' does runs, or allocates memory, elsewhere. Waits until
+// the thread has done so and throws std::system_error if it failed, in
+// which case 'f' isn't called.
+template <typename F>
+std::thread start_pinned_thread(std::vector<std::uint32_t> cpus, F f) {
+  std::promise<int> pinned;
+  auto pinResult = pinned.get_future();
+  std::thread thread{[cpus = std::move(cpus),
+                      pinned = std::move(pinned),
+                      f = std::move(f)]() mutable {
+    const int result = pin_current_thread(cpus);
+    pinned.set_value(result);
+    if (result == 0) {
+      f();
+    }
+  }};
+
+  if (const int result = pinResult.get(); result != 0) {
+    thread.join();
+    throw_(std::system_error{result, std::system_category()});
+  }
+  return thread;
+}
+
+} // namespace unifex::linuxos
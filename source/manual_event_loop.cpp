@@ -15,9 +15,16 @@
  */
 #include <unifex/manual_event_loop.hpp>
 
+#include <utility>
+
 namespace unifex {
 namespace _manual_event_loop {
 
+namespace {
+// Innermost submission_batch alive on the current thread, if any.
+thread_local context::submission_batch* currentBatch = nullptr;
+} // namespace
+
 void context::run() {
   std::unique_lock lock{mutex_};
   while (true) {
@@ -25,13 +32,16 @@ void context::run() {
       if (stop_) return;
       cv_.wait(lock);
     }
-    auto* task = head_;
-    head_ = task->next_;
-    if (head_ == nullptr) {
-      tail_ = nullptr;
-    }
+    // Take all of the queued tasks at once to avoid locking per task.
+    auto* task = std::exchange(head_, nullptr);
+    tail_ = nullptr;
     lock.unlock();
-    task->execute();
+    while (task != nullptr) {
+      // The task may be destroyed by execute().
+      auto* next = task->next_;
+      task->execute();
+      task = next;
+    }
     lock.lock();
   }
 }
@@ -43,6 +53,19 @@ void context::stop() {
 }
 
 void context::enqueue(task_base* task) {
+  for (auto* batch = currentBatch; batch != nullptr; batch = batch->previous_) {
+    if (&batch->loop_ == this) {
+      if (batch->head_ == nullptr) {
+        batch->head_ = task;
+      } else {
+        batch->tail_->next_ = task;
+      }
+      batch->tail_ = task;
+      task->next_ = nullptr;
+      return;
+    }
+  }
+
   std::unique_lock lock{mutex_};
   if (head_ == nullptr) {
     head_ = task;
@@ -54,5 +77,29 @@ void context::enqueue(task_base* task) {
   cv_.notify_one();
 }
 
+void context::enqueue_list(task_base* head, task_base* tail) {
+  std::unique_lock lock{mutex_};
+  if (head_ == nullptr) {
+    head_ = head;
+  } else {
+    tail_->next_ = head;
+  }
+  tail_ = tail;
+  cv_.notify_one();
+}
+
+context::submission_batch::submission_batch(context& loop) noexcept
+  : loop_(loop)
+  , previous_(currentBatch) {
+  currentBatch = this;
+}
+
+context::submission_batch::~submission_batch() {
+  currentBatch = previous_;
+  if (head_ != nullptr) {
+    loop_.enqueue_list(head_, tail_);
+  }
+}
+
 } // _manual_event_loop
 } // unifex
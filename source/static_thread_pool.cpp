@@ -15,22 +15,212 @@
  */
 #include <unifex/static_thread_pool.hpp>
 
+#include <unifex/exception.hpp>
+#include <unifex/spin_wait.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(__linux__)
+#include "linux/thread_affinity.hpp"
+#endif
+
 namespace unifex {
 namespace _static_thread_pool {
+
+  namespace {
+    // Identifies the pool worker running on the current thread, if any.
+    struct current_worker {
+      const context* pool = nullptr;
+      std::uint32_t index = 0;
+    };
+
+    thread_local current_worker currentWorker;
+
+    // Innermost submission_batch alive on the current thread, if any.
+    thread_local context::submission_batch* currentBatch = nullptr;
+
+    struct numa_topology_node {
+      std::uint32_t id;
+      std::vector<std::uint32_t> cpus;
+    };
+
+    // Parses a list in the kernel's "0-3,8,10-11" format.
+    std::vector<std::uint32_t> parse_cpu_list(const std::string& text) {
+      std::vector<std::uint32_t> result;
+      std::size_t pos = 0;
+      while (pos < text.size()) {
+        std::size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+          end = text.size();
+        }
+        const std::string range = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        const std::size_t dash = range.find('-');
+        UNIFEX_TRY {
+          const auto first =
+              static_cast<std::uint32_t>(std::stoul(range.substr(0, dash)));
+          const auto last = dash == std::string::npos
+              ? first
+              : static_cast<std::uint32_t>(std::stoul(range.substr(dash + 1)));
+          for (std::uint32_t i = first; i <= last; ++i) {
+            result.push_back(i);
+          }
+        } UNIFEX_CATCH (const std::logic_error&) {
+          // Ignore empty or malformed entries, e.g. a trailing newline.
+        }
+      }
+      return result;
+    }
+
+    std::string read_first_line(const std::string& path) {
+      std::ifstream file{path};
+      std::string line;
+      std::getline(file, line);
+      return line;
+    }
+
+    // Returns the NUMA nodes that have CPUs the process is allowed to run
+    // on, with only those CPUs, or an empty list if the topology is not
+    // available.
+    std::vector<numa_topology_node> read_numa_topology() {
+      std::vector<numa_topology_node> nodes;
+#if defined(__linux__)
+      // A cpuset or container may exclude whole nodes, or some of a node's
+      // CPUs, and pinning a worker to those would fail.
+      const auto allowed = linuxos::allowed_cpus();
+      const std::string root = "/sys/devices/system/node/";
+      for (std::uint32_t id : parse_cpu_list(read_first_line(root + "online"))) {
+        auto cpus = parse_cpu_list(read_first_line(
+            root + "node" + std::to_string(id) + "/cpulist"));
+        cpus.erase(
+            std::remove_if(
+                cpus.begin(),
+                cpus.end(),
+                [&](std::uint32_t cpu) {
+                  return !std::binary_search(
+                      allowed.begin(), allowed.end(), cpu);
+                }),
+            cpus.end());
+        if (!cpus.empty()) {
+          nodes.push_back(numa_topology_node{id, std::move(cpus)});
+        }
+      }
+#endif
+      return nodes;
+    }
+
+    // Number of CPUs, rounded up, that a CFS quota of 'quota' microseconds
+    // of CPU time every 'period' microseconds amounts to, or zero if there
+    // is no quota.
+    std::uint32_t cpus_for_quota(
+        const std::string& quota, const std::string& period) {
+      UNIFEX_TRY {
+        const long long q = std::stoll(quota);
+        const long long p = std::stoll(period);
+        if (q > 0 && p > 0) {
+          return static_cast<std::uint32_t>((q + p - 1) / p);
+        }
+      } UNIFEX_CATCH (const std::logic_error&) {
+        // "max", or a missing or malformed file.
+      }
+      return 0;
+    }
+
+    // Returns the number of CPUs the cgroup CPU quota of the process allows
+    // for, or zero if there is no quota.
+    std::uint32_t read_cgroup_cpu_limit() {
+#if defined(__linux__)
+      // cgroup v2 - find our own cgroup, "0::<path>", falling back to the
+      // root which is what containers usually see.
+      std::string cgroupPath;
+      {
+        std::ifstream file{"/proc/self/cgroup"};
+        std::string line;
+        while (std::getline(file, line)) {
+          if (line.rfind("0::", 0) == 0) {
+            cgroupPath = line.substr(3);
+            break;
+          }
+        }
+      }
+      for (const std::string& path :
+           {"/sys/fs/cgroup" + cgroupPath + "/cpu.max",
+            std::string{"/sys/fs/cgroup/cpu.max"}}) {
+        // "<quota> <period>" or "max <period>".
+        std::istringstream line{read_first_line(path)};
+        std::string quota;
+        std::string period;
+        if (line >> quota >> period) {
+          return cpus_for_quota(quota, period);
+        }
+      }
+
+      // cgroup v1.
+      return cpus_for_quota(
+          read_first_line("/sys/fs/cgroup/cpu/cpu.cfs_quota_us"),
+          read_first_line("/sys/fs/cgroup/cpu/cpu.cfs_period_us"));
+#else
+      return 0;
+#endif
+    }
+
+    std::uint32_t default_thread_count() {
+      const std::uint32_t cpuCount =
+          std::max(std::thread::hardware_concurrency(), 1u);
+      const std::uint32_t cpuLimit = read_cgroup_cpu_limit();
+      return cpuLimit != 0 ? std::min(cpuCount, cpuLimit) : cpuCount;
+    }
+  } // namespace
+
   context::context()
-    : context(std::thread::hardware_concurrency()) {}
+    : context(options{}) {}
 
   context::context(std::uint32_t threadCount)
-    : threadCount_(threadCount)
-    , threadStates_(threadCount)
+    : context([&] {
+        options opts;
+        opts.threadCount = threadCount;
+        return opts;
+      }()) {}
+
+  context::context(const options& opts)
+    : threadCount_(
+          opts.threadCount != 0   ? opts.threadCount
+              : opts.maxThreadCount != 0 ? 1
+                                         : default_thread_count())
+    , maxThreadCount_(std::max(threadCount_, opts.maxThreadCount))
+    , growAfter_(opts.growAfter)
+    , idleTimeout_(opts.idleTimeout)
+    , queuePolicy_(opts.queuePolicy)
+    , lifoSlot_(opts.lifoSlot)
+    , spinDuration_(opts.spinDuration)
+    , threads_(maxThreadCount_)
+    , threadStates_(maxThreadCount_)
     , nextThread_(0) {
-    UNIFEX_ASSERT(threadCount > 0);
+    UNIFEX_ASSERT(threadCount_ > 0);
 
-    threads_.reserve(threadCount);
+    const auto workerCpus = place_workers(opts);
 
     UNIFEX_TRY {
-      for (std::uint32_t i = 0; i < threadCount; ++i) {
-        threads_.emplace_back([this, i] { run(i); });
+      for (std::uint32_t i = 0; i < threadCount_; ++i) {
+#if defined(__linux__)
+        // Each worker pins itself before it runs anything, so that its
+        // thread-locals and the memory its tasks allocate come from the
+        // node it is pinned to.
+        threads_[i] = linuxos::start_pinned_thread(
+            workerCpus[i], [this, i] { run(i); });
+#else
+        threads_[i] = std::thread{[this, i] { run(i); }};
+#endif
+      }
+      if (is_elastic()) {
+        supervisor_ = std::thread{[this] { supervise(); }};
       }
     } UNIFEX_CATCH (...) {
       request_stop();
@@ -39,6 +229,79 @@ namespace _static_thread_pool {
     }
   }
 
+  std::vector<std::vector<std::uint32_t>>
+  context::place_workers(const options& opts) {
+    std::vector<std::vector<std::uint32_t>> workerCpus(threadCount_);
+    if (!opts.cpuSets.empty()) {
+      for (std::uint32_t i = 0; i < threadCount_; ++i) {
+        workerCpus[i] = opts.cpuSets[i % opts.cpuSets.size()];
+      }
+    }
+
+    auto topology = opts.numaAware
+        ? read_numa_topology()
+        : std::vector<numa_topology_node>{};
+    if (topology.empty()) {
+      // Treat the machine as a single node.
+      topology.push_back(numa_topology_node{0, {}});
+    }
+
+    nodes_ = std::vector<numa_node>(topology.size());
+    for (std::size_t n = 0; n < topology.size(); ++n) {
+      nodes_[n].id = topology[n].id;
+    }
+
+    const auto nodeCount = static_cast<std::uint32_t>(topology.size());
+    for (std::uint32_t i = 0; i < threadCount_; ++i) {
+      std::uint32_t node = 0;
+      if (opts.cpuSets.empty()) {
+        // Spread the workers evenly, in contiguous blocks, over the nodes.
+        node = static_cast<std::uint32_t>(
+            std::uint64_t{i} * nodeCount / threadCount_);
+        workerCpus[i] = topology[node].cpus;
+      } else if (!workerCpus[i].empty()) {
+        for (std::uint32_t n = 0; n < nodeCount; ++n) {
+          const auto& cpus = topology[n].cpus;
+          if (std::find(cpus.begin(), cpus.end(), workerCpus[i].front()) !=
+              cpus.end()) {
+            node = n;
+            break;
+          }
+        }
+      }
+      threadStates_[i].node_ = node;
+      nodes_[node].workers.push_back(i);
+    }
+    for (std::uint32_t i = threadCount_; i < maxThreadCount_; ++i) {
+      threadStates_[i].node_ = any_node;
+    }
+
+    const std::uint32_t workerCount = maxThreadCount_;
+    for (std::uint32_t i = 0; i < workerCount; ++i) {
+      auto& victims = threadStates_[i].victims_;
+      victims.reserve(workerCount - 1);
+      for (std::uint32_t j = 1; j < workerCount; ++j) {
+        victims.push_back((i + j) < workerCount ? (i + j) : (i + j - workerCount));
+      }
+      std::stable_partition(
+          victims.begin(), victims.end(), [&](std::uint32_t victim) {
+            return threadStates_[victim].node_ == threadStates_[i].node_;
+          });
+    }
+
+    return workerCpus;
+  }
+
+  context::scheduler context::get_scheduler_for_node(
+      std::uint32_t node, std::optional<priority> prio) {
+    for (std::uint32_t n = 0; n < nodes_.size(); ++n) {
+      if (nodes_[n].id == node && !nodes_[n].workers.empty()) {
+        return scheduler{*this, n, prio};
+      }
+    }
+    throw_(std::invalid_argument{"static_thread_pool has no workers on node"});
+  }
+
   context::~context() {
     request_stop();
     join();
@@ -50,95 +313,879 @@ namespace _static_thread_pool {
     }
   }
 
+  std::uint32_t context::thread_count() const noexcept {
+    std::uint32_t count = threadCount_;
+    for (std::uint32_t i = threadCount_; i < maxThreadCount_; ++i) {
+      if (threadStates_[i].active_.load(std::memory_order_relaxed)) {
+        ++count;
+      }
+    }
+    return count;
+  }
+
   void context::run(std::uint32_t index) noexcept {
+    auto& state = threadStates_[index];
+    const bool extraWorker = index >= threadCount_;
+    currentWorker = current_worker{this, index};
+
+    // When an extra worker of an elastic pool retires if it stays idle.
+    auto retireAt = time_point::max();
+
     while (true) {
-      task_base* task = nullptr;
-      for (std::uint32_t i = 0; i < threadCount_; ++i) {
-        auto queueIndex = (index + i) < threadCount_
-            ? (index + i)
-            : (index + i - threadCount_);
-        auto& state = threadStates_[queueIndex];
-        task = state.try_pop();
-        if (task != nullptr) {
-          break;
-        }
+      task_base* task = try_pop_any(index);
+
+      if (task == nullptr) {
+        task = spin_for_task(index);
       }
 
       if (task == nullptr) {
-        task = threadStates_[index].pop();
+        // Advertise that we are about to park, then look for work once more.
+        // Any producer that published work before seeing the flag set is
+        // guaranteed to have its work seen by the re-check below.
+        state.sleeping_.store(true, std::memory_order_seq_cst);
+        sleepingCount_.fetch_add(1, std::memory_order_seq_cst);
+
+        bool timedOut = false;
+        task = try_pop_any(index);
         if (task == nullptr) {
-          // request_stop() was called.
-          return;
+          // Wake up in time to take over due timers from busy workers.
+          auto deadline = next_peer_timer_due(index);
+          if (extraWorker) {
+            if (retireAt == time_point::max()) {
+              retireAt = clock_t::now() + idleTimeout_;
+            }
+            deadline = std::min(deadline, retireAt);
+          }
+
+          std::size_t lane = normal_lane;
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+          const auto parkStart = clock_t::now();
+#endif
+          task = state.pop(lane, deadline, timedOut);
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+          state.count(stat::parks);
+          state.count(
+              stat::parked_nanoseconds,
+              static_cast<std::uint64_t>(
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      clock_t::now() - parkStart)
+                      .count()));
+#endif
+          if (task != nullptr && lane != normal_lane) {
+            laneTaskCounts_[lane].fetch_sub(1, std::memory_order_relaxed);
+          }
+        }
+
+        sleepingCount_.fetch_sub(1, std::memory_order_relaxed);
+        state.sleeping_.store(false, std::memory_order_relaxed);
+
+        if (task != nullptr &&
+            state.nextTimerDue_.load(std::memory_order_relaxed) !=
+                thread_state::no_timer_due) {
+          // Peers that parked while we did ignored our timers, make sure
+          // one of them is watching them now that we are busy again.
+          wake_peer(index);
+        }
+
+        if (task == nullptr) {
+          if (state.is_stop_requested()) {
+            // request_stop() was called.
+            return;
+          }
+          if (timedOut && clock_t::now() >= retireAt &&
+              state.nextTimerDue_.load(std::memory_order_relaxed) ==
+                  thread_state::no_timer_due) {
+            // We are an extra worker of an elastic pool that has not been
+            // needed for a while, retire. Only we add timers to our own
+            // list, so none can arrive after this check.
+            state.active_.store(false, std::memory_order_release);
+            return;
+          }
+          // Another worker woke us up because it has work to steal, or
+          // some timers are due.
+          continue;
         }
       }
 
+      retireAt = time_point::max();
+      note_busy();
+      state.count_start(task);
       task->execute(task);
     }
   }
 
+  task_base* context::try_pop_any(std::uint32_t index) noexcept {
+    auto& state = threadStates_[index];
+    fire_due_timers(index);
+
+    // Usually look at the lanes from high to background priority, but every
+    // starvation_interval tasks start from the lowest priority instead.
+    const bool lowPriorityTurn = state.tasksUntilLowPriorityTurn_ == 0;
+    for (std::size_t i = 0; i < lane_count; ++i) {
+      const std::size_t lane = lowPriorityTurn ? (lane_count - 1 - i) : i;
+      if (task_base* task = try_pop_lane(index, lane)) {
+        state.tasksUntilLowPriorityTurn_ = lowPriorityTurn
+            ? starvation_interval
+            : state.tasksUntilLowPriorityTurn_ - 1;
+        return task;
+      }
+    }
+    return steal_due_timers(index);
+  }
+
+  task_base* context::try_pop_lane(std::uint32_t index, std::size_t lane) noexcept {
+    if (lane != normal_lane) {
+      if (laneTaskCounts_[lane].load(std::memory_order_relaxed) == 0) {
+        // Nothing queued at this priority on any worker.
+        return nullptr;
+      }
+      task_base* task = try_pop_round_robin(index, lane);
+      if (task != nullptr) {
+        laneTaskCounts_[lane].fetch_sub(1, std::memory_order_relaxed);
+      }
+      return task;
+    }
+
+    if (task_base* task = try_pop_next_task(index)) {
+      return task;
+    }
+    threadStates_[index].nextTaskRunCount_ = 0;
+
+    return queuePolicy_ == queue_policy::work_stealing
+        ? try_pop_work_stealing(index)
+        : try_pop_round_robin(index, normal_lane);
+  }
+
+  task_base* context::spin_for_task(std::uint32_t index) noexcept {
+    if (spinDuration_.count() <= 0) {
+      return nullptr;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + spinDuration_;
+    spin_wait spin;
+    do {
+      spin.wait();
+      if (task_base* task = try_pop_any(index)) {
+        return task;
+      }
+    } while (std::chrono::steady_clock::now() < deadline);
+
+    return nullptr;
+  }
+
+  task_base* context::try_pop_next_task(std::uint32_t index) noexcept {
+    auto& state = threadStates_[index];
+    if (state.nextTask_ == nullptr) {
+      return nullptr;
+    }
+
+    if (state.nextTaskRunCount_ < max_consecutive_next_tasks) {
+      ++state.nextTaskRunCount_;
+      return std::exchange(state.nextTask_, nullptr);
+    }
+
+    // Give the tasks in the queue a turn, the next task goes to the back.
+    enqueue_local(index, std::exchange(state.nextTask_, nullptr), normal_lane);
+    return nullptr;
+  }
+
+  task_base* context::try_pop_round_robin(
+      std::uint32_t index, std::size_t lane) noexcept {
+    auto& state = threadStates_[index];
+    if (task_base* task = state.try_pop(lane)) {
+      return task;
+    }
+    state.count(stat::failed_try_pops);
+
+    for (std::uint32_t queueIndex : state.victims_) {
+      bool hasMore = false;
+      task_base* task = threadStates_[queueIndex].try_steal(lane, hasMore);
+      if (task == nullptr) {
+        state.count(stat::failed_try_pops);
+      } else {
+        state.count(stat::tasks_stolen);
+        if (hasMore) {
+          // There is more work queued on a busy worker, let another
+          // worker help out.
+          wake_peer(index);
+        }
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  task_base* context::try_pop_work_stealing(std::uint32_t index) noexcept {
+    auto& state = threadStates_[index];
+
+    // Newest tasks first from our own deque.
+    if (task_base* task = state.deque_.pop()) {
+      return task;
+    }
+
+    // Move the tasks that were enqueued by other threads into our deque so
+    // that idle workers can steal them without contending on our mutex.
+    auto tasks = state.try_pop_all(normal_lane);
+    if (!tasks.empty()) {
+      task_base* task = tasks.pop_front();
+      while (!tasks.empty()) {
+        task_base* next = tasks.pop_front();
+        if (!state.deque_.push(next)) {
+          // Deque is full, leave the rest in the inbox.
+          tasks.push_front(next);
+          state.push_front(std::move(tasks), normal_lane);
+          break;
+        }
+      }
+      if (!state.deque_.empty()) {
+        wake_peer(index);
+      }
+      return task;
+    }
+
+    // Steal the oldest task from another worker's deque.
+    for (std::uint32_t victimIndex : state.victims_) {
+      auto& victim = threadStates_[victimIndex];
+      if (task_base* task = victim.deque_.steal()) {
+        state.count(stat::tasks_stolen);
+        if (!victim.deque_.empty()) {
+          // There is more work to steal, let another worker help out.
+          wake_peer(index);
+        }
+        return task;
+      }
+      state.count(stat::failed_try_pops);
+    }
+
+    // Finally, try the inboxes of the other workers for tasks that they
+    // have not yet moved into their deques.
+    for (std::uint32_t victimIndex : state.victims_) {
+      if (task_base* task = threadStates_[victimIndex].try_pop(normal_lane)) {
+        state.count(stat::tasks_stolen);
+        return task;
+      }
+      state.count(stat::failed_try_pops);
+    }
+
+    return nullptr;
+  }
+
+  std::uint32_t context::timer_worker(std::uint32_t node) noexcept {
+    if (currentWorker.pool == this &&
+        (node == any_node ||
+         threadStates_[currentWorker.index].node_ == node)) {
+      return currentWorker.index;
+    }
+    return worker_index(node, next_worker(node));
+  }
+
+  void context::add_timer(timer_base* timer) noexcept {
+    auto& owner = threadStates_[timer->worker_];
+    if (!owner.add_timer(timer)) {
+      // Cancelled while being started, complete it straight away.
+      enqueue(timer);
+      return;
+    }
+
+    // A parked worker only sets its alarm for the timers of workers that
+    // were busy when it parked. If a busy worker got a new earliest timer,
+    // wake one parked worker so that it picks up the new due time.
+    if (!owner.sleeping_.load(std::memory_order_relaxed) &&
+        owner.nextTimerDue_.load(std::memory_order_relaxed) ==
+            timer->dueTime_.time_since_epoch().count()) {
+      wake_peer(timer->worker_);
+    }
+  }
+
+  void context::cancel_timer(timer_base* timer) noexcept {
+    if (threadStates_[timer->worker_].remove_timer(timer)) {
+      enqueue(timer);
+    }
+  }
+
+  void timer_cancel_callback::operator()() noexcept {
+    timer_->pool_->cancel_timer(timer_);
+  }
+
+  void context::fire_due_timers(std::uint32_t index) noexcept {
+    auto& state = threadStates_[index];
+    const auto nextDue = state.nextTimerDue_.load(std::memory_order_relaxed);
+    if (nextDue == thread_state::no_timer_due) {
+      return;
+    }
+    const auto now = clock_t::now();
+    if (now.time_since_epoch().count() >= nextDue) {
+      state.fire_due_timers(now);
+    }
+  }
+
+  task_base* context::steal_due_timers(std::uint32_t index) noexcept {
+    std::optional<time_point> now;
+    for (std::uint32_t victimIndex : threadStates_[index].victims_) {
+      auto& victim = threadStates_[victimIndex];
+      if (victim.sleeping_.load(std::memory_order_relaxed)) {
+        // A parked worker wakes up for its own timers.
+        continue;
+      }
+      const auto nextDue = victim.nextTimerDue_.load(std::memory_order_relaxed);
+      if (nextDue == thread_state::no_timer_due) {
+        continue;
+      }
+      if (!now) {
+        now = clock_t::now();
+      }
+      if (now->time_since_epoch() <
+          clock_t::duration{nextDue} + timer_steal_grace) {
+        continue;
+      }
+
+      auto tasks = victim.try_take_due_timers(*now);
+      if (!tasks.empty()) {
+        task_base* task = tasks.pop_front();
+        threadStates_[index].count(stat::tasks_stolen);
+        if (!tasks.empty()) {
+          threadStates_[index].push_back(std::move(tasks), normal_lane);
+          wake_peer(index);
+        }
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  time_point context::next_peer_timer_due(std::uint32_t index) noexcept {
+    auto nextDue = thread_state::no_timer_due;
+    for (std::uint32_t victimIndex : threadStates_[index].victims_) {
+      auto& victim = threadStates_[victimIndex];
+      if (victim.sleeping_.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      nextDue = std::min(
+          nextDue, victim.nextTimerDue_.load(std::memory_order_relaxed));
+    }
+    return nextDue == thread_state::no_timer_due
+        ? time_point::max()
+        : time_point{clock_t::duration{nextDue}} + timer_steal_grace;
+  }
+
+  void context::wake_peer(std::uint32_t index) noexcept {
+    // Pairs with the seq_cst store to sleeping_ in run(): either we see
+    // the peer going to sleep or the peer sees the work we just published.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepingCount_.load(std::memory_order_relaxed) == 0) {
+      // Everyone is busy or spinning, no need to wake anyone up.
+      return;
+    }
+
+    for (std::uint32_t peerIndex : threadStates_[index].victims_) {
+      auto& peer = threadStates_[peerIndex];
+      if (peer.sleeping_.load(std::memory_order_relaxed)) {
+        peer.wake();
+        return;
+      }
+    }
+  }
+
   void context::join() noexcept {
+    if (supervisor_.joinable()) {
+      {
+        std::lock_guard lk{supervisorMut_};
+        supervisorStopRequested_ = true;
+      }
+      supervisorCv_.notify_one();
+      supervisor_.join();
+    }
+
     for (auto& t : threads_) {
-      t.join();
+      if (t.joinable()) {
+        t.join();
+      }
     }
     threads_.clear();
   }
 
-  void context::enqueue(task_base* task) noexcept {
-    const std::uint32_t threadCount = static_cast<std::uint32_t>(threads_.size());
-    const std::uint32_t startIndex =
-        nextThread_.fetch_add(1, std::memory_order_relaxed) % threadCount;
+  void context::note_busy() noexcept {
+    if (!is_elastic() ||
+        sleepingCount_.load(std::memory_order_relaxed) != 0 ||
+        busy_.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    {
+      std::lock_guard lk{supervisorMut_};
+      busy_.store(true, std::memory_order_relaxed);
+    }
+    supervisorCv_.notify_one();
+  }
+
+  void context::supervise() noexcept {
+    std::unique_lock lk{supervisorMut_};
+    while (!supervisorStopRequested_) {
+      if (!busy_.load(std::memory_order_relaxed)) {
+        supervisorCv_.wait(lk);
+        continue;
+      }
+
+      // Give the workers a chance to catch up before adding another one.
+      supervisorCv_.wait_for(lk, growAfter_);
+      if (supervisorStopRequested_) {
+        break;
+      }
+
+      if (!is_saturated()) {
+        busy_.store(false, std::memory_order_relaxed);
+        continue;
+      }
+
+      UNIFEX_TRY {
+        start_extra_worker();
+      } UNIFEX_CATCH (...) {
+        // Failed to create a thread, try again later.
+      }
+    }
+  }
+
+  bool context::is_saturated() noexcept {
+    if (sleepingCount_.load(std::memory_order_relaxed) != 0) {
+      return false;
+    }
+    for (auto& state : threadStates_) {
+      if (state.has_queued_work()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void context::start_extra_worker() {
+    for (std::uint32_t i = threadCount_; i < maxThreadCount_; ++i) {
+      auto& state = threadStates_[i];
+      if (state.active_.load(std::memory_order_acquire)) {
+        continue;
+      }
+
+      if (threads_[i].joinable()) {
+        // Reap the thread that last ran this worker, it has retired.
+        threads_[i].join();
+      }
+      state.active_.store(true, std::memory_order_relaxed);
+      UNIFEX_TRY {
+        threads_[i] = std::thread{[this, i] { run(i); }};
+      } UNIFEX_CATCH (...) {
+        state.active_.store(false, std::memory_order_relaxed);
+        UNIFEX_RETHROW();
+      }
+      return;
+    }
+  }
+
+  void context::enqueue(
+      task_base* task, std::uint32_t node, priority prio) noexcept {
+    const std::size_t lane = lane_of(prio);
+
+    for (auto* batch = currentBatch; batch != nullptr; batch = batch->previous_) {
+      if (&batch->pool_ == this) {
+        const std::size_t nodeSlot = node == any_node ? nodes_.size() : node;
+        batch->tasks_[nodeSlot * lane_count + lane].push_back(task);
+        return;
+      }
+    }
+
+    stamp(task);
+
+    if (currentWorker.pool == this &&
+        (node == any_node ||
+         threadStates_[currentWorker.index].node_ == node)) {
+      // Scheduling from one of our own workers, keep the task local.
+      const std::uint32_t index = currentWorker.index;
+      threadStates_[index].count(stat::tasks_enqueued);
+      if (lifoSlot_ && lane == normal_lane) {
+        task = std::exchange(threadStates_[index].nextTask_, task);
+        if (task == nullptr) {
+          return;
+        }
+      }
+      enqueue_local(index, task, lane);
+      return;
+    }
+
+    if (lane != normal_lane) {
+      laneTaskCounts_[lane].fetch_add(1, std::memory_order_relaxed);
+    }
+    note_busy();
+
+    const std::uint32_t workerCount = worker_count(node);
+    const std::uint32_t startIndex = next_worker(node);
 
     // First try to enqueue to one of the threads without blocking.
-    for (std::uint32_t i = 0; i < threadCount; ++i) {
-      const auto index = (startIndex + i) < threadCount
+    for (std::uint32_t i = 0; i < workerCount; ++i) {
+      const auto index = (startIndex + i) < workerCount
           ? (startIndex + i)
-          : (startIndex + i - threadCount);
-      if (threadStates_[index].try_push(task)) {
+          : (startIndex + i - workerCount);
+      auto& state = threadStates_[worker_index(node, index)];
+      if (state.try_push(task, lane)) {
+        state.count(stat::tasks_enqueued);
         return;
       }
+      state.count(stat::failed_try_pushes);
     }
 
     // Otherwise, do a blocking enqueue on the selected thread.
-    threadStates_[startIndex].push(task);
+    auto& state = threadStates_[worker_index(node, startIndex)];
+    state.count(stat::tasks_enqueued);
+    state.count(stat::blocking_pushes);
+    state.push(task, lane);
+  }
+
+  void context::enqueue_batch(
+      task_queue tasks, std::uint32_t node, priority prio) noexcept {
+    if (tasks.empty()) {
+      return;
+    }
+
+    const std::size_t lane = lane_of(prio);
+    const std::uint32_t workerCount = worker_count(node);
+    const std::uint32_t startIndex = next_worker(node);
+
+    // Split the list up front, a task may start running, and reuse its
+    // 'next' pointer, as soon as it has been handed to a worker.
+    std::vector<task_queue> parts;
+    UNIFEX_TRY {
+      parts.resize(workerCount);
+    } UNIFEX_CATCH (...) {
+      // Fall back to enqueueing the whole list on a single worker.
+      parts.clear();
+    }
+
+    std::uint32_t taskCount = 0;
+    task_queue remaining;
+    for (; !tasks.empty(); ++taskCount) {
+      task_base* task = tasks.pop_front();
+      stamp(task);
+      if (parts.empty()) {
+        remaining.push_back(task);
+      } else {
+        parts[taskCount % workerCount].push_back(task);
+      }
+    }
+
+    if (lane != normal_lane) {
+      laneTaskCounts_[lane].fetch_add(taskCount, std::memory_order_relaxed);
+    }
+    note_busy();
+
+    if (parts.empty()) {
+      auto& state = threadStates_[worker_index(node, startIndex)];
+      state.count(stat::tasks_enqueued, taskCount);
+      state.push_back(std::move(remaining), lane);
+      return;
+    }
+
+    for (std::uint32_t i = 0; i < workerCount && !parts[i].empty(); ++i) {
+      const auto index = (startIndex + i) < workerCount
+          ? (startIndex + i)
+          : (startIndex + i - workerCount);
+      auto& state = threadStates_[worker_index(node, index)];
+      state.count(
+          stat::tasks_enqueued,
+          taskCount / workerCount + (i < taskCount % workerCount ? 1 : 0));
+      state.push_back(std::move(parts[i]), lane);
+    }
+  }
+
+  context::submission_batch::submission_batch(context& pool)
+    : pool_(pool)
+    , previous_(currentBatch)
+    , tasks_((pool.nodes_.size() + 1) * lane_count) {
+    currentBatch = this;
+  }
+
+  context::submission_batch::~submission_batch() {
+    currentBatch = previous_;
+    for (std::size_t i = 0; i < tasks_.size(); ++i) {
+      const std::size_t nodeSlot = i / lane_count;
+      const auto node = nodeSlot < pool_.nodes_.size()
+          ? static_cast<std::uint32_t>(nodeSlot)
+          : any_node;
+      const auto prio = static_cast<priority>(i % lane_count);
+      pool_.enqueue_batch(std::move(tasks_[i]), node, prio);
+    }
+  }
+
+  void context::enqueue_local(
+      std::uint32_t index, task_base* task, std::size_t lane) noexcept {
+    auto& state = threadStates_[index];
+    if (lane != normal_lane) {
+      laneTaskCounts_[lane].fetch_add(1, std::memory_order_relaxed);
+      state.push(task, lane);
+    } else if (
+        queuePolicy_ != queue_policy::work_stealing ||
+        !state.deque_.push(task)) {
+      // Either we don't have a deque or it is full, use our own inbox.
+      state.push(task, lane);
+    }
+
+    // Other workers may be parked waiting on their own queues, wake one up
+    // to steal the new work. This is cheap when nobody is parked.
+    wake_peer(index);
+    note_busy();
+  }
+
+  task_base* context::thread_state::try_pop(std::size_t lane) {
+    std::unique_lock lk{mut_, std::try_to_lock};
+    if (!lk || queues_[lane].empty()) {
+      return nullptr;
+    }
+    return queues_[lane].pop_front();
   }
 
-  task_base* context::thread_state::try_pop() {
+  task_base* context::thread_state::try_steal(std::size_t lane, bool& hasMore) {
     std::unique_lock lk{mut_, std::try_to_lock};
-    if (!lk || queue_.empty()) {
+    if (!lk || queues_[lane].empty()) {
       return nullptr;
     }
-    return queue_.pop_front();
+    task_base* task = queues_[lane].pop_front();
+    hasMore = !queues_[lane].empty();
+    return task;
   }
 
-  task_base* context::thread_state::pop() {
+  task_base* context::thread_state::pop(
+      std::size_t& lane, time_point deadline, bool& timedOut) {
     std::unique_lock lk{mut_};
-    while (queue_.empty()) {
-      if (stopRequested_) {
+    while (true) {
+      if (timersHead_ != nullptr) {
+        queues_[normal_lane].append(take_due_timers(clock_t::now()));
+      }
+      if (task_base* task = pop_highest_priority(lane)) {
+        return task;
+      }
+      if (stopRequested_ || std::exchange(wakeRequested_, false)) {
         return nullptr;
       }
-      cv_.wait(lk);
+      if (timedOut) {
+        return nullptr;
+      }
+
+      const auto wakeAt = timersHead_ != nullptr
+          ? std::min(timersHead_->dueTime_, deadline)
+          : deadline;
+      if (wakeAt == time_point::max()) {
+        cv_.wait(lk);
+      } else if (
+          cv_.wait_until(lk, wakeAt) == std::cv_status::timeout &&
+          clock_t::now() >= deadline) {
+        timedOut = true;
+      }
+    }
+  }
+
+  task_base* context::thread_state::pop_highest_priority(std::size_t& lane) {
+    for (std::size_t i = 0; i < lane_count; ++i) {
+      if (!queues_[i].empty()) {
+        lane = i;
+        return queues_[i].pop_front();
+      }
+    }
+    return nullptr;
+  }
+
+  bool context::thread_state::add_timer(timer_base* timer) {
+    std::lock_guard lk{mut_};
+    if (timer->state_ == timer_base::state::done) {
+      return false;
+    }
+    timer->state_ = timer_base::state::scheduled;
+
+    // Timers mostly use the same few delays, so the new one usually goes
+    // at, or close to, the end of the list.
+    timer_base* prev = timersTail_;
+    while (prev != nullptr && timer->dueTime_ < prev->dueTime_) {
+      prev = prev->timerPrev_;
+    }
+    timer->timerPrev_ = prev;
+    timer->timerNext_ = prev != nullptr ? prev->timerNext_ : timersHead_;
+    if (timer->timerNext_ != nullptr) {
+      timer->timerNext_->timerPrev_ = timer;
+    } else {
+      timersTail_ = timer;
+    }
+    if (prev != nullptr) {
+      prev->timerNext_ = timer;
+    } else {
+      // New earliest due time, the worker may need to wake up earlier.
+      timersHead_ = timer;
+      update_next_timer_due();
+      if (sleeping_.load(std::memory_order_relaxed)) {
+        cv_.notify_one();
+      }
+    }
+    return true;
+  }
+
+  bool context::thread_state::remove_timer(timer_base* timer) {
+    std::lock_guard lk{mut_};
+    const auto state = std::exchange(timer->state_, timer_base::state::done);
+    if (state != timer_base::state::scheduled) {
+      return false;
+    }
+    unlink_timer(timer);
+    return true;
+  }
+
+  void context::thread_state::fire_due_timers(time_point now) {
+    std::lock_guard lk{mut_};
+    queues_[normal_lane].append(take_due_timers(now));
+  }
+
+  context::task_queue context::thread_state::try_take_due_timers(time_point now) {
+    std::unique_lock lk{mut_, std::try_to_lock};
+    if (!lk) {
+      return {};
+    }
+    return take_due_timers(now);
+  }
+
+  context::task_queue context::thread_state::take_due_timers(time_point now) {
+    task_queue tasks;
+    while (timersHead_ != nullptr && timersHead_->dueTime_ <= now) {
+      timer_base* timer = timersHead_;
+      timer->state_ = timer_base::state::done;
+      unlink_timer(timer);
+      stamp(timer);
+      count(stat::tasks_enqueued);
+      tasks.push_back(timer);
+    }
+    return tasks;
+  }
+
+  void context::thread_state::unlink_timer(timer_base* timer) {
+    const bool wasFirst = timer == timersHead_;
+    if (timer->timerPrev_ != nullptr) {
+      timer->timerPrev_->timerNext_ = timer->timerNext_;
+    } else {
+      timersHead_ = timer->timerNext_;
+    }
+    if (timer->timerNext_ != nullptr) {
+      timer->timerNext_->timerPrev_ = timer->timerPrev_;
+    } else {
+      timersTail_ = timer->timerPrev_;
+    }
+    timer->timerNext_ = nullptr;
+    timer->timerPrev_ = nullptr;
+    if (wasFirst) {
+      update_next_timer_due();
+    }
+  }
+
+  void context::thread_state::update_next_timer_due() {
+    nextTimerDue_.store(
+        timersHead_ != nullptr ? timersHead_->dueTime_.time_since_epoch().count()
+                               : no_timer_due,
+        std::memory_order_relaxed);
+  }
+
+  void context::thread_state::count_start([[maybe_unused]] task_base* task) noexcept {
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+    count(stat::tasks_executed);
+
+    const auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             clock_t::now() - task->enqueueTime)
+                             .count();
+    std::size_t bucket = 0;
+    for (auto ns = static_cast<std::uint64_t>(std::max<std::int64_t>(latency, 0)) >> 1;
+         ns != 0 && bucket + 1 < stats::latency_bucket_count;
+         ns >>= 1) {
+      ++bucket;
+    }
+    latencyHistogram_[bucket].fetch_add(1, std::memory_order_relaxed);
+#endif
+  }
+
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+  context::stats context::snapshot() const noexcept {
+    const auto get = [](const thread_state& state, stat s) {
+      return state.stats_[static_cast<std::size_t>(s)].load(
+          std::memory_order_relaxed);
+    };
+
+    stats result;
+    for (const auto& state : threadStates_) {
+      result.tasksEnqueued += get(state, stat::tasks_enqueued);
+      result.tasksExecuted += get(state, stat::tasks_executed);
+      result.tasksStolen += get(state, stat::tasks_stolen);
+      result.failedTryPushes += get(state, stat::failed_try_pushes);
+      result.failedTryPops += get(state, stat::failed_try_pops);
+      result.blockingPushes += get(state, stat::blocking_pushes);
+      result.parks += get(state, stat::parks);
+      result.parkedTime += std::chrono::nanoseconds(
+          get(state, stat::parked_nanoseconds));
+      for (std::size_t i = 0; i < stats::latency_bucket_count; ++i) {
+        result.latencyHistogram[i] +=
+            state.latencyHistogram_[i].load(std::memory_order_relaxed);
+      }
+    }
+    return result;
+  }
+#endif
+
+  bool context::thread_state::has_queued_work() {
+    if (!deque_.empty()) {
+      return true;
+    }
+    std::lock_guard lk{mut_};
+    for (auto& queue : queues_) {
+      if (!queue.empty()) {
+        return true;
+      }
     }
-    return queue_.pop_front();
+    return false;
   }
 
-  bool context::thread_state::try_push(task_base* task) {
+  context::task_queue context::thread_state::try_pop_all(std::size_t lane) {
+    std::unique_lock lk{mut_, std::try_to_lock};
+    if (!lk) {
+      return {};
+    }
+    return std::move(queues_[lane]);
+  }
+
+  bool context::thread_state::try_push(task_base* task, std::size_t lane) {
     std::unique_lock lk{mut_, std::try_to_lock};
     if (!lk) {
       return false;
     }
-    const bool wasEmpty = queue_.empty();
-    queue_.push_back(task);
-    if (wasEmpty) {
+    queues_[lane].push_back(task);
+    if (sleeping_.load(std::memory_order_relaxed)) {
       cv_.notify_one();
     }
     return true;
   }
 
-  void context::thread_state::push(task_base* task) {
+  void context::thread_state::push(task_base* task, std::size_t lane) {
+    std::lock_guard lk{mut_};
+    queues_[lane].push_back(task);
+    if (sleeping_.load(std::memory_order_relaxed)) {
+      cv_.notify_one();
+    }
+  }
+
+  void context::thread_state::push_front(task_queue tasks, std::size_t lane) {
+    std::lock_guard lk{mut_};
+    queues_[lane].prepend(std::move(tasks));
+  }
+
+  void context::thread_state::push_back(task_queue tasks, std::size_t lane) {
+    std::lock_guard lk{mut_};
+    queues_[lane].append(std::move(tasks));
+    if (sleeping_.load(std::memory_order_relaxed)) {
+      cv_.notify_one();
+    }
+  }
+
+  void context::thread_state::wake() {
     std::lock_guard lk{mut_};
-    const bool wasEmpty = queue_.empty();
-    queue_.push_back(task);
-    if (wasEmpty) {
+    wakeRequested_ = true;
+    if (sleeping_.load(std::memory_order_relaxed)) {
       cv_.notify_one();
     }
   }
@@ -149,5 +1196,10 @@ namespace _static_thread_pool {
     cv_.notify_one();
   }
 
+  bool context::thread_state::is_stop_requested() {
+    std::lock_guard lk{mut_};
+    return stopRequested_;
+  }
+
 } // namespace _static_thread_pool
 } // namespace unifex
@@ -16,11 +16,18 @@
 
 #include <unifex/bulk_schedule.hpp>
 #include <unifex/single_thread_context.hpp>
+#include <unifex/static_thread_pool.hpp>
 #include <unifex/sync_wait.hpp>
 #include <unifex/bulk_transform.hpp>
 #include <unifex/bulk_join.hpp>
 #include <unifex/let_value_with_stop_source.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 TEST(bulk, bulk_transform) {
@@ -112,3 +119,71 @@ TEST(bulk, Pipeable) {
         EXPECT_EQ(i, output[i]);
     }
 }
+
+TEST(bulk, static_thread_pool_parallel) {
+    unifex::static_thread_pool pool{4};
+    auto sched = pool.get_scheduler();
+
+    const std::size_t count = 1000;
+
+    std::vector<std::atomic<int>> output(count);
+    std::mutex mut;
+    std::set<std::thread::id> threadIds;
+
+    unifex::sync_wait(
+        unifex::bulk_join(
+            unifex::bulk_transform(
+                unifex::bulk_schedule(sched, count),
+                [&](std::size_t index) noexcept {
+                    ++output[index];
+                    std::lock_guard lk{mut};
+                    threadIds.insert(std::this_thread::get_id());
+                }, unifex::par)));
+
+    for (std::size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(1, output[i].load());
+    }
+    EXPECT_EQ(0u, threadIds.count(std::this_thread::get_id()));
+}
+
+TEST(bulk, static_thread_pool_cancellation) {
+    unifex::static_thread_pool pool{4};
+    auto sched = pool.get_scheduler();
+
+    const std::size_t count = 1000;
+    std::atomic<std::size_t> executed{0};
+
+    // Every chunk stops at its next cancellation check once stop is
+    // requested, so at most one cancellation chunk runs per worker after
+    // the first index.
+    auto result = unifex::sync_wait(
+        unifex::let_value_with_stop_source([&](unifex::inplace_stop_source& stopSource) {
+            return unifex::bulk_join(
+                unifex::bulk_transform(
+                    unifex::bulk_schedule(sched, count),
+                    [&](std::size_t) noexcept {
+                        stopSource.request_stop();
+                        ++executed;
+                    }, unifex::par));
+        }));
+
+    EXPECT_FALSE(result.has_value());
+    EXPECT_LE(executed.load(), 4 * unifex::bulk_cancellation_chunk_size);
+}
+
+TEST(bulk, static_thread_pool_error) {
+    unifex::static_thread_pool pool{4};
+    auto sched = pool.get_scheduler();
+
+    EXPECT_THROW(
+        unifex::sync_wait(
+            unifex::bulk_join(
+                unifex::bulk_transform(
+                    unifex::bulk_schedule(sched, std::size_t{1000}),
+                    [](std::size_t index) {
+                        if (index == 500) {
+                            throw std::runtime_error{"failed"};
+                        }
+                    }, unifex::par))),
+        std::runtime_error);
+}
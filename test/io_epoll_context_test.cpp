@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_EPOLL
+
+#include <unifex/defer.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/let_value.hpp>
+#include <unifex/linux/io_epoll_context.hpp>
+#include <unifex/repeat_effect_until.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/stop_when.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+#include <unifex/when_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+using namespace std::chrono_literals;
+
+namespace {
+const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+
+// Connects a client to 'listener' and accepts the connection.
+std::pair<io_epoll_context::async_socket, io_epoll_context::async_socket>
+connect_pair(
+    io_epoll_context::scheduler s, io_epoll_context::async_listener& listener) {
+  auto [client, server] = *sync_wait(when_all(
+      async_connect(s, listener.local_address()), async_accept(listener)));
+  return {
+      std::move(std::get<0>(std::get<0>(client))),
+      std::move(std::get<0>(std::get<0>(server)))};
+}
+} // namespace
+
+TEST(io_epoll_context, LoopbackEcho) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  EXPECT_NE(0, listener.local_address().port());
+
+  auto [client, server] = connect_pair(s, listener);
+
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some(
+          client, as_bytes(span{hello.data(), hello.size()}))));
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+
+  // Closing one end is seen as the end of the stream by the other.
+  {
+    auto closed = std::move(client);
+  }
+  EXPECT_EQ(
+      0,
+      sync_wait(async_read_some(
+          server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+}
+
+TEST(io_epoll_context, ReadsWaitForTheNextEdge) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto [client, server] = connect_pair(s, listener);
+
+  // Each read finds the socket empty and waits, and each write makes a new
+  // edge that wakes it.
+  for (int i = 0; i < 10; ++i) {
+    std::array<char, 5> buffer{};
+    auto [read, written] = *sync_wait(when_all(
+        async_read_some(
+            server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+        let_value(schedule_at(s, now(s) + 1ms), [&] {
+          return async_write_some(
+              client, as_bytes(span{hello.data(), hello.size()}));
+        })));
+    EXPECT_EQ(5, std::get<0>(std::get<0>(read)));
+    EXPECT_EQ(5, std::get<0>(std::get<0>(written)));
+    EXPECT_EQ(hello, buffer);
+  }
+}
+
+TEST(io_epoll_context, WritesWaitForSpace) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto [client, server] = connect_pair(s, listener);
+
+  // Fill the socket buffers, then drain them on the other end while a
+  // write is waiting for space.
+  const std::vector<char> data(1 << 16, 'x');
+  std::size_t sent = 0;
+  while (true) {
+    auto written = sync_wait(stop_when(
+        async_write_some(client, as_bytes(span{data.data(), data.size()})),
+        schedule_at(s, now(s) + 20ms)));
+    if (!written.has_value()) {
+      break;
+    }
+    sent += static_cast<std::size_t>(*written);
+  }
+  EXPECT_GT(sent, 0u);
+
+  std::vector<char> buffer(1 << 16);
+  std::size_t received = 0;
+  auto [written, drained] = *sync_wait(when_all(
+      async_write_some(client, as_bytes(span{data.data(), data.size()})),
+      repeat_effect_until(
+          defer([&] {
+            return then(
+                async_read_some(
+                    server,
+                    as_writable_bytes(span{buffer.data(), buffer.size()})),
+                [&](ssize_t count) { received += count; });
+          }),
+          [&] { return received >= sent; })));
+  EXPECT_GT(std::get<0>(std::get<0>(written)), 0);
+  EXPECT_EQ(sent, received);
+}
+
+TEST(io_epoll_context, CancelSocketOperations) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+
+  // Nobody connects, so the accept only completes once it is cancelled.
+  auto accepted = sync_wait(
+      stop_when(async_accept(listener), schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(accepted.has_value());
+
+  auto [client, server] = connect_pair(s, listener);
+
+  // Nothing is sent, so the receive only completes once it is cancelled.
+  std::array<char, 5> buffer{};
+  auto received = sync_wait(stop_when(
+      async_read_some(
+          server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+      schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(received.has_value());
+
+  // The socket is still usable afterwards.
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some(
+          client, as_bytes(span{hello.data(), hello.size()}))));
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+}
+
+TEST(io_epoll_context, ConnectionRefused) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto address = open_listening_socket(s, socket_address::ipv4_loopback(), 4)
+                     .local_address();
+
+  try {
+    sync_wait(async_connect(s, address));
+    ADD_FAILURE() << "expected the connection to be refused";
+  } catch (const std::system_error& e) {
+    EXPECT_EQ(std::errc::connection_refused, e.code());
+  }
+}
+
+TEST(io_epoll_context, UnixDomainSockets) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  const std::string path =
+      "/tmp/io_epoll_context_test." + std::to_string(::getpid());
+  std::remove(path.c_str());
+  scope_guard removeSocket = [&]() noexcept {
+    std::remove(path.c_str());
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(
+      s, socket_address::unix_domain(path.c_str()), 4);
+  EXPECT_EQ(AF_UNIX, listener.local_address().family());
+
+  auto [client, server] = connect_pair(s, listener);
+
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some(
+          server, as_bytes(span{hello.data(), hello.size()}))));
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          client, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+}
+
+TEST(io_epoll_context, DatagramSockets) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto sender = open_datagram_socket(s, socket_address::ipv4_loopback());
+  auto receiver = open_datagram_socket(s, socket_address::ipv4_loopback());
+  auto destination = receiver.local_address();
+
+  std::array<char, 5> data = hello;
+  iovec iov{data.data(), data.size()};
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_name = const_cast<sockaddr*>(destination.data());
+  message.msg_namelen = destination.size();
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+
+  std::array<char, 16> buffer{};
+  iovec bufferIov{buffer.data(), buffer.size()};
+  sockaddr_storage source;
+  msghdr received;
+  std::memset(&received, 0, sizeof(received));
+  received.msg_name = &source;
+  received.msg_namelen = sizeof(source);
+  received.msg_iov = &bufferIov;
+  received.msg_iovlen = 1;
+
+  // The receive starts first and waits for the datagram.
+  auto [receivedCount, sentCount] = *sync_wait(when_all(
+      async_receive_message(receiver, received),
+      async_send_message(sender, message)));
+  EXPECT_EQ(5, std::get<0>(std::get<0>(receivedCount)));
+  EXPECT_EQ(5, std::get<0>(std::get<0>(sentCount)));
+  EXPECT_EQ(0, std::memcmp(buffer.data(), hello.data(), hello.size()));
+  EXPECT_EQ(
+      sender.local_address().port(),
+      socket_address(reinterpret_cast<const sockaddr*>(&source), received.msg_namelen)
+          .port());
+}
+
+TEST(io_epoll_context, SmallEventBatches) {
+  io_epoll_context::options opts;
+  opts.maxEventsPerWait = 1;
+  io_epoll_context ctx{opts};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto [client1, server1] = connect_pair(s, listener);
+  auto [client2, server2] = connect_pair(s, listener);
+  auto [client3, server3] = connect_pair(s, listener);
+
+  // Three sockets become readable at once, but each epoll_wait() only
+  // reports one of them.
+  std::array<char, 5> buffer1{};
+  std::array<char, 5> buffer2{};
+  std::array<char, 5> buffer3{};
+  auto send = [&](io_epoll_context::async_socket& client) {
+    return async_write_some(client, as_bytes(span{hello.data(), hello.size()}));
+  };
+  sync_wait(when_all(
+      async_read_some(server1, as_writable_bytes(span{buffer1})),
+      async_read_some(server2, as_writable_bytes(span{buffer2})),
+      async_read_some(server3, as_writable_bytes(span{buffer3})),
+      let_value(schedule_at(s, now(s) + 1ms), [&] {
+        return when_all(send(client1), send(client2), send(client3));
+      })));
+  EXPECT_EQ(hello, buffer1);
+  EXPECT_EQ(hello, buffer2);
+  EXPECT_EQ(hello, buffer3);
+}
+
+TEST(io_epoll_context, FileOperationsUseTheBlockingDefaults) {
+  io_epoll_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  const char* path = "io_epoll_context_test_file.tmp";
+  scope_guard removeOnExit = [&]() noexcept { ::unlink(path); };
+
+  // The file only customises the blocking CPOs, so the async_* CPOs run
+  // them from a task scheduled onto the I/O thread.
+  auto s = ctx.get_scheduler();
+  auto file = sync_wait(async_open_file_read_write(s, path));
+  ASSERT_TRUE(file.has_value());
+
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some_at(
+          *file, 0, as_bytes(span{hello.data(), hello.size()}))));
+  sync_wait(async_fallocate(*file, 0, 4096));
+  sync_wait(async_fdatasync(*file));
+  EXPECT_EQ(
+      t.get_id(),
+      sync_wait(then(
+          async_fsync(*file), [] { return std::this_thread::get_id(); })));
+
+  auto status = sync_wait(async_statx(*file));
+  ASSERT_TRUE(status.has_value());
+  EXPECT_EQ(4096u, status->stx_size);
+
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some_at(
+          *file, 0, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+
+  sync_wait(async_close(*file));
+
+  // Errors from the blocking call are delivered as exceptions.
+  EXPECT_THROW(sync_wait(async_fsync(*file)), std::system_error);
+}
+
+TEST(io_epoll_context, SocketsOutliveTheRunLoop) {
+  io_epoll_context ctx;
+  auto s = ctx.get_scheduler();
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto [client, server] = connect_pair(s, listener);
+
+  // The registrations are freed along with the context once the sockets
+  // are destroyed.
+  stopSource.request_stop();
+  t.join();
+}
+
+#endif // !UNIFEX_NO_EPOLL
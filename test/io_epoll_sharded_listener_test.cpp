@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_EPOLL
+
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/linux/io_epoll_sharded_listener.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/stop_when.hpp>
+#include <unifex/stream_concepts.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+
+#include <chrono>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+using namespace std::chrono_literals;
+
+namespace {
+template <typename Scheduler>
+std::thread::id thread_of(Scheduler s) {
+  return *sync_wait(
+      then(schedule(s), [] { return std::this_thread::get_id(); }));
+}
+} // namespace
+
+TEST(io_epoll_sharded_listener, ShardsShareOnePort) {
+  io_epoll_sharded_listener::options opts;
+  opts.shardCount = 3;
+  io_epoll_sharded_listener listener{socket_address::ipv4_loopback(), opts};
+  EXPECT_EQ(3u, listener.shard_count());
+
+  const auto port = listener.local_address().port();
+  EXPECT_NE(0, port);
+
+  std::set<std::thread::id> threads;
+  for (std::uint32_t i = 0; i < listener.shard_count(); ++i) {
+    EXPECT_EQ(port, listener.listener(i).local_address().port());
+    threads.insert(thread_of(listener.get_scheduler(i)));
+  }
+  EXPECT_EQ(3u, threads.size());
+  EXPECT_EQ(0u, threads.count(std::this_thread::get_id()));
+}
+
+TEST(io_epoll_sharded_listener, ConnectionsAreSpreadOverShards) {
+  io_epoll_sharded_listener::options opts;
+  opts.shardCount = 2;
+  io_epoll_sharded_listener listener{socket_address::ipv4_loopback(), opts};
+
+  io_epoll_context clientContext;
+  inplace_stop_source stopSource;
+  std::thread t{[&] { clientContext.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  // The connections wait in the shards' accept queues until accepted.
+  constexpr std::size_t connectionCount = 32;
+  std::vector<io_epoll_context::async_socket> clients;
+  for (std::size_t i = 0; i < connectionCount; ++i) {
+    auto client = sync_wait(
+        async_connect(clientContext.get_scheduler(), listener.local_address()));
+    ASSERT_TRUE(client.has_value());
+    clients.push_back(std::move(*client));
+  }
+
+  std::vector<io_epoll_context::async_socket> servers;
+  for (std::uint32_t i = 0; i < listener.shard_count(); ++i) {
+    auto s = listener.get_scheduler(i);
+    const auto shardThread = thread_of(s);
+    auto connections = listener.accept_stream(i);
+
+    std::size_t accepted = 0;
+    while (true) {
+      auto server = sync_wait(stop_when(
+          then(
+              next(connections),
+              [&](io_epoll_context::async_socket socket) {
+                EXPECT_EQ(shardThread, std::this_thread::get_id());
+                return socket;
+              }),
+          schedule_at(s, now(s) + 20ms)));
+      if (!server.has_value()) {
+        break;
+      }
+      servers.push_back(std::move(*server));
+      ++accepted;
+    }
+    sync_wait(cleanup(connections));
+
+    // Each connection picks a shard by hashing its addresses, so with this
+    // many connections both shards get some.
+    EXPECT_GT(accepted, 0u);
+  }
+  EXPECT_EQ(connectionCount, servers.size());
+}
+
+#endif // !UNIFEX_NO_EPOLL
@@ -0,0 +1,1090 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_LIBURING
+
+#include <unifex/file_concepts.hpp>
+#include <unifex/inplace_stop_token.hpp>
+#include <unifex/let_value.hpp>
+#include <unifex/let_value_with.hpp>
+#include <unifex/linux/io_uring_context.hpp>
+#include <unifex/pipe_concepts.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/scope_guard.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/sequence.hpp>
+#include <unifex/socket_concepts.hpp>
+#include <unifex/stop_when.hpp>
+#include <unifex/stream_concepts.hpp>
+#include <unifex/then.hpp>
+#include <unifex/when_all.hpp>
+#include <unifex/with_query_value.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+using namespace std::chrono_literals;
+
+namespace {
+// Run the context on a separate thread and check that both local timers and
+// remotely scheduled work complete.
+void check_runs(io_uring_context& ctx) {
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  int count = 0;
+  sync_wait(when_all(
+      then(schedule(s), [&] { ++count; }),
+      then(schedule_at(s, now(s) + 10ms), [&] { ++count; }),
+      then(schedule_at(s, now(s) + 5ms), [&] { ++count; })));
+  EXPECT_EQ(3, count);
+}
+} // namespace
+
+TEST(io_uring_context, DefaultOptions) {
+  io_uring_context ctx;
+  EXPECT_EQ(256u, ctx.sq_entry_count());
+  EXPECT_EQ(512u, ctx.cq_entry_count());
+  EXPECT_EQ(0u, ctx.setup_flags());
+  check_runs(ctx);
+}
+
+TEST(io_uring_context, CustomQueueSizes) {
+  io_uring_context::options opts;
+  opts.sqEntries = 60;
+  opts.cqEntries = 1000;
+  io_uring_context ctx{opts};
+  EXPECT_EQ(64u, ctx.sq_entry_count());
+  EXPECT_EQ(1024u, ctx.cq_entry_count());
+  EXPECT_NE(0u, ctx.setup_flags() & IORING_SETUP_CQSIZE);
+  check_runs(ctx);
+}
+
+TEST(io_uring_context, ClampOversizedRing) {
+  io_uring_context::options opts;
+  opts.sqEntries = 1u << 20;
+  opts.clamp = true;
+  io_uring_context ctx{opts};
+  EXPECT_LT(ctx.sq_entry_count(), opts.sqEntries);
+  check_runs(ctx);
+}
+
+TEST(io_uring_context, OversizedRingWithoutClampThrows) {
+  io_uring_context::options opts;
+  opts.sqEntries = 1u << 20;
+  EXPECT_THROW(io_uring_context{opts}, std::system_error);
+}
+
+TEST(io_uring_context, DeferTaskrunOnAnotherThread) {
+  // The ring is created here but must be driven from the run() thread.
+  io_uring_context::options opts;
+  opts.deferTaskrun = true;
+  io_uring_context ctx{opts};
+  if ((ctx.setup_flags() & IORING_SETUP_DEFER_TASKRUN) != 0) {
+    EXPECT_NE(0u, ctx.setup_flags() & IORING_SETUP_SINGLE_ISSUER);
+  }
+  check_runs(ctx);
+}
+
+TEST(io_uring_context, AttachWorkQueue) {
+  io_uring_context first;
+  io_uring_context::options opts;
+  opts.attachTo = &first;
+  io_uring_context second{opts};
+  check_runs(first);
+  check_runs(second);
+}
+
+TEST(io_uring_context, SqPoll) {
+  // Pin the poller to the last CPU the process may run on, since the
+  // others might not be available to it.
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  int lastCpu = -1;
+  for (int i = 0; i < CPU_SETSIZE; ++i) {
+    if (CPU_ISSET(i, &allowed)) {
+      lastCpu = i;
+    }
+  }
+  ASSERT_GE(lastCpu, 0);
+
+  io_uring_context::options opts;
+  opts.sqPoll = true;
+  opts.sqPollIdle = 1ms;
+  opts.sqPollCpu = lastCpu;
+  io_uring_context ctx{opts};
+  // SQPOLL and SQ_AFF must survive the fallback that drops flags the
+  // kernel doesn't support.
+  ASSERT_NE(0u, ctx.setup_flags() & IORING_SETUP_SQPOLL);
+  EXPECT_NE(0u, ctx.setup_flags() & IORING_SETUP_SQ_AFF);
+  check_runs(ctx);
+
+#if UNIFEX_IO_URING_STATS
+  const auto before = ctx.snapshot();
+#endif
+
+  // Let the poller go to sleep so the next submission has to wake it.
+  std::this_thread::sleep_for(20ms);
+  check_runs(ctx);
+
+#if UNIFEX_IO_URING_STATS
+  EXPECT_GT(ctx.snapshot().sqPollerWakeups, before.sqPollerWakeups);
+#endif
+}
+
+TEST(io_uring_context, RegisteredBuffers) {
+  io_uring_context ctx;
+
+  std::array<std::byte, 4096> writeBuffer;
+  std::array<std::byte, 4096> readBuffer{};
+  for (std::size_t i = 0; i < writeBuffer.size(); ++i) {
+    writeBuffer[i] = static_cast<std::byte>(i * 7);
+  }
+
+  // Reserve the second slot and fill it in once the ring is running.
+  iovec buffers[2] = {{writeBuffer.data(), writeBuffer.size()}, {nullptr, 0}};
+  ctx.register_buffers(span{buffers, 2});
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_registered_buffers.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+
+  sync_wait(then(schedule(s), [&] {
+    iovec update{readBuffer.data(), readBuffer.size()};
+    ctx.update_registered_buffers(1, span{&update, 1});
+  }));
+
+  std::optional<ssize_t> bytesRead = sync_wait(let_value_with(
+      [&] { return open_file_read_write(s, path); },
+      [&](io_uring_context::async_read_write_file& file) {
+        return sequence(
+            // Both halves of the write lie inside the registered buffer.
+            then(
+                when_all(
+                    async_write_some_at(
+                        file, 0, as_bytes(span{writeBuffer.data(), 2048})),
+                    async_write_some_at(
+                        file,
+                        2048,
+                        as_bytes(span{writeBuffer.data() + 2048, 2048}))),
+                [](auto&&...) noexcept {}),
+            async_read_some_at(
+                file, 0, span{readBuffer.data(), readBuffer.size()}));
+      }));
+
+  ASSERT_TRUE(bytesRead.has_value());
+  EXPECT_EQ(4096, *bytesRead);
+  EXPECT_EQ(writeBuffer, readBuffer);
+
+  sync_wait(then(schedule(s), [&] { ctx.unregister_buffers(); }));
+
+  // Unregistered buffers go back to being submitted as READV/WRITEV.
+  readBuffer.fill(std::byte{0});
+  bytesRead = sync_wait(let_value_with(
+      [&] { return open_file_read_only(s, path); },
+      [&](io_uring_context::async_read_only_file& file) {
+        return async_read_some_at(
+            file, 0, span{readBuffer.data(), readBuffer.size()});
+      }));
+  ASSERT_TRUE(bytesRead.has_value());
+  EXPECT_EQ(4096, *bytesRead);
+  EXPECT_EQ(writeBuffer, readBuffer);
+}
+
+TEST(io_uring_context, FixedFiles) {
+  io_uring_context::options opts;
+  opts.fixedFileCount = 2;
+  io_uring_context ctx{opts};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_fixed_files.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  {
+    auto file = open_file_write_only(s, path);
+    EXPECT_EQ(
+        5, sync_wait(async_write_some_at(file, 0, as_bytes(span{hello.data(), hello.size()}))));
+  }
+
+  // Open more files than there are slots so that the last one falls back
+  // to its plain descriptor. The second round checks that closing the files
+  // gave their slots back.
+  for (int round = 0; round < 2; ++round) {
+    std::optional<io_uring_context::async_read_only_file> files[3];
+    for (auto& file : files) {
+      file.emplace(open_file_read_only(s, path));
+    }
+    for (auto& file : files) {
+      std::array<char, 5> buffer{};
+      EXPECT_EQ(
+          5,
+          sync_wait(async_read_some_at(
+              *file, 0, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+      EXPECT_EQ(hello, buffer);
+    }
+  }
+}
+
+TEST(io_uring_context, AsyncFileOperations) {
+  io_uring_context::options opts;
+  opts.fixedFileCount = 4;
+  io_uring_context ctx{opts};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_async_file_operations.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  {
+    auto file = sync_wait(async_open_file_write_only(s, path));
+    ASSERT_TRUE(file.has_value());
+    EXPECT_EQ(
+        5,
+        sync_wait(async_write_some_at(
+            *file, 0, as_bytes(span{hello.data(), hello.size()}))));
+    sync_wait(async_fallocate(*file, 0, 8192));
+    sync_wait(async_fdatasync(*file));
+    sync_wait(async_fsync(*file));
+
+    auto status = sync_wait(async_statx(*file));
+    ASSERT_TRUE(status.has_value());
+    EXPECT_EQ(8192u, status->stx_size);
+
+    sync_wait(async_close(*file));
+  }
+
+  auto file = sync_wait(async_open_file_read_only(s, path));
+  ASSERT_TRUE(file.has_value());
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some_at(
+          *file, 0, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+
+  // Errors are reported through set_error.
+  EXPECT_THROW(
+      sync_wait(async_open_file_read_only(s, "does/not/exist")),
+      std::system_error);
+}
+
+TEST(io_uring_context, CancelFileOperations) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+
+  // Reading from a FIFO that has no data blocks until a stop request
+  // cancels the read in the kernel.
+  const char* path = "io_uring_context_test_cancel_file_operations.fifo";
+  std::remove(path);
+  ASSERT_EQ(0, mkfifo(path, 0600));
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+
+  auto file = open_file_read_write(s, path);
+  std::array<char, 4> buffer{};
+  auto buffers = as_writable_bytes(span{buffer.data(), buffer.size()});
+  EXPECT_FALSE(sync_wait(stop_when(
+                   async_read_some_at(file, 0, buffers),
+                   schedule_at(s, now(s) + 10ms)))
+                   .has_value());
+
+  // Stop requested before the read reaches the I/O thread.
+  inplace_stop_source readStop;
+  readStop.request_stop();
+  EXPECT_FALSE(sync_wait(with_query_value(
+                   async_read_some_at(file, 0, buffers),
+                   get_stop_token,
+                   readStop.get_token()))
+                   .has_value());
+
+  // The file is still usable afterwards.
+  const std::array<char, 4> data = {'d', 'a', 't', 'a'};
+  EXPECT_EQ(
+      4,
+      sync_wait(async_write_some_at(
+          file, 0, as_bytes(span{data.data(), data.size()}))));
+  EXPECT_EQ(4, sync_wait(async_read_some_at(file, 0, buffers)));
+  EXPECT_EQ(data, buffer);
+}
+
+TEST(io_uring_context, BatchedSubmissions) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_batched_submissions.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+
+  const std::array<char, 4> data = {'a', 'b', 'c', 'd'};
+  auto file = open_file_read_write(s, path);
+  sync_wait(async_write_some_at(
+      file, 0, as_bytes(span{data.data(), data.size()})));
+
+#if UNIFEX_IO_URING_STATS
+  const auto before = ctx.snapshot();
+#endif
+
+  // Started together on the I/O thread, so the reads are published to the
+  // kernel by a single store of the tail and submitted by one
+  // io_uring_enter().
+  std::array<char, 4> buffer{};
+  auto read = [&](std::size_t i) {
+    return async_read_some_at(
+        file, i, as_writable_bytes(span{&buffer[i], 1}));
+  };
+  sync_wait(let_value(schedule(s), [&] {
+    return when_all(read(0), read(1), read(2), read(3));
+  }));
+  EXPECT_EQ(data, buffer);
+
+#if UNIFEX_IO_URING_STATS
+  const auto after = ctx.snapshot();
+  const auto sqes = after.sqesSubmitted - before.sqesSubmitted;
+  EXPECT_GE(sqes, 4u);
+  EXPECT_LT(after.enters - before.enters, sqes);
+  EXPECT_GE(after.cqesReaped - before.cqesReaped, 4u);
+  EXPECT_GE(after.cqes_per_reap(), 1.0);
+#endif
+}
+
+TEST(io_uring_context, LoopbackEcho) {
+  io_uring_context::options opts;
+  opts.fixedFileCount = 4;
+  io_uring_context ctx{opts};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  const auto address = listener.local_address();
+  EXPECT_NE(0, address.port());
+
+  auto client = sync_wait(async_connect(s, address));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some(
+          *client, as_bytes(span{hello.data(), hello.size()}))));
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          *server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+
+  // Echo it back using the message-oriented operations.
+  iovec iov{buffer.data(), buffer.size()};
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  EXPECT_EQ(5, sync_wait(async_send_message(*server, message)));
+
+  std::array<char, 5> reply{};
+  iovec replyIov{reply.data(), reply.size()};
+  msghdr replyMessage;
+  std::memset(&replyMessage, 0, sizeof(replyMessage));
+  replyMessage.msg_iov = &replyIov;
+  replyMessage.msg_iovlen = 1;
+  EXPECT_EQ(5, sync_wait(async_receive_message(*client, replyMessage)));
+  EXPECT_EQ(hello, reply);
+
+  // Closing one end is seen as the end of the stream by the other.
+  sync_wait(async_close(*client));
+  EXPECT_EQ(
+      0,
+      sync_wait(async_read_some(
+          *server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+}
+
+TEST(io_uring_context, CancelSocketOperations) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+
+  // Nobody connects, so the accept only completes once it is cancelled.
+  auto accepted =
+      sync_wait(stop_when(async_accept(listener), schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(accepted.has_value());
+
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  // Nothing is sent, so the receive only completes once it is cancelled.
+  std::array<char, 5> buffer{};
+  auto received = sync_wait(stop_when(
+      async_read_some(
+          *server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+      schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(received.has_value());
+
+  // The socket is still usable afterwards.
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some(
+          *client, as_bytes(span{hello.data(), hello.size()}))));
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          *server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+}
+
+TEST(io_uring_context, LinkedTimeout) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  // Nothing is sent, so the receive times out.
+  std::array<char, 5> buffer{};
+  try {
+    sync_wait(with_timeout(
+        async_read_some(
+            *server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+        10ms));
+    ADD_FAILURE() << "expected the receive to time out";
+  } catch (const std::system_error& e) {
+    EXPECT_EQ(std::errc::timed_out, e.code());
+  }
+
+  // A stop request still completes with done rather than timing out.
+  auto received = sync_wait(stop_when(
+      with_timeout(
+          async_read_some(
+              *server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+          10s),
+      schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(received.has_value());
+
+  // Operations that complete in time produce their result as usual.
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  EXPECT_EQ(
+      5,
+      sync_wait(with_timeout(
+          async_write_some(*client, as_bytes(span{hello.data(), hello.size()})),
+          10s)));
+  EXPECT_EQ(
+      5,
+      sync_wait(with_timeout(
+          async_read_some(
+              *server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+          10s)));
+  EXPECT_EQ(hello, buffer);
+
+  const char* path = "io_uring_context_test_linked_timeout.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+  auto file = sync_wait(async_open_file_read_write(s, path));
+  ASSERT_TRUE(file.has_value());
+  EXPECT_EQ(
+      5,
+      sync_wait(with_timeout(
+          async_write_some_at(
+              *file, 0, as_bytes(span{hello.data(), hello.size()})),
+          10s)));
+  std::array<char, 5> contents{};
+  EXPECT_EQ(
+      5,
+      sync_wait(with_timeout(
+          async_read_some_at(
+              *file, 0, as_writable_bytes(span{contents.data(), contents.size()})),
+          10s)));
+  EXPECT_EQ(hello, contents);
+}
+
+TEST(io_uring_context, LinkedOperations) {
+  io_uring_context::options opts;
+  opts.fixedFileCount = 4;
+  io_uring_context ctx{opts};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_linked_operations.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+  auto file = sync_wait(async_open_file_read_write(s, path));
+  ASSERT_TRUE(file.has_value());
+
+  // The write and the fdatasync are submitted as one chain.
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  sync_wait(sequence(
+      async_write_some_at(*file, 0, as_bytes(span{hello.data(), hello.size()})),
+      async_fdatasync(*file)));
+
+  // Longer chains produce the value of their last operation.
+  const std::array<char, 5> world = {'w', 'o', 'r', 'l', 'd'};
+  std::array<char, 10> contents{};
+  EXPECT_EQ(
+      10,
+      sync_wait(sequence(
+          async_write_some_at(
+              *file, 5, as_bytes(span{world.data(), world.size()})),
+          async_fsync(*file),
+          async_read_some_at(
+              *file,
+              0,
+              as_writable_bytes(span{contents.data(), contents.size()})))));
+  EXPECT_EQ(0, std::memcmp(contents.data(), "helloworld", 10));
+
+  // A failed operation fails the rest of the chain.
+  try {
+    sync_wait(sequence(async_fallocate(*file, 0, -1), async_fsync(*file)));
+    ADD_FAILURE() << "expected the chain to fail";
+  } catch (const std::system_error& e) {
+    EXPECT_EQ(std::errc::invalid_argument, e.code());
+  }
+
+  // A read that stops short at the end of the file can't fill the rest of
+  // its buffer, so the chain fails and the write after it doesn't run.
+  try {
+    sync_wait(sequence(
+        async_read_some_at(
+            *file,
+            5,
+            as_writable_bytes(span{contents.data(), contents.size()})),
+        async_fsync(*file),
+        async_write_some_at(
+            *file, 10, as_bytes(span{hello.data(), hello.size()}))));
+    ADD_FAILURE() << "expected the chain to fail";
+  } catch (const std::system_error& e) {
+    EXPECT_EQ(std::errc::io_error, e.code());
+  }
+  EXPECT_EQ(0, std::memcmp(contents.data(), "world", 5));
+  std::array<char, 15> written{};
+  EXPECT_EQ(
+      10,
+      sync_wait(async_read_some_at(
+          *file, 0, as_writable_bytes(span{written.data(), written.size()}))));
+  EXPECT_EQ(0, std::memcmp(written.data(), "helloworld", 10));
+
+  // The close only gives up the descriptor and its fixed-file slot once it
+  // has run, so the write linked before it can still use them.
+  const char* closedPath = "io_uring_context_test_linked_close.tmp";
+  scope_guard removeClosedFile = [&]() noexcept { std::remove(closedPath); };
+  auto closed = sync_wait(async_open_file_write_only(s, closedPath));
+  ASSERT_TRUE(closed.has_value());
+  sync_wait(sequence(
+      async_write_some_at(
+          *closed, 0, as_bytes(span{hello.data(), hello.size()})),
+      async_close(*closed)));
+  struct stat closedStat;
+  ASSERT_EQ(0, ::stat(closedPath, &closedStat));
+  EXPECT_EQ(5, closedStat.st_size);
+
+  // A close that doesn't run because an earlier link failed leaves the
+  // file open. A write at a negative offset fails and breaks the chain.
+  auto notClosed = sync_wait(async_open_file_write_only(s, closedPath));
+  ASSERT_TRUE(notClosed.has_value());
+  EXPECT_THROW(
+      sync_wait(sequence(
+          async_write_some_at(
+              *notClosed, -2, as_bytes(span{hello.data(), hello.size()})),
+          async_close(*notClosed))),
+      std::system_error);
+  EXPECT_EQ(
+      5,
+      sync_wait(async_write_some_at(
+          *notClosed, 5, as_bytes(span{hello.data(), hello.size()}))));
+  sync_wait(async_close(*notClosed));
+  ASSERT_EQ(0, ::stat(closedPath, &closedStat));
+  EXPECT_EQ(10, closedStat.st_size);
+
+  // A stop request cancels the chain wherever it has got to.
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  std::array<char, 5> buffer{};
+  auto echoed = sync_wait(stop_when(
+      sequence(
+          async_read_some(
+              *server, as_writable_bytes(span{buffer.data(), buffer.size()})),
+          async_write_some(*server, as_bytes(span{buffer.data(), buffer.size()}))),
+      schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(echoed.has_value());
+
+  // The socket is still usable afterwards.
+  EXPECT_EQ(
+      5,
+      sync_wait(sequence(
+          async_write_some(*client, as_bytes(span{hello.data(), hello.size()})),
+          async_read_some(
+              *server,
+              as_writable_bytes(span{buffer.data(), buffer.size()})))));
+  EXPECT_EQ(hello, buffer);
+
+  // The whole request has to arrive before the reply is sent, even though
+  // it arrives in two parts.
+  std::array<char, 10> request{};
+  std::array<char, 10> reply{};
+  sync_wait(
+      async_write_some(*client, as_bytes(span{hello.data(), hello.size()})));
+  sync_wait(when_all(
+      sequence(
+          async_read_some(
+              *server,
+              as_writable_bytes(span{request.data(), request.size()})),
+          async_write_some(
+              *server, as_bytes(span{request.data(), request.size()}))),
+      let_value(schedule_at(s, now(s) + 10ms), [&] {
+        return async_write_some(
+            *client, as_bytes(span{world.data(), world.size()}));
+      })));
+  EXPECT_EQ(
+      10,
+      sync_wait(async_read_some(
+          *client, as_writable_bytes(span{reply.data(), reply.size()}))));
+  EXPECT_EQ(0, std::memcmp(reply.data(), "helloworld", 10));
+}
+
+TEST(io_uring_context, SpliceAndTee) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_splice_and_tee.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+  auto file = sync_wait(async_open_file_read_write(s, path));
+  ASSERT_TRUE(file.has_value());
+
+  auto [reader, writer] = open_pipe(s);
+  auto [copyReader, copyWriter] = open_pipe(s);
+
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  EXPECT_EQ(
+      5,
+      sync_wait(
+          async_write_some(writer, as_bytes(span{hello.data(), hello.size()}))));
+
+  // Duplicate the data into the second pipe, then move it into the file.
+  EXPECT_EQ(5, sync_wait(async_tee(reader, copyWriter, 5)));
+  EXPECT_EQ(5, sync_wait(async_splice(reader, -1, *file, 0, 5)));
+
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          copyReader, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some_at(
+          *file, 0, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  EXPECT_EQ(hello, buffer);
+
+  // The pipe is empty, so the splice only completes once it is cancelled.
+  auto spliced = sync_wait(stop_when(
+      async_splice(reader, -1, *file, 0, 5), schedule_at(s, now(s) + 10ms)));
+  EXPECT_FALSE(spliced.has_value());
+}
+
+TEST(io_uring_context, Sendfile) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  // Larger than a pipe, so that it takes several chunks.
+  std::vector<char> contents(3 * 1024 * 1024 + 123);
+  for (std::size_t i = 0; i < contents.size(); ++i) {
+    contents[i] = static_cast<char>(i * 7);
+  }
+
+  auto s = ctx.get_scheduler();
+  const char* path = "io_uring_context_test_sendfile.tmp";
+  scope_guard removeFile = [&]() noexcept { std::remove(path); };
+  auto file = sync_wait(async_open_file_read_write(s, path));
+  ASSERT_TRUE(file.has_value());
+  for (std::size_t written = 0; written < contents.size();) {
+    const auto n = sync_wait(async_write_some_at(
+        *file,
+        written,
+        as_bytes(span{contents.data() + written, contents.size() - written})));
+    ASSERT_TRUE(n.has_value());
+    written += *n;
+  }
+
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  // Send everything after the first 100 bytes, asking for more than there
+  // is.
+  const std::size_t offset = 100;
+  const std::size_t expected = contents.size() - offset;
+  std::vector<char> received(expected);
+  std::thread receiver{[&] {
+    for (std::size_t total = 0; total < expected;) {
+      const auto n = sync_wait(async_read_some(
+          *server,
+          as_writable_bytes(
+              span{received.data() + total, received.size() - total})));
+      if (!n || *n <= 0) {
+        break;
+      }
+      total += *n;
+    }
+  }};
+  scope_guard joinReceiver = [&]() noexcept { receiver.join(); };
+
+  EXPECT_EQ(
+      ssize_t(expected),
+      sync_wait(stop_when(
+          async_sendfile(*client, *file, offset, expected + 1000),
+          schedule_at(s, now(s) + 10s))));
+  joinReceiver.reset();
+  EXPECT_EQ(0, std::memcmp(received.data(), contents.data() + offset, expected));
+}
+
+TEST(io_uring_context, SendZeroCopy) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  // The buffer can be changed as soon as the send completes.
+  std::array<char, 5> message = {'h', 'e', 'l', 'l', 'o'};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_send_zero_copy(
+          *client, as_bytes(span{message.data(), message.size()}))));
+  message.fill('x');
+
+  std::array<char, 5> buffer{};
+  EXPECT_EQ(
+      5,
+      sync_wait(async_read_some(
+          *server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  const std::array<char, 5> hello = {'h', 'e', 'l', 'l', 'o'};
+  EXPECT_EQ(hello, buffer);
+}
+
+TEST(io_uring_context, MultishotAccept) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 8);
+  auto connections = async_accept_stream(listener);
+
+  std::vector<io_uring_context::async_socket> clients;
+  for (int i = 0; i < 3; ++i) {
+    auto client = sync_wait(async_connect(s, listener.local_address()));
+    ASSERT_TRUE(client.has_value());
+    clients.push_back(std::move(*client));
+  }
+
+  for (auto& client : clients) {
+    auto server = sync_wait(next(connections));
+    ASSERT_TRUE(server.has_value());
+
+    const std::array<char, 2> ping = {'h', 'i'};
+    EXPECT_EQ(
+        2,
+        sync_wait(async_write_some(
+            client, as_bytes(span{ping.data(), ping.size()}))));
+    std::array<char, 2> buffer{};
+    EXPECT_EQ(
+        2,
+        sync_wait(async_read_some(
+            *server, as_writable_bytes(span{buffer.data(), buffer.size()}))));
+  }
+
+  // A stop request completes the pending next() without ending the stream.
+  EXPECT_FALSE(
+      sync_wait(stop_when(next(connections), schedule_at(s, now(s) + 10ms)))
+          .has_value());
+  auto late = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(late.has_value());
+  EXPECT_TRUE(sync_wait(next(connections)).has_value());
+
+  sync_wait(cleanup(connections));
+}
+
+TEST(io_uring_context, MultishotReceive) {
+  io_uring_context ctx;
+
+  // Two buffers shared by every receive stream on the context.
+  io_uring_context::provided_buffer_pool pool{ctx, 2, 16};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  auto received = async_receive_stream(*server, pool);
+  auto send = [&](const char* text) {
+    EXPECT_EQ(
+        ssize_t(std::strlen(text)),
+        sync_wait(async_write_some(
+            *client, as_bytes(span{text, std::strlen(text)}))));
+  };
+  auto as_string = [](const io_uring_context::provided_buffer& buffer) {
+    return std::string(
+        reinterpret_cast<const char*>(buffer.data().data()), buffer.size());
+  };
+
+  // Hold on to both buffers.
+  send("hello");
+  auto first = sync_wait(next(received));
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ("hello", as_string(*first));
+  send("world");
+  auto second = sync_wait(next(received));
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ("world", as_string(*second));
+
+  // Releasing them hands them back to the kernel for the next receives.
+  first.reset();
+  second.reset();
+  for (int i = 0; i < 4; ++i) {
+    send("again");
+    auto buffer = sync_wait(next(received));
+    ASSERT_TRUE(buffer.has_value());
+    EXPECT_EQ("again", as_string(*buffer));
+  }
+
+  // The stream ends when the peer closes its end.
+  sync_wait(async_close(*client));
+  EXPECT_FALSE(sync_wait(next(received)).has_value());
+  sync_wait(cleanup(received));
+}
+
+TEST(io_uring_context, MultishotReceiveOutOfBuffers) {
+  io_uring_context ctx;
+  io_uring_context::provided_buffer_pool pool{ctx, 2, 16};
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  auto received = async_receive_stream(*server, pool);
+  auto send = [&](const char* text) {
+    EXPECT_EQ(
+        ssize_t(std::strlen(text)),
+        sync_wait(async_write_some(
+            *client, as_bytes(span{text, std::strlen(text)}))));
+  };
+  auto as_string = [](const io_uring_context::provided_buffer& buffer) {
+    return std::string(
+        reinterpret_cast<const char*>(buffer.data().data()), buffer.size());
+  };
+
+  send("hello");
+  auto first = sync_wait(next(received));
+  ASSERT_TRUE(first.has_value());
+  send("world");
+  auto second = sync_wait(next(received));
+  ASSERT_TRUE(second.has_value());
+
+  // More data arrives while both buffers are held, so the kernel finds no
+  // buffer for it. The stream waits for one rather than ending.
+  send("more");
+  std::this_thread::sleep_for(20ms);
+  first.reset();
+  auto third = sync_wait(next(received));
+  ASSERT_TRUE(third.has_value());
+  EXPECT_EQ("more", as_string(*third));
+
+  third.reset();
+  second.reset();
+  send("again");
+  auto fourth = sync_wait(next(received));
+  ASSERT_TRUE(fourth.has_value());
+  EXPECT_EQ("again", as_string(*fourth));
+  send("last");
+  auto fifth = sync_wait(next(received));
+  ASSERT_TRUE(fifth.has_value());
+
+  // Cleaning up a stream that waits for a buffer stops it waiting.
+  send("dropped");
+  std::this_thread::sleep_for(20ms);
+  sync_wait(cleanup(received));
+}
+
+TEST(io_uring_context, DestroyProvidedBufferPool) {
+  io_uring_context ctx;
+
+  inplace_stop_source stopSource;
+  std::thread t{[&] { ctx.run(stopSource.get_token()); }};
+  scope_guard stopOnExit = [&]() noexcept {
+    stopSource.request_stop();
+    t.join();
+  };
+
+  auto s = ctx.get_scheduler();
+  auto listener = open_listening_socket(s, socket_address::ipv4_loopback(), 4);
+  auto client = sync_wait(async_connect(s, listener.local_address()));
+  ASSERT_TRUE(client.has_value());
+  auto server = sync_wait(async_accept(listener));
+  ASSERT_TRUE(server.has_value());
+
+  // Each pool hands its buffers back to the kernel and takes them back when
+  // destroyed, while the context keeps running.
+  for (int i = 0; i < 4; ++i) {
+    io_uring_context::provided_buffer_pool pool{ctx, 2, 16};
+    auto received = async_receive_stream(*server, pool);
+    EXPECT_EQ(
+        ssize_t(5),
+        sync_wait(async_write_some(*client, as_bytes(span{"hello", 5}))));
+    auto buffer = sync_wait(next(received));
+    ASSERT_TRUE(buffer.has_value());
+    EXPECT_EQ(5u, buffer->size());
+    buffer.reset();
+    sync_wait(cleanup(received));
+  }
+}
+
+#endif // UNIFEX_NO_LIBURING
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/config.hpp>
+
+#if !UNIFEX_NO_LIBURING
+
+#include <unifex/io_concepts.hpp>
+#include <unifex/let_value.hpp>
+#include <unifex/linux/io_uring_pool.hpp>
+#include <unifex/pipe_concepts.hpp>
+#include <unifex/scheduler_concepts.hpp>
+#include <unifex/span.hpp>
+#include <unifex/sync_wait.hpp>
+#include <unifex/then.hpp>
+#include <unifex/when_all.hpp>
+
+#include <array>
+#include <chrono>
+#include <set>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <sched.h>
+
+using namespace unifex;
+using namespace unifex::linuxos;
+using namespace std::chrono_literals;
+
+namespace {
+template <typename Scheduler>
+std::thread::id thread_of(Scheduler s) {
+  return *sync_wait(
+      then(schedule(s), [] { return std::this_thread::get_id(); }));
+}
+} // namespace
+
+TEST(io_uring_pool, RingsRunOnTheirOwnThreads) {
+  io_uring_pool::options opts;
+  opts.ringCount = 3;
+  io_uring_pool pool{opts};
+  EXPECT_EQ(3u, pool.ring_count());
+
+  std::set<std::thread::id> threads;
+  for (std::uint32_t i = 0; i < pool.ring_count(); ++i) {
+    threads.insert(thread_of(pool.get_ring_scheduler(i)));
+  }
+  EXPECT_EQ(3u, threads.size());
+  EXPECT_EQ(0u, threads.count(std::this_thread::get_id()));
+}
+
+TEST(io_uring_pool, ThreadsArePinned) {
+  io_uring_pool::options opts;
+  opts.ringCount = 2;
+  io_uring_pool pool{opts};
+
+  for (std::uint32_t i = 0; i < pool.ring_count(); ++i) {
+    const int cpuCount = *sync_wait(
+        then(schedule(pool.get_ring_scheduler(i)), [] {
+          cpu_set_t cpus;
+          CPU_ZERO(&cpus);
+          return sched_getaffinity(0, sizeof(cpus), &cpus) == 0
+              ? CPU_COUNT(&cpus)
+              : -1;
+        }));
+    EXPECT_EQ(1, cpuCount);
+  }
+}
+
+TEST(io_uring_pool, IdleRingsAreUsedInTurn) {
+  io_uring_pool::options opts;
+  opts.ringCount = 4;
+  opts.shareWorkerPool = true;
+  io_uring_pool pool{opts};
+
+  std::set<std::thread::id> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.insert(thread_of(pool.get_scheduler()));
+  }
+  EXPECT_EQ(4u, threads.size());
+}
+
+TEST(io_uring_pool, StaysOnTheCallingRing) {
+  io_uring_pool::options opts;
+  opts.ringCount = 4;
+  io_uring_pool pool{opts};
+  auto s = pool.get_scheduler();
+
+  for (int i = 0; i < 8; ++i) {
+    const bool sameThread = *sync_wait(let_value(schedule(s), [&] {
+      return then(
+          schedule(s),
+          [outer = std::this_thread::get_id()] {
+            return outer == std::this_thread::get_id();
+          });
+    }));
+    EXPECT_TRUE(sameThread);
+  }
+}
+
+TEST(io_uring_pool, AvoidsBusyRings) {
+  io_uring_pool::options opts;
+  opts.ringCount = 2;
+  io_uring_pool pool{opts};
+
+  // Keep two reads waiting on an empty pipe that belongs to ring 0.
+  auto [reader, writer] = open_pipe(pool.get_ring_scheduler(0));
+  std::array<char, 1> first;
+  std::array<char, 1> second;
+  std::thread readers{[&] {
+    sync_wait(when_all(
+        async_read_some(reader, as_writable_bytes(span{first})),
+        async_read_some(reader, as_writable_bytes(span{second}))));
+  }};
+  while (pool.ring(0).in_flight_count() < 2) {
+    std::this_thread::sleep_for(1ms);
+  }
+
+  const auto idleThread = thread_of(pool.get_ring_scheduler(1));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(idleThread, thread_of(pool.get_scheduler()));
+  }
+
+  const std::array<char, 2> data{'a', 'b'};
+  sync_wait(async_write_some(writer, as_bytes(span{data.data(), data.size()})));
+  readers.join();
+}
+
+TEST(io_uring_pool, OpensPipesOnAPickedRing) {
+  io_uring_pool::options opts;
+  opts.ringCount = 2;
+  io_uring_pool pool{opts};
+
+  auto [reader, writer] = open_pipe(pool.get_scheduler());
+  const std::array<char, 3> data{'a', 'b', 'c'};
+  std::array<char, 3> buffer{};
+  auto [written, read] = *sync_wait(when_all(
+      async_write_some(writer, as_bytes(span{data.data(), data.size()})),
+      async_read_some(reader, as_writable_bytes(span{buffer}))));
+  EXPECT_EQ(3, std::get<0>(std::get<0>(written)));
+  EXPECT_EQ(3, std::get<0>(std::get<0>(read)));
+  EXPECT_EQ(data, buffer);
+}
+
+#endif // !UNIFEX_NO_LIBURING
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * Licensed under the Apache License Version 2.0 with LLVM Exceptions
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *   https://llvm.org/LICENSE.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <unifex/async_scope.hpp>
+#include <unifex/manual_event_loop.hpp>
+#include <unifex/sync_wait.hpp>
+
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace unifex;
+
+TEST(ManualEventLoop, SubmissionBatch) {
+  manual_event_loop loop;
+  std::thread thread{[&] { loop.run(); }};
+  auto sched = loop.get_scheduler();
+  std::vector<int> order;
+  std::promise<void> done;
+
+  async_scope scope;
+  {
+    manual_event_loop::submission_batch batch{loop};
+    for (int i = 0; i < 10; ++i) {
+      scope.spawn_call_on(sched, [&, i]() noexcept {
+        order.push_back(i);
+        if (i == 9) {
+          done.set_value();
+        }
+      });
+    }
+  }
+  done.get_future().wait();
+  sync_wait(scope.complete());
+
+  loop.stop();
+  thread.join();
+
+  // Batched operations run in the order they were started.
+  EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
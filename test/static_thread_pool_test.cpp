@@ -14,15 +14,28 @@
  * limitations under the License.
  */
 
+#include <unifex/async_scope.hpp>
+#include <unifex/get_priority.hpp>
 #include <unifex/just.hpp>
 #include <unifex/on.hpp>
 #include <unifex/scheduler_concepts.hpp>
 #include <unifex/static_thread_pool.hpp>
+#include <unifex/stop_when.hpp>
 #include <unifex/sync_wait.hpp>
 #include <unifex/then.hpp>
 #include <unifex/when_all.hpp>
+#include <unifex/with_query_value.hpp>
 
 #include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
 
 #include <gtest/gtest.h>
 
@@ -62,3 +75,425 @@ TEST(StaticThreadPool, Smoke) {
 
   EXPECT_EQ(x, 3);
 }
+
+TEST(StaticThreadPool, WorkStealing) {
+  static_thread_pool::options opts;
+  opts.threadCount = 4;
+  opts.queuePolicy = static_thread_pool::queue_policy::work_stealing;
+  static_thread_pool tpContext{opts};
+  auto tp = tpContext.get_scheduler();
+  std::atomic<int> x = 0;
+  std::promise<void> done;
+
+  // Spawn more tasks from the workers than fit in a single worker's deque.
+  async_scope scope;
+  scope.spawn_call_on(tp, [&]() noexcept {
+    for (int i = 0; i < 1000; ++i) {
+      scope.spawn_call_on(tp, [&]() noexcept {
+        if (++x == 1000) {
+          done.set_value();
+        }
+      });
+    }
+  });
+  done.get_future().wait();
+  sync_wait(scope.complete());
+
+  EXPECT_EQ(x, 1000);
+}
+
+TEST(StaticThreadPool, LifoSlot) {
+  static_thread_pool::options opts;
+  opts.threadCount = 1;
+  opts.lifoSlot = true;
+  static_thread_pool tpContext{opts};
+  auto tp = tpContext.get_scheduler();
+  std::vector<int> order;
+  std::promise<void> done;
+
+  // The most recently scheduled task from a worker runs next.
+  async_scope scope;
+  scope.spawn_call_on(tp, [&]() noexcept {
+    scope.spawn_call_on(tp, [&]() noexcept {
+      order.push_back(1);
+      done.set_value();
+    });
+    scope.spawn_call_on(tp, [&]() noexcept { order.push_back(2); });
+  });
+  done.get_future().wait();
+  sync_wait(scope.complete());
+
+  EXPECT_EQ(order, (std::vector<int>{2, 1}));
+}
+
+TEST(StaticThreadPool, SpinThenPark) {
+  static_thread_pool::options opts;
+  opts.threadCount = 2;
+  opts.spinDuration = std::chrono::microseconds{100};
+  static_thread_pool tpContext{opts};
+  auto tp = tpContext.get_scheduler();
+  std::atomic<int> x = 0;
+
+  for (int i = 0; i < 100; ++i) {
+    sync_wait(run_on(tp, [&] { ++x; }));
+  }
+
+  EXPECT_EQ(x, 100);
+}
+
+TEST(StaticThreadPool, NumaAware) {
+  static_thread_pool::options opts;
+  opts.threadCount = 2;
+  opts.numaAware = true;
+  static_thread_pool tpContext{opts};
+
+  // Every machine has at least node 0.
+  auto tp = tpContext.get_scheduler_for_node(0);
+  EXPECT_NE(tp, tpContext.get_scheduler());
+
+  std::atomic<int> x = 0;
+  sync_wait(when_all(run_on(tp, [&] { ++x; }), run_on(tp, [&] { ++x; })));
+  EXPECT_EQ(x, 2);
+
+  EXPECT_THROW(
+      tpContext.get_scheduler_for_node(1u << 20), std::invalid_argument);
+}
+
+#if defined(__linux__)
+TEST(StaticThreadPool, CpuSets) {
+  // Use the last CPU the process may run on, since the others might not
+  // be available to it.
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  int lastCpu = -1;
+  for (int i = 0; i < CPU_SETSIZE; ++i) {
+    if (CPU_ISSET(i, &allowed)) {
+      lastCpu = i;
+    }
+  }
+  ASSERT_GE(lastCpu, 0);
+
+  static_thread_pool::options opts;
+  opts.threadCount = 2;
+  opts.cpuSets = {{static_cast<std::uint32_t>(lastCpu)}};
+  static_thread_pool tpContext{opts};
+  auto tp = tpContext.get_scheduler();
+
+  int cpu = -1;
+  int allowedCount = 0;
+  sync_wait(run_on(tp, [&] {
+    cpu = sched_getcpu();
+    cpu_set_t workerCpus;
+    CPU_ZERO(&workerCpus);
+    if (sched_getaffinity(0, sizeof(workerCpus), &workerCpus) == 0) {
+      allowedCount = CPU_COUNT(&workerCpus);
+    }
+  }));
+  EXPECT_EQ(cpu, lastCpu);
+  EXPECT_EQ(allowedCount, 1);
+}
+
+TEST(StaticThreadPool, NumaAwareOnlyUsesAllowedCpus) {
+  // Restrict this thread, which the pool reads the allowed CPUs from, to
+  // its last CPU. Every worker must then stay on that CPU rather than
+  // being pinned to the whole of its node.
+  cpu_set_t original;
+  CPU_ZERO(&original);
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(original), &original));
+  int lastCpu = -1;
+  for (int i = 0; i < CPU_SETSIZE; ++i) {
+    if (CPU_ISSET(i, &original)) {
+      lastCpu = i;
+    }
+  }
+  ASSERT_GE(lastCpu, 0);
+
+  cpu_set_t restricted;
+  CPU_ZERO(&restricted);
+  CPU_SET(lastCpu, &restricted);
+  ASSERT_EQ(0, sched_setaffinity(0, sizeof(restricted), &restricted));
+
+  std::atomic<int> maxAllowedCount = 0;
+  {
+    static_thread_pool::options opts;
+    opts.threadCount = 2;
+    opts.numaAware = true;
+    static_thread_pool tpContext{opts};
+    auto tp = tpContext.get_scheduler();
+
+    auto countAllowed = [&] {
+      cpu_set_t workerCpus;
+      CPU_ZERO(&workerCpus);
+      if (sched_getaffinity(0, sizeof(workerCpus), &workerCpus) == 0) {
+        int count = CPU_COUNT(&workerCpus);
+        int prev = maxAllowedCount.load();
+        while (prev < count &&
+               !maxAllowedCount.compare_exchange_weak(prev, count)) {
+        }
+      }
+    };
+    sync_wait(when_all(run_on(tp, countAllowed), run_on(tp, countAllowed)));
+  }
+  ASSERT_EQ(0, sched_setaffinity(0, sizeof(original), &original));
+
+  EXPECT_EQ(maxAllowedCount.load(), 1);
+}
+#endif
+
+TEST(StaticThreadPool, SubmissionBatch) {
+  static_thread_pool tpContext{4};
+  auto tp = tpContext.get_scheduler();
+  std::atomic<int> x = 0;
+  std::promise<void> done;
+
+  async_scope scope;
+  {
+    static_thread_pool::submission_batch batch{tpContext};
+    for (int i = 0; i < 1000; ++i) {
+      scope.spawn_call_on(tp, [&]() noexcept {
+        if (++x == 1000) {
+          done.set_value();
+        }
+      });
+    }
+
+    // Nothing runs until the batch is submitted.
+    EXPECT_EQ(x, 0);
+  }
+  done.get_future().wait();
+  sync_wait(scope.complete());
+
+  EXPECT_EQ(x, 1000);
+}
+
+TEST(StaticThreadPool, PriorityLanes) {
+  static_thread_pool tpContext{1};
+  std::promise<void> blocked;
+  std::promise<void> release;
+  std::vector<priority> order;
+
+  async_scope scope;
+  scope.spawn_call_on(tpContext.get_scheduler(), [&]() noexcept {
+    blocked.set_value();
+    release.get_future().wait();
+  });
+  blocked.get_future().wait();
+
+  // Queue work while the only worker is busy.
+  for (auto prio : {priority::background, priority::normal, priority::high}) {
+    scope.spawn_call_on(
+        tpContext.get_scheduler(prio), [&order, prio]() noexcept {
+          order.push_back(prio);
+        });
+  }
+  release.set_value();
+  sync_wait(scope.complete());
+
+  EXPECT_EQ(
+      order,
+      (std::vector<priority>{
+          priority::high, priority::normal, priority::background}));
+}
+
+TEST(StaticThreadPool, PriorityFromReceiver) {
+  static_thread_pool tpContext{1};
+  std::promise<void> blocked;
+  std::promise<void> release;
+  std::vector<int> order;
+
+  async_scope scope;
+  scope.spawn_call_on(tpContext.get_scheduler(), [&]() noexcept {
+    blocked.set_value();
+    release.get_future().wait();
+  });
+  blocked.get_future().wait();
+
+  scope.spawn_call_on(
+      tpContext.get_scheduler(), [&]() noexcept { order.push_back(1); });
+  scope.spawn(with_query_value(
+      then(
+          schedule(tpContext.get_scheduler()),
+          [&]() noexcept { order.push_back(0); }),
+      get_priority,
+      priority::high));
+  release.set_value();
+  sync_wait(scope.complete());
+
+  EXPECT_EQ(order, (std::vector<int>{0, 1}));
+}
+
+TEST(StaticThreadPool, BackgroundPriorityIsNotStarved) {
+  static_thread_pool tpContext{1};
+  auto high = tpContext.get_scheduler(priority::high);
+  std::atomic<bool> backgroundRan = false;
+
+  // Keep the high priority lane busy until the background task gets a turn.
+  async_scope scope;
+  auto reschedule = [&](auto& self) -> void {
+    scope.spawn_call_on(high, [&, self]() noexcept {
+      if (!backgroundRan.load()) {
+        self(self);
+      }
+    });
+  };
+  reschedule(reschedule);
+  scope.spawn_call_on(
+      tpContext.get_scheduler(priority::background),
+      [&]() noexcept { backgroundRan = true; });
+
+  while (!backgroundRan.load()) {
+    std::this_thread::yield();
+  }
+  sync_wait(scope.complete());
+
+  EXPECT_TRUE(backgroundRan.load());
+}
+
+TEST(StaticThreadPool, Elastic) {
+  static_thread_pool::options opts;
+  opts.threadCount = 1;
+  opts.maxThreadCount = 4;
+  opts.growAfter = std::chrono::microseconds(100);
+  opts.idleTimeout = std::chrono::milliseconds(10);
+  static_thread_pool tpContext{opts};
+  EXPECT_EQ(tpContext.thread_count(), 1u);
+
+  // Each task waits for all of the others to start, which only completes
+  // once the pool has grown to four threads.
+  std::atomic<int> started = 0;
+  std::promise<void> allStarted;
+  auto allStartedFuture = allStarted.get_future().share();
+  async_scope scope;
+  for (int i = 0; i < 4; ++i) {
+    scope.spawn_call_on(tpContext.get_scheduler(), [&]() noexcept {
+      if (++started == 4) {
+        allStarted.set_value();
+      }
+      allStartedFuture.wait();
+    });
+  }
+  EXPECT_EQ(
+      allStartedFuture.wait_for(std::chrono::seconds(10)),
+      std::future_status::ready);
+  sync_wait(scope.complete());
+
+  // The extra threads retire once idle.
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (tpContext.thread_count() > 1 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(tpContext.thread_count(), 1u);
+}
+
+TEST(StaticThreadPool, ScheduleAfter) {
+  static_thread_pool tpContext{2};
+  auto tp = tpContext.get_scheduler();
+
+  const auto start = std::chrono::steady_clock::now();
+  auto elapsed = sync_wait(then(
+      schedule_after(tp, std::chrono::milliseconds(20)),
+      [&] { return std::chrono::steady_clock::now() - start; }));
+
+  ASSERT_TRUE(elapsed.has_value());
+  EXPECT_GE(*elapsed, std::chrono::milliseconds(20));
+}
+
+TEST(StaticThreadPool, ScheduleAtInOrder) {
+  static_thread_pool tpContext{1};
+  auto tp = tpContext.get_scheduler();
+  std::vector<int> order;
+
+  // Started from a worker, so all timers go into that worker's list.
+  sync_wait(on(tp, [&] {
+    const auto now = unifex::now(tp);
+    return when_all(
+        then(
+            schedule_at(tp, now + std::chrono::milliseconds(30)),
+            [&] { order.push_back(3); }),
+        then(
+            schedule_at(tp, now + std::chrono::milliseconds(10)),
+            [&] { order.push_back(1); }),
+        then(
+            schedule_at(tp, now + std::chrono::milliseconds(20)),
+            [&] { order.push_back(2); }));
+  }()));
+
+  EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+TEST(StaticThreadPool, ScheduleAfterCancellation) {
+  static_thread_pool tpContext{2};
+  auto tp = tpContext.get_scheduler();
+  bool longTimerRan = false;
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = sync_wait(stop_when(
+      then(
+          schedule_after(tp, std::chrono::seconds(10)),
+          [&] { longTimerRan = true; }),
+      schedule_after(tp, std::chrono::milliseconds(10))));
+
+  EXPECT_FALSE(result.has_value());
+  EXPECT_FALSE(longTimerRan);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(StaticThreadPool, BusyWorkerTimersMigrate) {
+  static_thread_pool tpContext{2};
+  auto tp = tpContext.get_scheduler();
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::atomic<bool> timerRan = false;
+
+  // Keep the worker that owns the timer busy until the timer has run on
+  // the other worker.
+  async_scope scope;
+  scope.spawn_call_on(tp, [&]() noexcept {
+    scope.spawn(then(
+        schedule_after(tp, std::chrono::milliseconds(5)),
+        [&]() noexcept {
+          timerRan = true;
+          release.set_value();
+        }));
+    EXPECT_EQ(
+        released.wait_for(std::chrono::seconds(10)),
+        std::future_status::ready);
+  });
+
+  released.wait();
+  sync_wait(scope.complete());
+  EXPECT_TRUE(timerRan.load());
+}
+
+#if UNIFEX_STATIC_THREAD_POOL_STATS
+TEST(StaticThreadPool, Stats) {
+  static_thread_pool tpContext{2};
+  auto tp = tpContext.get_scheduler();
+  std::atomic<int> x = 0;
+  std::promise<void> done;
+
+  async_scope scope;
+  for (int i = 0; i < 100; ++i) {
+    scope.spawn_call_on(tp, [&]() noexcept {
+      if (++x == 100) {
+        done.set_value();
+      }
+    });
+  }
+  done.get_future().wait();
+  sync_wait(scope.complete());
+
+  const auto stats = tpContext.snapshot();
+  EXPECT_GE(stats.tasksEnqueued, 100u);
+  EXPECT_GE(stats.tasksExecuted, 100u);
+
+  std::uint64_t histogramCount = 0;
+  for (auto count : stats.latencyHistogram) {
+    histogramCount += count;
+  }
+  EXPECT_EQ(histogramCount, stats.tasksExecuted);
+}
+#endif